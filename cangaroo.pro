@@ -1,6 +1,8 @@
 QT += charts
 QT += network
 SUBDIRS += src
+unix:SUBDIRS += src/daemon
+unix:SUBDIRS += src/tools
 TEMPLATE = subdirs
 CONFIG += ordered warn_on qt debug_and_release
 CONFIG += c++11
@@ -24,11 +24,15 @@
 
 #include <QDateTime>
 #include <QDebug>
+#include <QFile>
+#include <QDomDocument>
 
 #include <core/CanTrace.h>
+#include <core/HostClock.h>
 #include <core/MeasurementSetup.h>
 #include <core/MeasurementNetwork.h>
 #include <core/MeasurementInterface.h>
+#include <core/CanReplay.h>
 #include <driver/CanDriver.h>
 #include <driver/CanInterface.h>
 #include <driver/CanListener.h>
@@ -40,7 +44,9 @@ Backend::Backend()
   : QObject(0),
     _measurementRunning(false),
     _measurementStartTime(0),
-    _setup(this)
+    _setup(this),
+    _useSharedIoThread(false),
+    _replay(0)
 {
     _logModel = new LogModel(*this);
 
@@ -73,7 +79,7 @@ bool Backend::startMeasurement()
 {
     log_info(">>Starting measurement<<");//开启运行调试
 
-    _measurementStartTime = QDateTime::currentMSecsSinceEpoch();
+    _measurementStartTime = HostClock::nowNs();
     _timerSinceStart.start();
 
     int i=0;
@@ -89,14 +95,28 @@ bool Backend::startMeasurement()
 //                qDebug()<<intf->getName();
 //                qDebug()<<intf->getId();
 
-                log_info(QString("Listening on interface: %1").arg(intf->getName()));
                 CanListener *listener = new CanListener(0, *this, *intf);
-                listener->startThread();
+                if (!(intf->getCapabilities() & CanInterface::capability_capture_filter)) {
+                    listener->setCaptureFilter(mi->captureFilter());
+                }
+                _trace->addIngestRing(&listener->getRing());
                 _listeners.append(listener);
+
+                if (_useSharedIoThread && intf->getDriver()->addListener(listener, intf)) {
+                    log_info(QString("Listening on interface: %1 (shared I/O thread)").arg(intf->getName()));
+                    continue;
+                }
+
+                log_info(QString("Listening on interface: %1").arg(intf->getName()));
+                listener->startThread();
             }
         }
     }
 
+    foreach (CanDriver *driver, _drivers) {
+        driver->startListeners();
+    }
+
     _measurementRunning = true;
     emit beginMeasurement();
     return true;
@@ -105,21 +125,29 @@ bool Backend::startMeasurement()
 bool Backend::stopMeasurement()
 {
     if (_measurementRunning) {
+        stopReplay();
+
         foreach (CanListener *listener, _listeners) {
             listener->requestStop();
         }
 
+        foreach (CanDriver *driver, _drivers) {
+            driver->stopListeners();
+        }
+
 //        qDebug()<<">>close Measurement<<";//关闭调试口
 
         foreach (CanListener *listener, _listeners) {
             log_info(QString("Closing interface: %1").arg(getInterfaceName(listener->getInterfaceId())));
             listener->waitFinish();
+            _trace->removeIngestRing(&listener->getRing());
         }
 
         qDeleteAll(_listeners);
         _listeners.clear();
 
-        log_info("Measurement stopped");
+        log_info(QString("Measurement stopped, trace holds %1 frames in %2 KiB")
+                 .arg(_trace->size()).arg(_trace->residentBytes() / 1024));
 
         _measurementRunning = false;
 
@@ -167,9 +195,34 @@ void Backend::setSetup(MeasurementSetup &new_setup)
     _setup.cloneFrom(new_setup);
 }
 
+bool Backend::loadWorkspaceSetup(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        log_error(QString("Cannot open workspace settings file: %1").arg(filename));
+        return false;
+    }
+
+    QDomDocument doc;
+    if (!doc.setContent(&file)) {
+        log_error(QString("Cannot load settings from file: %1").arg(filename));
+        return false;
+    }
+
+    QDomElement setupRoot = doc.firstChild().firstChildElement("setup");
+    MeasurementSetup setup(this);
+    if (!setup.loadXML(*this, setupRoot)) {
+        log_error(QString("Unable to read measurement setup from workspace config file: %1").arg(filename));
+        return false;
+    }
+
+    setSetup(setup);
+    return true;
+}
+
 double Backend::currentTimeStamp() const
 {
-    return ((double)QDateTime::currentMSecsSinceEpoch()) / 1000;
+    return (double)HostClock::nowNs() / 1000000000.0;
 }
 
 CanTrace *Backend::getTrace()
@@ -245,6 +298,16 @@ QString Backend::getDriverName(CanInterfaceId id)
     return driver ? driver->getName() : "";
 }
 
+CanListener *Backend::getListenerById(CanInterfaceId id)
+{
+    foreach (CanListener *listener, _listeners) {
+        if (listener->getInterfaceId() == id) {
+            return listener;
+        }
+    }
+    return 0;
+}
+
 CanDriver *Backend::getDriverByName(QString driverName)
 {
     foreach (CanDriver *driver, _drivers) {
@@ -290,12 +353,17 @@ LogModel &Backend::getLogModel() const
 
 double Backend::getTimestampAtMeasurementStart() const
 {
-    return (double)_measurementStartTime / 1000.0;
+    return (double)_measurementStartTime / 1000000000.0;
 }
 
 uint64_t Backend::getUsecsAtMeasurementStart() const
 {
-    return _measurementStartTime * 1000;
+    return _measurementStartTime / 1000;
+}
+
+uint64_t Backend::getNsecsAtMeasurementStart() const
+{
+    return _measurementStartTime;
 }
 
 uint64_t Backend::getNsecsSinceMeasurementStart() const
@@ -329,3 +397,69 @@ bool Backend::get_show_send()
 {
     return is_show_send;
 }
+
+bool Backend::hasSharedIoThread() const
+{
+    foreach (CanDriver *driver, _drivers) {
+        if (driver->hasSharedIoThread()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Backend::useSharedIoThread() const
+{
+    return _useSharedIoThread;
+}
+
+void Backend::setUseSharedIoThread(bool use)
+{
+    _useSharedIoThread = use;
+}
+
+bool Backend::startReplay(CanReplay *replay)
+{
+    stopReplay();
+
+    if (!_measurementRunning) {
+        log_error("Cannot replay: no measurement running");
+        delete replay;
+        return false;
+    }
+
+    _replay = replay;
+    connect(_replay, SIGNAL(finished()), this, SLOT(onReplayFinished()));
+    log_info(QString("Replaying %1 frames").arg(_replay->getFrameCount()));
+    _replay->startThread();
+    return true;
+}
+
+void Backend::stopReplay()
+{
+    if (_replay) {
+        _replay->requestStop();
+        _replay->waitFinish();
+        onReplayFinished();
+    }
+}
+
+bool Backend::isReplaying() const
+{
+    return _replay != 0;
+}
+
+void Backend::onReplayFinished()
+{
+    // queued from the replay thread; stopReplay() may have handled it already
+    if (!_replay || _replay->isRunning()) {
+        return;
+    }
+
+    _replay->waitFinish();
+    log_info(QString("Replay finished: %1").arg(_replay->getStatsStr()));
+    delete _replay;
+    _replay = 0;
+
+    emit replayFinished();
+}
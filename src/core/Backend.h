@@ -38,6 +38,7 @@ class CanListener;
 class CanDbMessage;
 class SetupDialog;
 class LogModel;
+class CanReplay;
 
 class Backend : public QObject
 {
@@ -55,6 +56,7 @@ public:
     bool isMeasurementRunning() const;
     double getTimestampAtMeasurementStart() const;
     uint64_t getUsecsAtMeasurementStart() const;
+    uint64_t getNsecsAtMeasurementStart() const;
     uint64_t getNsecsSinceMeasurementStart() const;
     uint64_t getUsecsSinceMeasurementStart() const;
 
@@ -65,6 +67,8 @@ public:
     void loadDefaultSetup(MeasurementSetup &setup);
     void setDefaultSetup();
     void setSetup(MeasurementSetup &new_setup);
+    // only the measurement setup of a workspace file, not its windows
+    bool loadWorkspaceSetup(const QString &filename);
 
     double currentTimeStamp() const;
 
@@ -76,6 +80,7 @@ public:
     CanInterfaceIdList getInterfaceList();
     CanDriver *getDriverById(CanInterfaceId id);
     CanInterface *getInterfaceById(CanInterfaceId id);
+    CanListener *getListenerById(CanInterfaceId id);
 
     QString getPortName(CanInterfaceId id);
     QString getInterfaceName(CanInterfaceId id);
@@ -94,6 +99,16 @@ public:
     void set_show_send(bool sta);
     bool get_show_send(void);
 
+    // let drivers that can serve all their interfaces from one thread do so (see CanDriver::addListener)
+    bool hasSharedIoThread() const;
+    bool useSharedIoThread() const;
+    void setUseSharedIoThread(bool use);
+
+    // play frames back onto the running measurement's interfaces; takes ownership of replay
+    bool startReplay(CanReplay *replay);
+    void stopReplay();
+    bool isReplaying() const;
+
 signals:
     void beginMeasurement();
     void endMeasurement();
@@ -104,18 +119,25 @@ signals:
 
     void onSetupDialogCreated(SetupDialog &dlg);
 
+    void replayFinished();
+
 public slots:
 
+private slots:
+    void onReplayFinished();
+
 private:
     static Backend *_instance;
 
     bool _measurementRunning;
-    uint64_t _measurementStartTime;
+    uint64_t _measurementStartTime; // HostClock nanoseconds
     QElapsedTimer _timerSinceStart;
     QList<CanDriver*> _drivers;
     MeasurementSetup _setup;
     CanTrace *_trace;
     QList<CanListener*> _listeners;
+    bool _useSharedIoThread;
+    CanReplay *_replay;
 
     LogModel *_logModel;
 
@@ -0,0 +1,163 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanCaptureFilter.h"
+
+#include <QStringList>
+#include <core/CanMessage.h>
+
+CanCaptureFilter::CanCaptureFilter()
+  : _errorMask(0)
+{
+}
+
+bool CanCaptureFilter::isEmpty() const
+{
+    return _rules.isEmpty() && (_errorMask == 0);
+}
+
+bool CanCaptureFilter::capturesEverything() const
+{
+    return _rules.isEmpty();
+}
+
+void CanCaptureFilter::clear()
+{
+    _rules.clear();
+    _errorMask = 0;
+}
+
+void CanCaptureFilter::addRule(uint32_t id, uint32_t mask, bool inverted)
+{
+    Rule rule;
+    rule.id = id;
+    rule.mask = mask & ~flag_error;
+    rule.inverted = inverted;
+    _rules.append(rule);
+}
+
+const QList<CanCaptureFilter::Rule> &CanCaptureFilter::rules() const
+{
+    return _rules;
+}
+
+uint32_t CanCaptureFilter::errorMask() const
+{
+    return _errorMask;
+}
+
+void CanCaptureFilter::setErrorMask(uint32_t errorMask)
+{
+    _errorMask = errorMask & mask_id_ext;
+}
+
+bool CanCaptureFilter::matches(const CanMessage &msg) const
+{
+    if (msg.isGapMarker()) {
+        return true;
+    }
+
+    if (msg.isErrorFrame()) {
+        return (msg.getId() & _errorMask & mask_id_ext) != 0;
+    }
+
+    if (_rules.isEmpty()) {
+        return true;
+    }
+
+    uint32_t id = msg.getId() & mask_id_ext;
+    if (msg.isExtended()) { id |= flag_extended; }
+    if (msg.isRTR()) { id |= flag_rtr; }
+
+    foreach (const Rule &rule, _rules) {
+        bool hit = (id & rule.mask) == (rule.id & rule.mask);
+        if (hit != rule.inverted) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString CanCaptureFilter::toString() const
+{
+    QStringList items;
+    foreach (const Rule &rule, _rules) {
+        QString id = (rule.id & flag_extended)
+            ? QString().asprintf("%08X", rule.id & mask_id_ext)
+            : QString().asprintf("%03X", rule.id & mask_id_ext);
+        items.append(id + (rule.inverted ? "~" : ":") + QString().asprintf("%X", rule.mask));
+    }
+    if (_errorMask) {
+        items.append(QString().asprintf("#%X", _errorMask));
+    }
+    return items.join(", ");
+}
+
+bool CanCaptureFilter::fromString(QString str)
+{
+    clear();
+
+    bool retval = true;
+    foreach (QString item, str.split(",")) {
+        item = item.trimmed();
+        if (item.isEmpty()) {
+            continue;
+        }
+
+        bool ok_id = false;
+        bool ok_mask = false;
+
+        if (item.startsWith('#')) {
+            uint32_t mask = item.mid(1).toUInt(&ok_mask, 16);
+            if (ok_mask) {
+                setErrorMask(mask);
+            } else {
+                retval = false;
+            }
+            continue;
+        }
+
+        int sep = item.indexOf(':');
+        if (sep < 0) {
+            sep = item.indexOf('~');
+        }
+        if (sep < 0) {
+            retval = false;
+            continue;
+        }
+
+        QString id_str = item.left(sep).trimmed();
+        uint32_t id = id_str.toUInt(&ok_id, 16);
+        uint32_t mask = item.mid(sep+1).trimmed().toUInt(&ok_mask, 16);
+        if (!ok_id || !ok_mask) {
+            retval = false;
+            continue;
+        }
+
+        // like candump: an 8 digit id denotes an extended frame
+        if (id_str.length() == 8) {
+            id |= flag_extended;
+        }
+        addRule(id, mask, item.at(sep) == '~');
+    }
+
+    return retval;
+}
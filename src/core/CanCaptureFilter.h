@@ -0,0 +1,79 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QList>
+#include <QString>
+
+class CanMessage;
+
+/*
+ * Per-interface capture filter with SocketCAN CAN_RAW_FILTER semantics:
+ * a frame is captured if any rule matches, a rule matches if
+ * (frame_id & mask) == (id & mask), inverted rules match the opposite.
+ * Ids carry the extended/rtr flags in the kernel's encoding, so one rule
+ * can tell 11-bit from 29-bit frames. Error frames are selected separately
+ * by a mask over the error classes.
+ *
+ * An empty rule list captures every data frame. The text form follows
+ * candump: "123:7FF", "200~7F0" (inverted), "12345678:1FFFFFFF"
+ * (8 digits: extended) and "#FFFFFFFF" (error mask), comma separated.
+ */
+class CanCaptureFilter
+{
+public:
+    enum {
+        flag_extended = 0x80000000U, // CAN_EFF_FLAG
+        flag_rtr      = 0x40000000U, // CAN_RTR_FLAG
+        flag_error    = 0x20000000U, // CAN_ERR_FLAG
+        mask_id_ext   = 0x1FFFFFFFU,
+        mask_id_std   = 0x000007FFU
+    };
+
+    struct Rule {
+        uint32_t id;
+        uint32_t mask;
+        bool inverted;
+    };
+
+    CanCaptureFilter();
+
+    bool isEmpty() const;
+    bool capturesEverything() const;
+    void clear();
+
+    void addRule(uint32_t id, uint32_t mask, bool inverted=false);
+    const QList<Rule> &rules() const;
+
+    uint32_t errorMask() const;
+    void setErrorMask(uint32_t errorMask);
+
+    bool matches(const CanMessage &msg) const;
+
+    QString toString() const;
+    bool fromString(QString str);
+
+private:
+    QList<Rule> _rules;
+    uint32_t _errorMask;
+};
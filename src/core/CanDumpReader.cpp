@@ -0,0 +1,196 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanDumpReader.h"
+#include "CanCaptureFilter.h"
+
+#include <QFile>
+#include <core/Backend.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+CanDumpReader::CanDumpReader()
+  : _badLines(0)
+{
+}
+
+const QVector<CanMessage> &CanDumpReader::getFrames() const
+{
+    return _frames;
+}
+
+QStringList CanDumpReader::getInterfaceNames() const
+{
+    return _interfaceNames;
+}
+
+int CanDumpReader::getBadLines() const
+{
+    return _badLines;
+}
+
+bool CanDumpReader::load(const QString &filename)
+{
+    _frames.clear();
+    _interfaceNames.clear();
+    _badLines = 0;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        log_error(QString("Cannot open %1: %2").arg(filename).arg(file.errorString()));
+        return false;
+    }
+
+    char line[512];
+    while (file.readLine(line, sizeof(line)) > 0) {
+        if ((line[0] == '\n') || (line[0] == '#')) {
+            continue;
+        }
+        CanMessage msg;
+        if (parseLine(line, msg)) {
+            _frames.append(msg);
+        } else {
+            _badLines++;
+        }
+    }
+
+    if (_badLines) {
+        log_warning(QString("%1: skipped %2 lines that are not candump frames").arg(filename).arg(_badLines));
+    }
+    log_info(QString("Read %1 frames from %2").arg(_frames.size()).arg(filename));
+    return true;
+}
+
+static int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    return -1;
+}
+
+bool CanDumpReader::parseLine(const char *line, CanMessage &msg)
+{
+    // (seconds.fraction)
+    if (*line++ != '(') {
+        return false;
+    }
+    char *end;
+    uint64_t secs = strtoull(line, &end, 10);
+    if ((end == line) || (*end != '.')) {
+        return false;
+    }
+    line = end + 1;
+    uint64_t nsecs = 0;
+    int digits = 0;
+    while ((*line >= '0') && (*line <= '9')) {
+        if (digits < 9) {
+            nsecs = nsecs * 10 + (*line - '0');
+            digits++;
+        }
+        line++;
+    }
+    for (; digits < 9; digits++) {
+        nsecs *= 10;
+    }
+    if ((line[0] != ')') || (line[1] != ' ')) {
+        return false;
+    }
+    line += 2;
+
+    // interface
+    const char *name = line;
+    while (*line && (*line != ' ')) {
+        line++;
+    }
+    if (*line != ' ') {
+        return false;
+    }
+    QString ifname = QString::fromLatin1(name, line - name);
+    line++;
+
+    // id; like candump, 8 digits denote an extended frame
+    const char *id_start = line;
+    uint32_t id = 0;
+    int d;
+    while ((d = hexValue(*line)) >= 0) {
+        id = (id << 4) | d;
+        line++;
+    }
+    int id_len = line - id_start;
+    if (((id_len != 3) && (id_len != 8)) || (*line != '#')) {
+        return false;
+    }
+    line++;
+
+    msg.setTimestampNs(secs * 1000000000 + nsecs);
+    msg.setId(id & CanCaptureFilter::mask_id_ext);
+    if (id_len == 8) {
+        // candump marks error frames with CAN_ERR_FLAG in the id
+        if (id & CanCaptureFilter::flag_error) {
+            msg.setErrorFrame(true);
+        } else {
+            msg.setExtended(true);
+        }
+    }
+
+    if (*line == 'R') {
+        msg.setRTR(true);
+        line++;
+        msg.setLength((hexValue(*line) > 0) ? hexValue(*line) : 0);
+    } else {
+        int max_len = 8;
+        if (*line == '#') {
+            int flags = hexValue(line[1]);
+            if (flags < 0) {
+                return false;
+            }
+            msg.setFD(true);
+            msg.setBRS(flags & 1);
+            msg.setESI(flags & 2);
+            max_len = 64;
+            line += 2;
+        }
+
+        uint8_t len = 0;
+        int hi, lo;
+        while (((hi = hexValue(line[0])) >= 0) && ((lo = hexValue(line[1])) >= 0)) {
+            if (len >= max_len) {
+                return false;
+            }
+            msg.setByte(len++, (hi << 4) | lo);
+            line += 2;
+            if (*line == '.') {
+                line++;
+            }
+        }
+        msg.setLength(len);
+    }
+
+    int ifidx = _interfaceNames.indexOf(ifname);
+    if (ifidx < 0) {
+        ifidx = _interfaceNames.size();
+        _interfaceNames.append(ifname);
+    }
+    msg.setInterfaceId(ifidx);
+    return true;
+}
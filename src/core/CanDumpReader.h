@@ -0,0 +1,56 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "CanMessage.h"
+
+/*
+ * Reads a candump log file, the format CanDumpWriter and "candump -l"
+ * write: "(1436509052.249713) can0 123#DEADBEEF". Classic, extended, RTR
+ * ("123#R"), error and FD ("123##1DEAD") frames are understood.
+ *
+ * The frames get interface ids in order of the first appearance of their
+ * interface name: the frames of getInterfaceNames()[n] have id n. These
+ * are not the ids of cangaroo's interfaces; map them when replaying.
+ */
+class CanDumpReader
+{
+public:
+    CanDumpReader();
+
+    bool load(const QString &filename);
+
+    const QVector<CanMessage> &getFrames() const;
+    QStringList getInterfaceNames() const;
+    int getBadLines() const;
+
+private:
+    QVector<CanMessage> _frames;
+    QStringList _interfaceNames;
+    int _badLines;
+
+    bool parseLine(const char *line, CanMessage &msg);
+};
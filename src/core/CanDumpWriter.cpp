@@ -0,0 +1,193 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanDumpWriter.h"
+#include "CanMessage.h"
+
+#include <core/Backend.h>
+
+#include <stdio.h>
+
+CanDumpWriter::CanDumpWriter(Backend &backend)
+  : _backend(backend),
+    _file(0),
+    _writeFailed(false),
+    _frames(0),
+    _lostFrames(0),
+    _bytesWritten(0)
+{
+    _buf.reserve(write_threshold + 256);
+}
+
+CanDumpWriter::~CanDumpWriter()
+{
+    close();
+}
+
+bool CanDumpWriter::open(const QString &filename)
+{
+    QFile *file = new QFile(filename);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        log_error(QString("Cannot open capture file %1: %2").arg(filename).arg(file->errorString()));
+        delete file;
+        return false;
+    }
+
+    close();
+    _file = file;
+    _writeFailed = false;
+    log_info(QString("Capturing to %1").arg(filename));
+    return true;
+}
+
+void CanDumpWriter::close()
+{
+    if (_file) {
+        writeBuffer();
+        _file->close();
+        _lastFileName = _file->fileName();
+        delete _file;
+        _file = 0;
+    }
+    _buf.clear();
+}
+
+bool CanDumpWriter::isOpen() const
+{
+    return _file != 0;
+}
+
+QString CanDumpWriter::getFileName() const
+{
+    return _file ? _file->fileName() : _lastFileName;
+}
+
+const QByteArray &CanDumpWriter::interfaceName(CanInterfaceId id)
+{
+    QHash<CanInterfaceId, QByteArray>::iterator it = _interfaceNames.find(id);
+    if (it == _interfaceNames.end()) {
+        it = _interfaceNames.insert(id, _backend.getInterfaceName(id).toLatin1());
+    }
+    return it.value();
+}
+
+static char *appendHex(char *p, uint32_t value, int digits)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (int i=digits-1; i>=0; i--) {
+        p[i] = hex[value & 0x0F];
+        value >>= 4;
+    }
+    return p + digits;
+}
+
+void CanDumpWriter::publish(const CanMessage &msg)
+{
+    if (msg.isGapMarker()) {
+        _lostFrames += msg.getId();
+        return;
+    }
+
+    _frames++;
+    if (!_file) {
+        return;
+    }
+
+    // "(sec.usec) " + interface + " 12345678##F" + 128 payload digits + "\n" stays well below this
+    char line[192];
+    uint64_t ts = msg.getTimestampNs();
+    int n = snprintf(line, 32, "(%llu.%06u) ", (unsigned long long)(ts / 1000000000), (unsigned)((ts % 1000000000) / 1000));
+    _buf.append(line, n);
+    _buf.append(interfaceName(msg.getInterfaceId()));
+
+    char *p = line;
+    *p++ = ' ';
+    if (msg.isErrorFrame()) {
+        p = appendHex(p, 0x20000000 | (msg.getId() & 0x1FFFFFFF), 8);
+    } else if (msg.isExtended()) {
+        p = appendHex(p, msg.getId(), 8);
+    } else {
+        p = appendHex(p, msg.getId(), 3);
+    }
+    *p++ = '#';
+
+    if (msg.isRTR()) {
+        // ID#R<dlc>, like candump; the dlc is left out when it is 0
+        *p++ = 'R';
+        if (msg.getLength()) {
+            p = appendHex(p, msg.getLength(), 1);
+        }
+    } else {
+        if (msg.isFD()) {
+            // ID##<flags><data>, flags being CANFD_BRS (1) | CANFD_ESI (2)
+            *p++ = '#';
+            p = appendHex(p, (msg.isBRS() ? 1 : 0) | (msg.isESI() ? 2 : 0), 1);
+        }
+        uint8_t len = msg.getLength();
+        for (uint8_t i=0; i<len; i++) {
+            p = appendHex(p, msg.getByte(i), 2);
+        }
+    }
+    *p++ = '\n';
+    _buf.append(line, p - line);
+
+    if (_buf.size() >= write_threshold) {
+        writeBuffer();
+    }
+}
+
+void CanDumpWriter::notify()
+{
+    writeBuffer();
+}
+
+void CanDumpWriter::writeBuffer()
+{
+    if (_buf.isEmpty() || !_file) {
+        return;
+    }
+
+    qint64 written = _file->write(_buf);
+    if (written == _buf.size()) {
+        _bytesWritten += written;
+        _writeFailed = false;
+    } else if (!_writeFailed) {
+        // e.g. disk full; report once, keep trying with the next batch
+        log_error(QString("Cannot write capture file %1: %2").arg(_file->fileName()).arg(_file->errorString()));
+        _writeFailed = true;
+    }
+    _buf.clear();
+}
+
+uint64_t CanDumpWriter::getFrames() const
+{
+    return _frames;
+}
+
+uint64_t CanDumpWriter::getLostFrames() const
+{
+    return _lostFrames;
+}
+
+uint64_t CanDumpWriter::getBytesWritten() const
+{
+    return _bytesWritten;
+}
@@ -0,0 +1,82 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+
+#include "CanTraceSink.h"
+#include <driver/CanDriver.h>
+
+class Backend;
+
+/*
+ * Writes the frames entering the trace to a file in candump log format,
+ * "(1436509052.249713) can0 123#DEADBEEF", one frame per line.
+ *
+ * Lines are collected in memory and written once per batch (notify()),
+ * so a busy bus costs one write per flush of the trace, not one per
+ * frame. Gap markers are not frames and are not written; they are counted
+ * in getLostFrames(). Use it from the thread that feeds the trace.
+ */
+class CanDumpWriter : public CanTraceSink
+{
+public:
+    explicit CanDumpWriter(Backend &backend);
+    virtual ~CanDumpWriter();
+
+    // appends if the file exists; the previous file, if any, is closed once
+    // the new one is open, and kept on if the new one cannot be opened
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const;
+    QString getFileName() const;
+
+    virtual void publish(const CanMessage &msg);
+    virtual void notify();
+
+    uint64_t getFrames() const;
+    uint64_t getLostFrames() const;
+    uint64_t getBytesWritten() const;
+
+private:
+    enum {
+        write_threshold = 1048576 // bytes; write early within a batch beyond this
+    };
+
+    Backend &_backend;
+    QFile *_file;
+    QString _lastFileName; // reported by getFileName() after close()
+    QByteArray _buf;
+    QHash<CanInterfaceId, QByteArray> _interfaceNames;
+    bool _writeFailed;
+
+    uint64_t _frames;
+    uint64_t _lostFrames;
+    uint64_t _bytesWritten;
+
+    const QByteArray &interfaceName(CanInterfaceId id);
+    void writeBuffer();
+};
@@ -23,6 +23,7 @@
 
 #include "CanMessage.h"
 #include <core/portable_endian.h>
+#include <string.h>
 #include <QDebug>
 enum {
 	id_flag_extended = 0x80000000,
@@ -34,10 +35,12 @@ enum {
 
 CanMessage::CanMessage()
 {
-    _timestamp.tv_sec = 0;
-    _timestamp.tv_usec = 0;
+    _timestamp_ns = 0;
+    _timestamp_source = timestamp_source_host;
     _isBRS = false;
+    _isESI = false;
     _isFD = false;
+    _isGapMarker = false;
     _dlc = 0;
     _raw_id= 0;
     _interface = 0;
@@ -47,9 +50,11 @@ CanMessage::CanMessage()
 
 CanMessage::CanMessage(uint32_t can_id)
 {
-    _timestamp.tv_sec = 0;
-    _timestamp.tv_usec = 0;
+    _timestamp_ns = 0;
+    _timestamp_source = timestamp_source_host;
     _isBRS = 0;
+    _isESI = false;
+    _isGapMarker = false;
     setId(can_id);
 }
 
@@ -64,6 +69,8 @@ void CanMessage::cloneFrom(const CanMessage &msg)
     _dlc = msg._dlc;
     _isFD = msg.isFD();
     _isBRS = msg.isBRS();
+    _isESI = msg.isESI();
+    _isGapMarker = msg._isGapMarker;
     _isExd = msg.isExtended();
     _isRTR = msg.isRTR();
     this->_direction = msg._direction;
@@ -74,7 +81,8 @@ void CanMessage::cloneFrom(const CanMessage &msg)
     }
 
     _interface = msg._interface;
-    _timestamp = msg._timestamp;
+    _timestamp_ns = msg._timestamp_ns;
+    _timestamp_source = msg._timestamp_source;
 }
 
 
@@ -126,6 +134,14 @@ void CanMessage::setBRS(const bool isBRS) {
     _isBRS = isBRS;
 }
 
+bool CanMessage::isESI() const {
+    return _isESI;
+}
+
+void CanMessage::setESI(const bool isESI) {
+    _isESI = isESI;
+}
+
 bool CanMessage::isErrorFrame() const {
 	return (_raw_id & id_flag_error) != 0;
 }
@@ -138,6 +154,16 @@ void CanMessage::setErrorFrame(const bool isErrorFrame) {
     }
 }
 
+bool CanMessage::isGapMarker() const
+{
+    return _isGapMarker;
+}
+
+void CanMessage::setGapMarker(const bool isGapMarker)
+{
+    _isGapMarker = isGapMarker;
+}
+
 CanInterfaceId CanMessage::getInterfaceId() const
 {
     return _interface;
@@ -289,30 +315,74 @@ void CanMessage::setData(const uint8_t d0, const uint8_t d1, const uint8_t d2,
     _u8[7] = d7;
 }
 
+void CanMessage::setData(const uint8_t *data, const uint8_t length)
+{
+    _dlc = (length <= sizeof(_u8)) ? length : sizeof(_u8);
+    memcpy(_u8, data, _dlc);
+}
+
 timeval CanMessage::getTimestamp() const
 {
-    return _timestamp;
+    struct timeval tv;
+    tv.tv_sec = _timestamp_ns / 1000000000;
+    tv.tv_usec = (_timestamp_ns % 1000000000) / 1000;
+    return tv;
 }
 
 void CanMessage::setTimestamp(const timeval timestamp)
 {
-    _timestamp = timestamp;
+    setTimestamp(timestamp.tv_sec, timestamp.tv_usec);
 }
 
 void CanMessage::setTimestamp(const uint64_t seconds, const uint32_t micro_seconds)
 {
-    _timestamp.tv_sec = seconds;
-    _timestamp.tv_usec = micro_seconds;
+    _timestamp_ns = (seconds * 1000000000) + ((uint64_t)micro_seconds * 1000);
+}
+
+uint64_t CanMessage::getTimestampNs() const
+{
+    return _timestamp_ns;
+}
+
+void CanMessage::setTimestampNs(const uint64_t nsecs)
+{
+    _timestamp_ns = nsecs;
+}
+
+void CanMessage::setTimestamp(const timespec &timestamp)
+{
+    _timestamp_ns = ((uint64_t)timestamp.tv_sec * 1000000000) + timestamp.tv_nsec;
+}
+
+CanMessage::TimestampSource CanMessage::getTimestampSource() const
+{
+    return _timestamp_source;
+}
+
+void CanMessage::setTimestampSource(TimestampSource source)
+{
+    _timestamp_source = source;
+}
+
+QString CanMessage::getTimestampSourceStr(TimestampSource source)
+{
+    switch (source) {
+        case timestamp_source_host: return "host clock";
+        case timestamp_source_kernel_software: return "kernel software";
+        case timestamp_source_kernel_hardware: return "kernel hardware";
+        case timestamp_source_device: return "device";
+        default: return "unknown";
+    }
 }
 
 double CanMessage::getFloatTimestamp() const
 {
-    return (double)_timestamp.tv_sec + ((double)_timestamp.tv_usec/1000000);
+    return (double)_timestamp_ns / 1000000000;
 }
 
 QDateTime CanMessage::getDateTime() const
 {
-    return QDateTime::fromMSecsSinceEpoch((qint64)(1000*getFloatTimestamp()));
+    return QDateTime::fromMSecsSinceEpoch((qint64)(_timestamp_ns / 1000000));
 }
 
 QString CanMessage::getIdString() const
@@ -33,6 +33,13 @@ public:
     enum Direction {
         Rx,
         Tx
+    };
+    // clock domain the timestamp was taken in; stamps of different domains are not directly comparable
+    enum TimestampSource {
+        timestamp_source_host,
+        timestamp_source_kernel_software,
+        timestamp_source_kernel_hardware,
+        timestamp_source_device
     };
 	CanMessage();
 	CanMessage(uint32_t can_id);
@@ -57,9 +64,17 @@ public:
     bool isBRS() const;
     void setBRS(const bool isFD);
 
+    bool isESI() const;
+    void setESI(const bool isESI);
+
     bool isErrorFrame() const;
 	void setErrorFrame(const bool isErrorFrame);
 
+    // A gap marker is not a frame: it records that the receive path lost
+    // frames right before it; getId() holds the number of frames lost.
+    bool isGapMarker() const;
+    void setGapMarker(const bool isGapMarker);
+
     CanInterfaceId getInterfaceId() const;
     void setInterfaceId(CanInterfaceId interface);
 
@@ -80,11 +95,20 @@ public:
 	void setData(const uint8_t d0, const uint8_t d1, const uint8_t d2, const uint8_t d3, const uint8_t d4, const uint8_t d5);
 	void setData(const uint8_t d0, const uint8_t d1, const uint8_t d2, const uint8_t d3, const uint8_t d4, const uint8_t d5, const uint8_t d6);
 	void setData(const uint8_t d0, const uint8_t d1, const uint8_t d2, const uint8_t d3, const uint8_t d4, const uint8_t d5, const uint8_t d6, const uint8_t d7);
+    void setData(const uint8_t *data, const uint8_t length);
 
     struct timeval getTimestamp() const;
     void setTimestamp(const struct timeval timestamp);
     void setTimestamp(const uint64_t seconds, const uint32_t micro_seconds);
 
+    TimestampSource getTimestampSource() const;
+    void setTimestampSource(TimestampSource source);
+    static QString getTimestampSourceStr(TimestampSource source);
+
+    uint64_t getTimestampNs() const;
+    void setTimestampNs(const uint64_t nsecs);
+    void setTimestamp(const struct timespec &timestamp);
+
     double getFloatTimestamp() const;
     QDateTime getDateTime() const;
 
@@ -101,11 +125,14 @@ private:
         uint32_t _u32[2*8];
         uint64_t _u64[8];
 	};
-    struct timeval _timestamp;
+    uint64_t _timestamp_ns; // since the epoch of the clock domain
+    TimestampSource _timestamp_source;
     uint32_t _raw_id;
     uint8_t _dlc;
     bool _isFD;
     bool _isBRS;
+    bool _isESI;
+    bool _isGapMarker;
     bool _isExd;
     bool _isRTR;
     CanInterfaceId _interface;
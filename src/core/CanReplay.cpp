@@ -0,0 +1,359 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanReplay.h"
+#include "CanTrace.h"
+#include "CanCaptureFilter.h"
+
+#include <QThread>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include <core/Backend.h>
+#include <driver/CanInterface.h>
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#else
+#include <chrono>
+#endif
+
+static const uint64_t hist_bounds_ns[CanReplay::hist_buckets - 1] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+    1000000, 2000000, 5000000, 10000000
+};
+
+CanReplay::CanReplay(QObject *parent)
+  : QObject(parent),
+    _speed(1.0),
+    _loops(1),
+    _spinNs(200000),
+    _realtime(false),
+    _shouldBeRunning(false),
+    _running(0)
+{
+    _thread = new QThread();
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+CanReplay::~CanReplay()
+{
+    waitFinish();
+    delete _thread;
+}
+
+void CanReplay::setFrames(const QVector<CanMessage> &frames)
+{
+    _frames = frames;
+}
+
+void CanReplay::setFramesFromTrace(CanTrace &trace)
+{
+    unsigned long count = trace.size();
+    _frames.clear();
+    _frames.reserve(count);
+
+    CanMessage msg;
+    for (unsigned long i=0; i<count; i++) {
+        if (trace.getMessage(i, msg)) {
+            _frames.append(msg);
+        }
+    }
+}
+
+int CanReplay::getFrameCount() const
+{
+    return _frames.size();
+}
+
+void CanReplay::mapChannel(CanInterfaceId source, CanInterface *target)
+{
+    _channels[source] = target;
+}
+
+void CanReplay::mapId(uint32_t from, uint32_t to)
+{
+    _ids[from] = to;
+}
+
+void CanReplay::setSpeed(double factor)
+{
+    _speed = (factor > 0) ? factor : 0;
+}
+
+void CanReplay::setLoops(unsigned loops)
+{
+    _loops = loops;
+}
+
+void CanReplay::setSpinTime(unsigned us)
+{
+    _spinNs = (uint64_t)us * 1000;
+}
+
+void CanReplay::setRealtime(bool realtime)
+{
+    _realtime = realtime;
+}
+
+bool CanReplay::isRunning() const
+{
+    return _running.loadAcquire() != 0;
+}
+
+void CanReplay::startThread()
+{
+    _shouldBeRunning = true;
+    _running.storeRelease(1);
+    moveToThread(_thread);
+    connect(_thread, SIGNAL(started()), this, SLOT(run()));
+    _thread->start();
+}
+
+void CanReplay::requestStop()
+{
+    _shouldBeRunning = false;
+}
+
+void CanReplay::waitFinish()
+{
+    requestStop();
+    _thread->wait();
+}
+
+uint64_t CanReplay::monotonicNs()
+{
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool CanReplay::waitUntil(uint64_t deadline)
+{
+    // sleep in slices so a stop request is noticed during long gaps
+    const uint64_t slice = 100000000;
+
+    for (;;) {
+        if (!_shouldBeRunning) {
+            return false;
+        }
+
+        uint64_t now = monotonicNs();
+        if (now + _spinNs >= deadline) {
+            break;
+        }
+
+        uint64_t wake = deadline - _spinNs;
+        if (wake > now + slice) {
+            wake = now + slice;
+        }
+#if defined(__linux__)
+        struct timespec ts;
+        ts.tv_sec = wake / 1000000000;
+        ts.tv_nsec = wake % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+        }
+#else
+        QThread::usleep((wake - now) / 1000);
+#endif
+    }
+
+    // the scheduler wakes us up tens of microseconds late at best; the last stretch is spun
+    while (monotonicNs() < deadline) {
+    }
+    return true;
+}
+
+void CanReplay::record(uint64_t error_ns)
+{
+    int bucket = 0;
+    while ((bucket < hist_buckets - 1) && (error_ns >= hist_bounds_ns[bucket])) {
+        bucket++;
+    }
+
+    QMutexLocker locker(&_statsMutex);
+    _stats.sent++;
+    _stats.histogram[bucket]++;
+    _stats.sum_error_ns += error_ns;
+    if (error_ns > _stats.max_error_ns) {
+        _stats.max_error_ns = error_ns;
+    }
+}
+
+void CanReplay::applyRealtime()
+{
+#if defined(__linux__)
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        log_warning(QString("Replay runs without realtime priority: %1").arg(strerror(err)));
+    }
+#else
+    log_warning("Replay runs without realtime priority: not supported on this platform");
+#endif
+}
+
+void CanReplay::run()
+{
+#if defined(__linux__)
+    // the default 50us timer slack would be added to every sleep
+    prctl(PR_SET_TIMERSLACK, 1);
+#endif
+    if (_realtime) {
+        applyRealtime();
+    }
+
+    // the first frame is scheduled slightly ahead, so it is on time as well
+    uint64_t base = monotonicNs() + 1000000;
+    uint64_t first_ts = _frames.isEmpty() ? 0 : _frames.first().getTimestampNs();
+
+    for (unsigned loop=0; _shouldBeRunning && ((_loops == 0) || (loop < _loops)); loop++) {
+        uint64_t deadline = base;
+
+        for (int i=0; i<_frames.size(); i++) {
+            const CanMessage &msg = _frames.at(i);
+            // nothing to send for a gap marker; error frames are reported by controllers, not sent
+            if (msg.isGapMarker() || msg.isErrorFrame()) {
+                continue;
+            }
+
+            CanInterface *target = _channels.value(msg.getInterfaceId(), 0);
+            if (!target) {
+                QMutexLocker locker(&_statsMutex);
+                _stats.skipped++;
+                continue;
+            }
+
+            if (_speed > 0) {
+                uint64_t ts = msg.getTimestampNs();
+                uint64_t offset = (ts > first_ts) ? (ts - first_ts) : 0;
+                deadline = base + (uint64_t)(offset / _speed);
+                if (!waitUntil(deadline)) {
+                    break;
+                }
+            } else {
+                deadline = monotonicNs();
+            }
+
+            // a backed up driver queue would only turn into dropped frames; wait for it and count the frame as late
+            if (target->getTxFlowState() != CanInterface::tx_flow_ok) {
+                {
+                    QMutexLocker locker(&_statsMutex);
+                    _stats.throttled++;
+                }
+                while (_shouldBeRunning && (target->getTxFlowState() != CanInterface::tx_flow_ok)) {
+                    QThread::usleep(100);
+                }
+            }
+
+            uint64_t now = monotonicNs();
+
+            CanMessage out(msg);
+            out.setInterfaceId(target->getId());
+            out.setDirection(CanMessage::Tx);
+            if (!_ids.isEmpty()) {
+                uint32_t key = out.getId() | (out.isExtended() ? (uint32_t)CanCaptureFilter::flag_extended : 0);
+                QMap<uint32_t, uint32_t>::const_iterator it = _ids.constFind(key);
+                if (it != _ids.constEnd()) {
+                    out.setId(it.value() & CanCaptureFilter::mask_id_ext);
+                    out.setExtended((it.value() & CanCaptureFilter::flag_extended) != 0);
+                }
+            }
+            target->sendMessage(out);
+
+            record(now - deadline);
+        }
+
+        if (!_shouldBeRunning) {
+            break;
+        }
+
+        {
+            QMutexLocker locker(&_statsMutex);
+            _stats.loops++;
+        }
+
+        // the next pass starts right where this one ended
+        base = (_speed > 0) ? deadline : monotonicNs();
+    }
+
+    _running.storeRelease(0);
+    emit finished();
+    _thread->quit();
+}
+
+CanReplay::Stats CanReplay::getStats() const
+{
+    QMutexLocker locker(&_statsMutex);
+    return _stats;
+}
+
+uint64_t CanReplay::histogramBound(int bucket)
+{
+    return (bucket < hist_buckets - 1) ? hist_bounds_ns[bucket] : 0;
+}
+
+QString CanReplay::getStatsStr() const
+{
+    Stats stats = getStats();
+
+    QString str = QString("sent %1, skipped %2, throttled %3, loops %4")
+        .arg((unsigned long long)stats.sent)
+        .arg((unsigned long long)stats.skipped)
+        .arg((unsigned long long)stats.throttled)
+        .arg(stats.loops);
+    if (!stats.sent) {
+        return str;
+    }
+
+    str += QString("; timing error mean %1 us, max %2 us; ")
+        .arg(stats.sum_error_ns / 1000.0 / stats.sent, 0, 'f', 1)
+        .arg(stats.max_error_ns / 1000.0, 0, 'f', 1);
+
+    QStringList buckets;
+    for (int i=0; i<hist_buckets; i++) {
+        if (!stats.histogram[i]) {
+            continue;
+        }
+        QString bound;
+        if (i == hist_buckets - 1) {
+            bound = QString(">=%1ms").arg(hist_bounds_ns[i-1] / 1000000);
+        } else if (hist_bounds_ns[i] < 1000000) {
+            bound = QString("<%1us").arg(hist_bounds_ns[i] / 1000);
+        } else {
+            bound = QString("<%1ms").arg(hist_bounds_ns[i] / 1000000);
+        }
+        buckets.append(QString("%1: %2").arg(bound).arg((unsigned long long)stats.histogram[i]));
+    }
+    return str + buckets.join(", ");
+}
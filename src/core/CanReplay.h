@@ -0,0 +1,132 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QString>
+
+#include "CanMessage.h"
+#include <driver/CanDriver.h>
+
+class QThread;
+class CanInterface;
+class CanTrace;
+
+/*
+ * Plays recorded frames back onto interfaces from a dedicated thread,
+ * keeping the recorded gaps between frames.
+ *
+ * Every frame has an absolute deadline: start + (timestamp - first
+ * timestamp) / speed. The thread sleeps with clock_nanosleep() until
+ * shortly before it and spins for the rest, so an early wakeup or a slow
+ * frame does not shift the frames after it. The timing error of each
+ * frame is the time from its deadline until sendMessage() is called, and
+ * goes into a histogram.
+ *
+ * Frames go to the interface their source channel is mapped to; frames of
+ * unmapped channels are skipped. The target interfaces must be open, i.e.
+ * part of the running measurement.
+ */
+class CanReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum {
+        hist_buckets = 14 // upper bounds: 1, 2, 5, 10, 20, 50, 100, 200, 500 us, 1, 2, 5, 10 ms, above
+    };
+
+    struct Stats {
+        uint64_t sent;
+        uint64_t skipped;      // no target interface
+        uint64_t throttled;    // frames that waited for the target's transmit queue
+        unsigned loops;        // passes completed
+        uint64_t histogram[hist_buckets];
+        uint64_t sum_error_ns;
+        uint64_t max_error_ns;
+    };
+
+    explicit CanReplay(QObject *parent=0);
+    virtual ~CanReplay();
+
+    // frames in the order to send them; gap markers and error frames are skipped
+    void setFrames(const QVector<CanMessage> &frames);
+    // a snapshot of the trace, which can keep growing meanwhile
+    void setFramesFromTrace(CanTrace &trace);
+    int getFrameCount() const;
+
+    void mapChannel(CanInterfaceId source, CanInterface *target);
+    // ids in the CanCaptureFilter notation, i.e. with CanCaptureFilter::flag_extended for extended frames
+    void mapId(uint32_t from, uint32_t to);
+
+    // 2.0 plays twice as fast; 0 sends back to back
+    void setSpeed(double factor);
+    // 0 repeats until stopped
+    void setLoops(unsigned loops);
+    // how long before a deadline to stop sleeping and spin (default 200us)
+    void setSpinTime(unsigned us);
+    // SCHED_FIFO for the replay thread, if permitted
+    void setRealtime(bool realtime);
+
+    bool isRunning() const;
+    Stats getStats() const;
+    QString getStatsStr() const;
+
+    static uint64_t histogramBound(int bucket);
+
+signals:
+    void finished();
+
+public slots:
+    void startThread();
+    void requestStop();
+    void waitFinish();
+
+private slots:
+    void run();
+
+private:
+    QThread *_thread;
+    QVector<CanMessage> _frames;
+    QMap<CanInterfaceId, CanInterface*> _channels;
+    QMap<uint32_t, uint32_t> _ids;
+    double _speed;
+    unsigned _loops;
+    uint64_t _spinNs;
+    bool _realtime;
+
+    bool _shouldBeRunning;
+    QAtomicInt _running;
+
+    mutable QMutex _statsMutex;
+    Stats _stats;
+
+    static uint64_t monotonicNs();
+    bool waitUntil(uint64_t deadline);
+    void record(uint64_t error_ns);
+    void applyRealtime();
+};
@@ -23,6 +23,7 @@
 #include <QMutexLocker>
 #include <QFile>
 #include <QTextStream>
+#include <QVarLengthArray>
 
 #include <core/Backend.h>
 #include <core/CanMessage.h>
@@ -35,10 +36,11 @@
 CanTrace::CanTrace(Backend &backend, QObject *parent, int flushInterval)
   : QObject(parent),
     _backend(backend),
-    _isTimerRunning(false),
+    _isTimerRunning(0),
+    _retainFrames(true),
     _mutex(QMutex::Recursive),
-    _timerMutex(),
-    _flushTimer(this)
+    _flushTimer(this),
+    _disp_ch(All)
 {
     clear();
     _flushTimer.setSingleShot(true);
@@ -56,39 +58,59 @@ void CanTrace::clear()
 {
     QMutexLocker locker(&_mutex);
     emit beforeClear();
-    _data.resize(pool_chunk_size);
+    _data.clear();
     _dataRowsUsed = 0;
     _newRows = 0;
     emit afterClear();
 }
 
-const CanMessage *CanTrace::getMessage(int idx)
+bool CanTrace::getMessage(int idx, CanMessage &msg)
 {
     QMutexLocker locker(&_mutex);
-    if (idx >= (_dataRowsUsed + _newRows)) {
-        return 0;
-    } else {
-        return &_data[idx];
-    }
+    return _data.get(idx, msg);
 }
 
-void CanTrace::enqueueMessage(const CanMessage &msg, bool more_to_follow)
+size_t CanTrace::residentBytes()
 {
     QMutexLocker locker(&_mutex);
+    return _data.residentBytes();
+}
+
+bool CanTrace::appendMessage(const CanMessage &msg)
+{
+    foreach (CanTraceSink *sink, _sinks) {
+        sink->publish(msg);
+    }
+
+    if (!_retainFrames) {
+        return false;
+    }
 
     if (_disp_ch != CanTrace::All) {
         if (_disp_ch != (msg.getInterfaceId() + 1)) {
-            return;
+            return false;
         }
     }
 
-    int idx = size() + _newRows;
-    if (idx>=_data.size()) {
-        _data.resize(_data.size() + pool_chunk_size);
-    }
-
-    _data[idx].cloneFrom(msg);
+    _data.append(msg);
     _newRows++;
+    return true;
+}
+
+void CanTrace::enqueueMessage(const CanMessage &msg, bool more_to_follow)
+{
+    QMutexLocker locker(&_mutex);
+
+    int idx = _data.size();
+    bool shown = appendMessage(msg);
+    if (!more_to_follow) {
+        foreach (CanTraceSink *sink, _sinks) {
+            sink->notify();
+        }
+    }
+    if (!shown) {
+        return;
+    }
 
     if (!more_to_follow) {
         startTimer();
@@ -97,21 +119,94 @@ void CanTrace::enqueueMessage(const CanMessage &msg, bool more_to_follow)
     emit messageEnqueued(idx);
 }
 
-void CanTrace::flushQueue()
+void CanTrace::addIngestRing(CanMessageRing *ring)
+{
+    QMutexLocker locker(&_mutex);
+    _rings.append(ring);
+}
+
+void CanTrace::removeIngestRing(CanMessageRing *ring)
+{
+    QMutexLocker locker(&_mutex);
+    drainIngestRings();
+    _rings.removeOne(ring);
+    startTimer();
+}
+
+void CanTrace::notifyIngest()
+{
+    startTimer();
+}
+
+void CanTrace::addSink(CanTraceSink *sink)
+{
+    QMutexLocker locker(&_mutex);
+    _sinks.append(sink);
+}
+
+void CanTrace::removeSink(CanTraceSink *sink)
+{
+    QMutexLocker locker(&_mutex);
+    drainIngestRings();
+    _sinks.removeOne(sink);
+}
+
+void CanTrace::setRetainFrames(bool retain)
+{
+    QMutexLocker locker(&_mutex);
+    _retainFrames = retain;
+}
+
+void CanTrace::drainIngestRings()
 {
-    {
-        QMutexLocker locker(&_timerMutex);
-        _isTimerRunning = false;
+    // Only take what is in the rings right now, so a busy producer cannot keep us here forever.
+    QVarLengthArray<uint32_t, 16> pending(_rings.size());
+    for (int i=0; i<_rings.size(); i++) {
+        pending[i] = _rings[i]->available();
     }
 
+    // Merge the ring heads by timestamp so frames from different interfaces interleave in bus order.
+    forever {
+        int best = -1;
+        uint64_t best_ts = 0;
+        for (int i=0; i<_rings.size(); i++) {
+            if (pending[i]) {
+                uint64_t ts = _rings[i]->front().getTimestampNs();
+                if ((best<0) || (ts < best_ts)) {
+                    best = i;
+                    best_ts = ts;
+                }
+            }
+        }
+
+        if (best<0) {
+            break;
+        }
+
+        appendMessage(_rings[best]->front());
+        _rings[best]->pop();
+        pending[best]--;
+    }
+
+    foreach (CanTraceSink *sink, _sinks) {
+        sink->notify();
+    }
+}
+
+void CanTrace::flushQueue()
+{
+    _isTimerRunning.storeRelease(0);
+
     QMutexLocker locker(&_mutex);
+    drainIngestRings();
     if (_newRows) {
         emit beforeAppend(_newRows);
 
         // see if we have muxed messages. cache muxed values, if any.
         MeasurementSetup &setup = _backend.getSetup();
+        CanMessage msg;
         for (int i=_dataRowsUsed; i<_dataRowsUsed + _newRows; i++) {
-            CanMessage &msg = _data[i];
+            _data.get(i, msg);
             CanDbMessage *dbmsg = setup.findDbMessage(msg);
             if (dbmsg && dbmsg->getMuxer()) {
                 foreach (CanDbSignal *signal, dbmsg->getSignals()) {
@@ -131,9 +226,7 @@ void CanTrace::flushQueue()
 
 void CanTrace::startTimer()
 {
-    QMutexLocker locker(&_timerMutex);
-    if (!_isTimerRunning) {
-        _isTimerRunning = true;
+    if (_isTimerRunning.testAndSetOrdered(0, 1)) {
         QMetaObject::invokeMethod(&_flushTimer, "start", Qt::QueuedConnection);
     }
 }
@@ -142,18 +235,28 @@ void CanTrace::saveCanDump(QFile &file)
 {
     QMutexLocker locker(&_mutex);
     QTextStream stream(&file);
-    for (unsigned int i=0; i<size(); i++) {
-        CanMessage *msg = &_data[i];
+    for (int i=0; i<_dataRowsUsed; i++) {
+        if (_data.flags(i) & CanTraceStore::flag_gap) {
+            continue;
+        }
+        uint64_t ts = _data.timestampNsecs(i);
         QString line;
-        line.append(QString().asprintf("(%.6f) ", msg->getFloatTimestamp()));
-        line.append(_backend.getInterfaceName(msg->getInterfaceId()));
-        if (msg->isExtended()) {
-            line.append(QString().asprintf(" %08X#", msg->getId()));
+        line.append(QString().asprintf("(%llu.%06u) ", (unsigned long long)(ts / 1000000000), (unsigned)((ts % 1000000000) / 1000)));
+        line.append(_backend.getInterfaceName(_data.interfaceId(i)));
+        uint16_t flags = _data.flags(i);
+        if (flags & CanTraceStore::flag_extended) {
+            line.append(QString().asprintf(" %08X#", _data.rawId(i)));
         } else {
-            line.append(QString().asprintf(" %03X#", msg->getId()));
+            line.append(QString().asprintf(" %03X#", _data.rawId(i)));
+        }
+        if (flags & CanTraceStore::flag_fd) {
+            // CAN FD frames are written as ID##<flags><data>, flags being CANFD_BRS (1) | CANFD_ESI (2)
+            unsigned fd_flags = ((flags & CanTraceStore::flag_brs) ? 1 : 0) | ((flags & CanTraceStore::flag_esi) ? 2 : 0);
+            line.append(QString().asprintf("#%X", fd_flags));
         }
-        for (int i=0; i<msg->getLength(); i++) {
-            line.append(QString().asprintf("%02X", msg->getByte(i)));
+        const uint8_t *payload = _data.payload(i);
+        for (int j=0; j<_data.length(i); j++) {
+            line.append(QString().asprintf("%02X", payload[j]));
         }
         stream << line << endl;
     }
@@ -164,43 +267,67 @@ void CanTrace::saveVectorAsc(QFile &file)
     QMutexLocker locker(&_mutex);
     QTextStream stream(&file);
 
-    if (_data.length()<1) {
+    if (_dataRowsUsed<1) {
         return;
     }
 
-
-    auto firstMessage = _data.first();
-    double t_start = firstMessage.getFloatTimestamp();
+    uint64_t t_start = _data.timestampNsecs(0);
 
     QLocale locale_c(QLocale::C);
-    QString dt_start = locale_c.toString(firstMessage.getDateTime(), "ddd MMM dd hh:mm:ss.zzz ap yyyy");
+    QString dt_start = locale_c.toString(QDateTime::fromMSecsSinceEpoch(t_start / 1000000), "ddd MMM dd hh:mm:ss.zzz ap yyyy");
 
     stream << "date " << dt_start << endl;
     stream << "base hex  timestamps absolute" << endl;
     stream << "internal events logged" << endl;
     stream << "// version 8.5.0" << endl;
+
+    // record which clock the timestamps came from, per interface
+    QMap<CanInterfaceId, uint8_t> ts_sources;
+    for (int i=0; i<_dataRowsUsed; i++) {
+        ts_sources[_data.interfaceId(i)] |= 1 << _data.timestampSource(i);
+    }
+    foreach (CanInterfaceId ifid, ts_sources.keys()) {
+        QStringList sources;
+        for (int src=CanMessage::timestamp_source_host; src<=CanMessage::timestamp_source_device; src++) {
+            if (ts_sources[ifid] & (1<<src)) {
+                sources.append(CanMessage::getTimestampSourceStr((CanMessage::TimestampSource)src));
+            }
+        }
+        stream << "// timestamp source " << _backend.getInterfaceName(ifid) << ": " << sources.join(", ") << endl;
+    }
+
     stream << "Begin Triggerblock " << dt_start << endl;
     stream << "   0.000000 Start of measurement" << endl;
 
-    for (unsigned int i=0; i<size(); i++) {
-        CanMessage &msg = _data[i];
-
-        double t_current = msg.getFloatTimestamp();
-        QString id_hex_str = QString().asprintf("%x", msg.getId());
-        QString id_dec_str = QString().asprintf("%d", msg.getId());
-        if (msg.isExtended()) {
+    for (int i=0; i<_dataRowsUsed; i++) {
+        if (_data.flags(i) & CanTraceStore::flag_gap) {
+            continue;
+        }
+        uint64_t t_current = _data.timestampNsecs(i);
+        uint64_t t_rel = (t_current > t_start) ? (t_current - t_start) : 0;
+        uint32_t raw_id = _data.rawId(i);
+        QString id_hex_str = QString().asprintf("%x", raw_id);
+        QString id_dec_str = QString().asprintf("%d", raw_id);
+        if (_data.flags(i) & CanTraceStore::flag_extended) {
             id_hex_str.append("x");
             id_dec_str.append("x");
         }
 
+        QString data_hex_str;
+        const uint8_t *payload = _data.payload(i);
+        for (int j=0; j<_data.length(i); j++) {
+            data_hex_str.append(QString().asprintf("%02X ", payload[j]));
+        }
+
         // TODO how to handle RTR flag?
         QString line = QString().asprintf(
-            "%11.6lf 1  %-15s %s   d %d %s  Length = %d BitCount = %d ID = %s",
-            t_current-t_start,
+            "%4llu.%06u 1  %-15s %s   d %d %s  Length = %d BitCount = %d ID = %s",
+            (unsigned long long)(t_rel / 1000000000),
+            (unsigned)((t_rel % 1000000000) / 1000),
             id_hex_str.toStdString().c_str(),
             "Rx", // TODO handle Rx/Tx
-            msg.getLength(),
-            msg.getDataHexString().toStdString().c_str(),
+            _data.length(i),
+            data_hex_str.toStdString().c_str(),
             0, // TODO Length (transfer time in ns)
             0, // TODO BitCount (overall frame length, including stuff bits)
             id_dec_str.toStdString().c_str()
@@ -27,8 +27,12 @@
 #include <QVector>
 #include <QMap>
 #include <QFile>
+#include <QAtomicInt>
 
 #include "CanMessage.h"
+#include "CanTraceStore.h"
+#include "SpscRing.h"
+#include "CanTraceSink.h"
 
 class CanInterface;
 class CanDbMessage;
@@ -36,6 +40,8 @@ class CanDbSignal;
 class MeasurementSetup;
 class Backend;
 
+typedef SpscRing<CanMessage> CanMessageRing;
+
 class CanTrace : public QObject
 {
     Q_OBJECT
@@ -55,9 +61,27 @@ public:
 
     unsigned long size();
     void clear();
-    const CanMessage *getMessage(int idx);
+    bool getMessage(int idx, CanMessage &msg);
+
+    // memory held by the frames kept for display
+    size_t residentBytes();
+
     void enqueueMessage(const CanMessage &msg, bool more_to_follow=false);
 
+    // Listener threads publish into their own ring and call notifyIngest();
+    // the rings are drained into the trace on the GUI thread by flushQueue().
+    void addIngestRing(CanMessageRing *ring);
+    void removeIngestRing(CanMessageRing *ring);
+    void notifyIngest();
+
+    // hand every frame entering the trace to the sink as well
+    void addSink(CanTraceSink *sink);
+    void removeSink(CanTraceSink *sink);
+
+    // Keep frames for display (default). Without, frames only go to the
+    // sinks and the trace stays empty, for capturing without a GUI.
+    void setRetainFrames(bool retain);
+
     void saveCanDump(QFile &file);
     void saveVectorAsc(QFile &file);
 
@@ -77,26 +101,27 @@ private slots:
     void flushQueue();
 
 private:
-    enum {
-        pool_chunk_size = 1024
-    };
-
     Backend &_backend;
 
-    QVector<CanMessage> _data;
+    CanTraceStore _data;
     int _dataRowsUsed;
     int _newRows;
-    bool _isTimerRunning;
+    QAtomicInt _isTimerRunning;
+
+    QList<CanMessageRing*> _rings;
+    QList<CanTraceSink*> _sinks;
+    bool _retainFrames;
 
     QMap<const CanDbSignal*,uint64_t> _muxCache;
 
     QMutex _mutex;
-    QMutex _timerMutex;
     QTimer _flushTimer;
 
     Display_channel _disp_ch;
 
     void startTimer();
+    bool appendMessage(const CanMessage &msg);
+    void drainIngestRings();
 
 
 };
@@ -0,0 +1,41 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+class CanMessage;
+
+/*
+ * Receives every frame that enters the trace, regardless of the channel
+ * on display: network streaming, shared memory, capture files.
+ *
+ * publish() is called with the trace mutex held, from whichever thread
+ * feeds the trace, and must not block. notify() follows once a batch is
+ * complete, so sinks that batch can hand it on.
+ */
+class CanTraceSink
+{
+public:
+    virtual ~CanTraceSink() {}
+
+    virtual void publish(const CanMessage &msg) = 0;
+    virtual void notify() {}
+};
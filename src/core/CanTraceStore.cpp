@@ -0,0 +1,214 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanTraceStore.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <QtGlobal>
+
+enum {
+    // initial arena size is sized for classic CAN frames; FD traffic grows it
+    payload_initial_bytes_per_frame = 8,
+    payload_max_bytes_per_frame = 64
+};
+
+CanTraceStore::CanTraceStore()
+  : _size(0)
+{
+}
+
+CanTraceStore::~CanTraceStore()
+{
+    clear();
+}
+
+int CanTraceStore::size() const
+{
+    return _size;
+}
+
+void CanTraceStore::clear()
+{
+    foreach (Segment *seg, _segments) {
+        freeSegment(seg);
+    }
+    _segments.clear();
+    _size = 0;
+}
+
+CanTraceStore::Segment *CanTraceStore::allocSegment()
+{
+    Segment *seg = new Segment;
+    seg->payload_capacity = segment_size * payload_initial_bytes_per_frame;
+    seg->payload = (uint8_t*)malloc(seg->payload_capacity);
+    if (!seg->payload) {
+        delete seg;
+        qBadAlloc();
+    }
+    seg->payload_used = 0;
+    return seg;
+}
+
+void CanTraceStore::freeSegment(Segment *seg)
+{
+    free(seg->payload);
+    delete seg;
+}
+
+uint8_t *CanTraceStore::reservePayload(Segment *seg, uint8_t len, uint32_t *offset)
+{
+    if (seg->payload_used + len > seg->payload_capacity) {
+        // growth is bounded by the segment, so this never copies more than one segment's payload
+        uint32_t capacity = seg->payload_capacity * 2;
+        if (capacity > segment_size * payload_max_bytes_per_frame) {
+            capacity = segment_size * payload_max_bytes_per_frame;
+        }
+        // out of memory is reported like a failed new; the segment keeps its old arena
+        uint8_t *payload = (uint8_t*)realloc(seg->payload, capacity);
+        if (!payload) {
+            qBadAlloc();
+        }
+        seg->payload = payload;
+        seg->payload_capacity = capacity;
+    }
+
+    *offset = seg->payload_used;
+    seg->payload_used += len;
+    return &seg->payload[*offset];
+}
+
+int CanTraceStore::append(const CanMessage &msg)
+{
+    int seg_idx = _size / segment_size;
+    if (seg_idx >= _segments.size()) {
+        _segments.append(allocSegment());
+    }
+
+    Segment *seg = _segments[seg_idx];
+    int row = _size % segment_size;
+
+    seg->timestamp[row] = msg.getTimestampNs();
+    seg->raw_id[row] = msg.getRawId();
+    seg->interface[row] = msg.getInterfaceId();
+
+    uint16_t flags = 0;
+    if (msg.isExtended()) { flags |= flag_extended; }
+    if (msg.isRTR()) { flags |= flag_rtr; }
+    if (msg.isFD()) { flags |= flag_fd; }
+    if (msg.isBRS()) { flags |= flag_brs; }
+    if (msg.isESI()) { flags |= flag_esi; }
+    if (msg.direction() == CanMessage::Tx) { flags |= flag_tx; }
+    if (msg.isGapMarker()) { flags |= flag_gap; }
+    flags |= (msg.getTimestampSource() << flag_ts_source_shift) & flag_ts_source_mask;
+    seg->flags[row] = flags;
+
+    uint8_t len = msg.getLength();
+    seg->length[row] = len;
+    uint8_t *data = reservePayload(seg, len, &seg->payload_offset[row]);
+    for (int i=0; i<len; i++) {
+        data[i] = msg.getByte(i);
+    }
+
+    return _size++;
+}
+
+bool CanTraceStore::get(int idx, CanMessage &msg) const
+{
+    if ((idx < 0) || (idx >= _size)) {
+        return false;
+    }
+
+    const Segment *seg = segmentOf(idx);
+    int row = idx % segment_size;
+
+    msg.setTimestampNs(seg->timestamp[row]);
+    msg.setRawId(seg->raw_id[row]);
+    msg.setInterfaceId(seg->interface[row]);
+
+    uint16_t flags = seg->flags[row];
+    msg.setExtended(flags & flag_extended);
+    msg.setRTR(flags & flag_rtr);
+    msg.setFD(flags & flag_fd);
+    msg.setBRS(flags & flag_brs);
+    msg.setESI(flags & flag_esi);
+    msg.setDirection((flags & flag_tx) ? CanMessage::Tx : CanMessage::Rx);
+    msg.setGapMarker(flags & flag_gap);
+    msg.setTimestampSource((CanMessage::TimestampSource)((flags & flag_ts_source_mask) >> flag_ts_source_shift));
+
+    uint8_t len = seg->length[row];
+    const uint8_t *data = &seg->payload[seg->payload_offset[row]];
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, data[i]);
+    }
+    // signal extraction reads the first 8 bytes regardless of length
+    for (int i=len; i<8; i++) {
+        msg.setByte(i, 0);
+    }
+
+    return true;
+}
+
+uint64_t CanTraceStore::timestampNsecs(int idx) const
+{
+    return segmentOf(idx)->timestamp[idx % segment_size];
+}
+
+uint32_t CanTraceStore::rawId(int idx) const
+{
+    return segmentOf(idx)->raw_id[idx % segment_size];
+}
+
+CanInterfaceId CanTraceStore::interfaceId(int idx) const
+{
+    return segmentOf(idx)->interface[idx % segment_size];
+}
+
+uint16_t CanTraceStore::flags(int idx) const
+{
+    return segmentOf(idx)->flags[idx % segment_size];
+}
+
+CanMessage::TimestampSource CanTraceStore::timestampSource(int idx) const
+{
+    return (CanMessage::TimestampSource)((flags(idx) & flag_ts_source_mask) >> flag_ts_source_shift);
+}
+
+uint8_t CanTraceStore::length(int idx) const
+{
+    return segmentOf(idx)->length[idx % segment_size];
+}
+
+const uint8_t *CanTraceStore::payload(int idx) const
+{
+    const Segment *seg = segmentOf(idx);
+    return &seg->payload[seg->payload_offset[idx % segment_size]];
+}
+
+size_t CanTraceStore::residentBytes() const
+{
+    size_t retval = _segments.size() * sizeof(Segment*);
+    foreach (const Segment *seg, _segments) {
+        retval += sizeof(Segment) + seg->payload_capacity;
+    }
+    return retval;
+}
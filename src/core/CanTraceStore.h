@@ -0,0 +1,104 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <QVector>
+#include "CanMessage.h"
+
+/*
+ * Segmented, columnar message store backing CanTrace.
+ *
+ * Each segment keeps one array per field (timestamp, raw id, interface,
+ * flags, length) plus a packed payload arena that only holds getLength()
+ * bytes per frame. Segments are never moved once allocated, so appending
+ * does not depend on the capture size and clear() frees them in bulk.
+ * Scans over ids or timestamps only touch the columns they need; get()
+ * materializes a full CanMessage when a caller needs one.
+ */
+class CanTraceStore
+{
+public:
+    enum {
+        segment_size = 4096
+    };
+
+    enum {
+        flag_extended = 0x01,
+        flag_rtr      = 0x02,
+        flag_fd       = 0x04,
+        flag_brs      = 0x08,
+        flag_tx       = 0x10,
+
+        // CanMessage::TimestampSource
+        flag_ts_source_shift = 5,
+        flag_ts_source_mask  = 0x60,
+
+        flag_gap      = 0x80,
+        flag_esi      = 0x100
+    };
+
+    CanTraceStore();
+    ~CanTraceStore();
+
+    int size() const;
+    void clear();
+
+    int append(const CanMessage &msg);
+    bool get(int idx, CanMessage &msg) const;
+
+    uint64_t timestampNsecs(int idx) const;
+    uint32_t rawId(int idx) const;
+    CanInterfaceId interfaceId(int idx) const;
+    uint16_t flags(int idx) const;
+    CanMessage::TimestampSource timestampSource(int idx) const;
+    uint8_t length(int idx) const;
+    const uint8_t *payload(int idx) const;
+
+    size_t residentBytes() const;
+
+private:
+    Q_DISABLE_COPY(CanTraceStore)
+
+    struct Segment {
+        uint64_t timestamp[segment_size]; // nanoseconds
+        uint32_t raw_id[segment_size];
+        uint32_t payload_offset[segment_size];
+        CanInterfaceId interface[segment_size];
+        uint16_t flags[segment_size];
+        uint8_t length[segment_size];
+
+        uint8_t *payload;
+        uint32_t payload_used;
+        uint32_t payload_capacity;
+    };
+
+    QVector<Segment*> _segments;
+    int _size;
+
+    Segment *allocSegment();
+    void freeSegment(Segment *seg);
+    uint8_t *reservePayload(Segment *seg, uint8_t len, uint32_t *offset);
+
+    inline const Segment *segmentOf(int idx) const { return _segments[idx / segment_size]; }
+};
@@ -0,0 +1,110 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ClockAligner.h"
+
+#include <math.h>
+
+ClockAligner::ClockAligner()
+{
+    reset();
+}
+
+void ClockAligner::reset()
+{
+    _running = false;
+    _offset_ns = 0;
+    _anchor_ns = 0;
+    _drift = 0;
+    _window_start_ns = 0;
+    _window_min_ns = 0;
+    _window_min_at_ns = 0;
+    _history_count = 0;
+}
+
+bool ClockAligner::isRunning() const
+{
+    return _running;
+}
+
+double ClockAligner::getDriftPpm() const
+{
+    return _drift * 1e6;
+}
+
+int64_t ClockAligner::offsetAt(uint64_t device_ns) const
+{
+    return _offset_ns + (int64_t)llround(_drift * (double)(int64_t)(device_ns - _anchor_ns));
+}
+
+void ClockAligner::closeWindow()
+{
+    // compare with the oldest minimum still in the history
+    int oldest = (_history_count < history_len) ? 0 : (_history_count % history_len);
+    if ((_history_count > 0) && (_window_min_at_ns > _history_at_ns[oldest])) {
+        double slope = (double)(_window_min_ns - _history_min_ns[oldest]) / (double)(_window_min_at_ns - _history_at_ns[oldest]);
+        _drift += (slope - _drift) / 4;
+        if (fabs(_drift) > (max_drift_ppm / 1e6)) {
+            _drift = (_drift > 0) ? (max_drift_ppm / 1e6) : -(max_drift_ppm / 1e6);
+        }
+    }
+
+    // the window minimum is the best offset sample seen lately; let the estimate rise to it
+    _offset_ns = _window_min_ns;
+    _anchor_ns = _window_min_at_ns;
+
+    _history_min_ns[_history_count % history_len] = _window_min_ns;
+    _history_at_ns[_history_count % history_len] = _window_min_at_ns;
+    _history_count++;
+}
+
+uint64_t ClockAligner::toHostNs(uint64_t device_ns, uint64_t ref_ns)
+{
+    int64_t sample = (int64_t)(ref_ns - device_ns);
+
+    if (!_running) {
+        _running = true;
+        _offset_ns = sample;
+        _anchor_ns = device_ns;
+        _window_start_ns = device_ns;
+        _window_min_ns = sample;
+        _window_min_at_ns = device_ns;
+    }
+
+    if ((device_ns - _window_start_ns) >= ((uint64_t)window_ms * 1000000)) {
+        closeWindow();
+        _window_start_ns = device_ns;
+        _window_min_ns = sample;
+        _window_min_at_ns = device_ns;
+    } else if (sample < _window_min_ns) {
+        _window_min_ns = sample;
+        _window_min_at_ns = device_ns;
+    }
+
+    // a frame cannot have been on the bus after it reached the host
+    int64_t offset = offsetAt(device_ns);
+    if (sample < offset) {
+        _offset_ns -= offset - sample;
+        offset = sample;
+    }
+
+    return device_ns + offset;
+}
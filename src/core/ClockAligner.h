@@ -0,0 +1,75 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Aligns a device clock (an adapter's tick counter, a controller's PTP
+ * hardware clock) with the host clock, given pairs of device time and a
+ * host reference time taken when the frame reached the host.
+ *
+ * Reference minus device time is the clock offset plus a latency that is
+ * never negative, so the lowest samples trace the offset. Samples below
+ * the current estimate move it down at once, so no frame is stamped after
+ * its own reference. Once per window the window minimum re-anchors the
+ * estimate, which lets it rise again. The slope across the last
+ * history_len window minima gives the drift of the device clock; the long
+ * baseline keeps the device resolution out of it.
+ */
+class ClockAligner
+{
+public:
+    ClockAligner();
+
+    void reset();
+
+    // host time of device_ns, for a frame whose host reference time is ref_ns
+    uint64_t toHostNs(uint64_t device_ns, uint64_t ref_ns);
+
+    bool isRunning() const;
+    double getDriftPpm() const;
+
+private:
+    enum {
+        window_ms = 1000,
+        history_len = 16,
+        max_drift_ppm = 1000
+    };
+
+    bool _running;
+
+    int64_t _offset_ns;   // estimated host minus device time at _anchor_ns
+    uint64_t _anchor_ns;
+    double _drift;        // host ns per device ns, minus one
+
+    uint64_t _window_start_ns;
+    int64_t _window_min_ns;
+    uint64_t _window_min_at_ns;
+    // minima of the last windows, a ring of history_len entries
+    int64_t _history_min_ns[history_len];
+    uint64_t _history_at_ns[history_len];
+    int _history_count;
+
+    int64_t offsetAt(uint64_t device_ns) const;
+    void closeWindow();
+};
@@ -0,0 +1,48 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Host time for stamping frames.
+ *
+ * Reads the monotonic clock and shifts it onto the Unix epoch by one
+ * offset, taken at the first call. Stamps are absolute, like the kernel's
+ * socket timestamps and the times exports write, but setting the system
+ * clock during a capture does not make them jump or run backwards.
+ *
+ * Kernel timestamps (SO_TIMESTAMPNS, SIOCGSTAMP) are taken on
+ * CLOCK_REALTIME; subtract realtimeOffsetNs() to bring them onto host time.
+ */
+class HostClock
+{
+public:
+    static uint64_t nowNs();
+
+    // how far CLOCK_REALTIME has been set away from host time; 0 until the system clock is stepped
+    static int64_t realtimeOffsetNs();
+
+private:
+    static uint64_t monotonicNs();
+    static uint64_t realtimeNs();
+};
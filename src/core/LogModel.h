@@ -51,6 +51,8 @@ public:
 
     void clear();
 
+    static QString logLevelText(log_level_t level);
+
     virtual QModelIndex index(int row, int column, const QModelIndex &parent) const;
     virtual QModelIndex parent(const QModelIndex &child) const;
 
@@ -66,6 +68,4 @@ public slots:
 
 private:
     QList<LogItem*> _items;
-
-    static QString logLevelText(log_level_t level);
 };
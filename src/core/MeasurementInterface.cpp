@@ -38,7 +38,9 @@ MeasurementInterface::MeasurementInterface()
     _isOneShotMode(false),
     _isTripleSampling(false),
     _doAutoRestart(false),
-    _autoRestartMs(100)
+    _autoRestartMs(100),
+    _rxTimestampMode(CanInterface::rx_timestamp_auto),
+    _rxBufferSize(0)
 {
 
 }
@@ -61,6 +63,12 @@ bool MeasurementInterface::loadXML(Backend &backend, QDomElement &el)
     _doAutoRestart = el.attribute("auto-restart", "0").toInt() != 0;
     _autoRestartMs = el.attribute("auto-restart-time", "100").toInt();
 
+    _rxTimestampMode = el.attribute("rx-timestamp-mode", "0").toInt();
+    _rxBufferSize = el.attribute("rx-buffer-size", "0").toUInt();
+    if (!_captureFilter.fromString(el.attribute("capture-filter", ""))) {
+        log_warning(QString("ignoring invalid parts of capture filter: %1").arg(el.attribute("capture-filter")));
+    }
+
     return true;
 }
 
@@ -86,6 +94,12 @@ bool MeasurementInterface::saveXML(Backend &backend, QDomDocument &xml, QDomElem
     root.setAttribute("auto-restart", _doAutoRestart ? 1 : 0);
     root.setAttribute("auto-restart-time", _autoRestartMs);
 
+    root.setAttribute("rx-timestamp-mode", _rxTimestampMode);
+    root.setAttribute("rx-buffer-size", _rxBufferSize);
+    if (!_captureFilter.isEmpty()) {
+        root.setAttribute("capture-filter", _captureFilter.toString());
+    }
+
     return true;
 }
 
@@ -214,3 +228,32 @@ void MeasurementInterface::setAutoRestartMs(int autoRestartMs)
     _autoRestartMs = autoRestartMs;
 }
 
+int MeasurementInterface::rxTimestampMode() const
+{
+    return _rxTimestampMode;
+}
+
+void MeasurementInterface::setRxTimestampMode(int rxTimestampMode)
+{
+    _rxTimestampMode = rxTimestampMode;
+}
+
+unsigned MeasurementInterface::rxBufferSize() const
+{
+    return _rxBufferSize;
+}
+
+void MeasurementInterface::setRxBufferSize(unsigned rxBufferSize)
+{
+    _rxBufferSize = rxBufferSize;
+}
+
+const CanCaptureFilter &MeasurementInterface::captureFilter() const
+{
+    return _captureFilter;
+}
+
+void MeasurementInterface::setCaptureFilter(const CanCaptureFilter &captureFilter)
+{
+    _captureFilter = captureFilter;
+}
@@ -24,6 +24,7 @@
 #include <QDomDocument>
 #include <driver/CanDriver.h>
 #include <driver/CanInterface.h>
+#include <core/CanCaptureFilter.h>
 
 class Backend;
 
@@ -72,6 +73,15 @@ public:
     int autoRestartMs() const;
     void setAutoRestartMs(int autoRestartMs);
 
+    int rxTimestampMode() const;
+    void setRxTimestampMode(int rxTimestampMode);
+
+    unsigned rxBufferSize() const;
+    void setRxBufferSize(unsigned rxBufferSize);
+
+    const CanCaptureFilter &captureFilter() const;
+    void setCaptureFilter(const CanCaptureFilter &captureFilter);
+
 private:
     CanInterfaceId _canif;
 
@@ -89,4 +99,8 @@ private:
     bool _isTripleSampling;
     bool _doAutoRestart;
     int _autoRestartMs;
+
+    int _rxTimestampMode;
+    unsigned _rxBufferSize;
+    CanCaptureFilter _captureFilter;
 };
@@ -101,6 +101,9 @@ void MeasurementSetup::removeNetwork(MeasurementNetwork *network)
 CanDbMessage *MeasurementSetup::findDbMessage(const CanMessage &msg) const
 {
     CanDbMessage *result = 0;
+    if (msg.isGapMarker()) {
+        return result;
+    }
 
     foreach (MeasurementNetwork *network, _networks) {
         foreach (pCanDb db, network->_canDbs) {
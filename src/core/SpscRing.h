@@ -0,0 +1,125 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QAtomicInteger>
+
+/*
+ * Bounded single-producer/single-consumer ring.
+ *
+ * Exactly one thread may call push(), and exactly one (other) thread may
+ * call front()/pop(). The capacity is rounded up to a power of two. When
+ * the ring is full, push() fails and the item is counted as dropped.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(uint32_t capacity)
+      : _head(0),
+        _tail(0),
+        _highWater(0),
+        _drops(0)
+    {
+        uint32_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _buf = new T[size];
+        _mask = size - 1;
+    }
+
+    ~SpscRing()
+    {
+        delete[] _buf;
+    }
+
+    uint32_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+    // producer side
+
+    bool push(const T &item)
+    {
+        uint32_t head = _head.loadAcquire();
+        uint32_t fill = head - _tail.loadAcquire();
+        if (fill > _mask) {
+            _drops.storeRelease(_drops.loadAcquire() + 1);
+            return false;
+        }
+
+        _buf[head & _mask] = item;
+        _head.storeRelease(head + 1);
+
+        if (fill + 1 > _highWater.loadAcquire()) {
+            _highWater.storeRelease(fill + 1);
+        }
+        return true;
+    }
+
+    // consumer side
+
+    uint32_t available() const
+    {
+        return _head.loadAcquire() - _tail.loadAcquire();
+    }
+
+    const T &front() const
+    {
+        return _buf[_tail.loadAcquire() & _mask];
+    }
+
+    void pop()
+    {
+        _tail.storeRelease(_tail.loadAcquire() + 1);
+    }
+
+    // statistics, safe to read from any thread
+
+    uint32_t highWaterMark() const
+    {
+        return _highWater.loadAcquire();
+    }
+
+    uint32_t drops() const
+    {
+        return _drops.loadAcquire();
+    }
+
+private:
+    Q_DISABLE_COPY(SpscRing)
+
+    T *_buf;
+    uint32_t _mask;
+
+    // keep producer and consumer indices on separate cache lines
+    QAtomicInteger<uint32_t> _head;
+    char _pad0[64 - sizeof(QAtomicInteger<uint32_t>)];
+    QAtomicInteger<uint32_t> _tail;
+    char _pad1[64 - sizeof(QAtomicInteger<uint32_t>)];
+
+    QAtomicInteger<uint32_t> _highWater;
+    QAtomicInteger<uint32_t> _drops;
+};
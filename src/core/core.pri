@@ -1,7 +1,14 @@
 SOURCES += \
     $$PWD/Backend.cpp \
     $$PWD/CanMessage.cpp \
+    $$PWD/CanCaptureFilter.cpp \
     $$PWD/CanTrace.cpp \
+    $$PWD/CanTraceStore.cpp \
+    $$PWD/CanDumpWriter.cpp \
+    $$PWD/CanDumpReader.cpp \
+    $$PWD/CanReplay.cpp \
+    $$PWD/HostClock.cpp \
+    $$PWD/ClockAligner.cpp \
     $$PWD/CanDbMessage.cpp \
     $$PWD/CanDb.cpp \
     $$PWD/CanDbNode.cpp \
@@ -17,7 +24,16 @@ HEADERS += \
     $$PWD/portable_endian.h \
     $$PWD/Backend.h \
     $$PWD/CanMessage.h \
+    $$PWD/CanCaptureFilter.h \
     $$PWD/CanTrace.h \
+    $$PWD/CanTraceSink.h \
+    $$PWD/CanTraceStore.h \
+    $$PWD/CanDumpWriter.h \
+    $$PWD/CanDumpReader.h \
+    $$PWD/CanReplay.h \
+    $$PWD/HostClock.h \
+    $$PWD/ClockAligner.h \
+    $$PWD/SpscRing.h \
     $$PWD/CanDbMessage.h \
     $$PWD/CanDb.h \
     $$PWD/CanDbNode.h \
@@ -0,0 +1,278 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CaptureDaemon.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QDir>
+#include <QFile>
+
+#include <core/Backend.h>
+#include <core/LogModel.h>
+#include <core/CanTrace.h>
+#include <core/CanMessage.h>
+#include <core/CanDumpWriter.h>
+#include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
+#include <core/MeasurementInterface.h>
+#include <driver/CanInterface.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+int CaptureDaemon::_signalFds[2] = { -1, -1 };
+
+CaptureDaemon::CaptureDaemon(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _writer(0),
+    _verbose(false),
+    _stopped(false),
+    _signalNotifier(0),
+    _frames(0),
+    _lostFrames(0),
+    _statsFrames(0)
+{
+    connect(&backend, SIGNAL(onLogMessage(QDateTime,log_level_t,QString)), this, SLOT(onLogMessage(QDateTime,log_level_t,QString)));
+    connect(&_statsTimer, SIGNAL(timeout()), this, SLOT(printStats()));
+    _statsTimer.setInterval(10000);
+}
+
+CaptureDaemon::~CaptureDaemon()
+{
+    stop();
+    delete _writer;
+}
+
+void CaptureDaemon::setOutputDir(const QString &dir)
+{
+    _outputDir = dir;
+}
+
+void CaptureDaemon::setStatsInterval(int seconds)
+{
+    _statsTimer.setInterval(seconds * 1000);
+}
+
+void CaptureDaemon::setVerbose(bool verbose)
+{
+    _verbose = verbose;
+}
+
+bool CaptureDaemon::start()
+{
+    if (!installSignalHandlers()) {
+        return false;
+    }
+
+    CanTrace *trace = _backend.getTrace();
+    trace->setRetainFrames(false);
+    trace->addSink(this);
+
+    if (!_outputDir.isEmpty()) {
+        if (!QDir().mkpath(_outputDir)) {
+            log_error(QString("Cannot create output directory %1").arg(_outputDir));
+            return false;
+        }
+        _writer = new CanDumpWriter(_backend);
+        if (!_writer->open(nextFileName())) {
+            return false;
+        }
+        trace->addSink(_writer);
+    }
+
+    if (!_backend.startMeasurement()) {
+        return false;
+    }
+
+    _statsElapsed.start();
+    if (_statsTimer.interval() > 0) {
+        _statsTimer.start();
+    }
+    return true;
+}
+
+void CaptureDaemon::stop()
+{
+    if (_stopped) {
+        return;
+    }
+    _stopped = true;
+
+    _statsTimer.stop();
+    _backend.stopMeasurement();
+
+    CanTrace *trace = _backend.getTrace();
+    trace->removeSink(this);
+    if (_writer) {
+        trace->removeSink(_writer);
+        _writer->close();
+    }
+
+    printStats();
+}
+
+void CaptureDaemon::quit()
+{
+    log_info("Stopping capture");
+    stop();
+    QCoreApplication::quit();
+}
+
+void CaptureDaemon::publish(const CanMessage &msg)
+{
+    if (msg.isGapMarker()) {
+        _lostFrames += msg.getId();
+    } else {
+        _frames++;
+    }
+}
+
+QString CaptureDaemon::nextFileName() const
+{
+    // several rotations within a second get a suffix instead of sharing a file
+    QString base = QDir(_outputDir).filePath(QDateTime::currentDateTime().toString("'cangaroo-'yyyyMMdd-hhmmss"));
+    QString filename = base + ".log";
+    for (int i=1; QFile::exists(filename); i++) {
+        filename = QString("%1-%2.log").arg(base).arg(i);
+    }
+    return filename;
+}
+
+void CaptureDaemon::rotate()
+{
+    if (!_writer || _stopped) {
+        return;
+    }
+
+    // the trace is fed on this thread, so no frame is between files
+    // on failure (permissions, disk full, directory gone) keep writing the current file
+    QString previous = _writer->getFileName();
+    if (_writer->open(nextFileName())) {
+        log_info(QString("Closed capture file %1").arg(previous));
+    } else {
+        log_warning(QString("Still capturing to %1").arg(previous));
+    }
+}
+
+void CaptureDaemon::printStats()
+{
+    double secs = _statsElapsed.isValid() ? (_statsElapsed.restart() / 1000.0) : 0;
+    double rate = (secs > 0) ? ((_frames - _statsFrames) / secs) : 0;
+    _statsFrames = _frames;
+
+    fprintf(stdout, "%s frames=%llu rate=%.0f/s lost=%llu",
+        QDateTime::currentDateTime().toString(Qt::ISODate).toLatin1().constData(),
+        (unsigned long long)_frames, rate, (unsigned long long)_lostFrames);
+    if (_writer) {
+        fprintf(stdout, " written=%llu file=%s",
+            (unsigned long long)_writer->getBytesWritten(),
+            _writer->getFileName().toLocal8Bit().constData());
+    }
+    fprintf(stdout, "\n");
+
+    foreach (MeasurementNetwork *network, _backend.getSetup().getNetworks()) {
+        foreach (MeasurementInterface *mi, network->interfaces()) {
+            CanInterface *intf = _backend.getInterfaceById(mi->canInterface());
+            if (!intf) {
+                continue;
+            }
+            intf->updateStatistics();
+            fprintf(stdout, "  %s: %s rx=%d rx_errors=%d tx=%d tx_errors=%d overruns=%d dropped=%d\n",
+                intf->getName().toLocal8Bit().constData(),
+                intf->getStateText().toLocal8Bit().constData(),
+                intf->getNumRxFrames(), intf->getNumRxErrors(),
+                intf->getNumTxFrames(), intf->getNumTxErrors(),
+                intf->getNumRxOverruns(), intf->getNumRxDropped());
+        }
+    }
+    fflush(stdout);
+}
+
+void CaptureDaemon::onLogMessage(const QDateTime dt, const log_level_t level, const QString msg)
+{
+    if ((level == log_level_debug) && !_verbose) {
+        return;
+    }
+    fprintf(stderr, "%s %s: %s\n",
+        dt.toString(Qt::ISODate).toLatin1().constData(),
+        LogModel::logLevelText(level).toLatin1().constData(),
+        msg.toLocal8Bit().constData());
+}
+
+void CaptureDaemon::signalHandler(int signo)
+{
+    // only async-signal-safe work here, the rest happens in onSignal()
+    char c = (char)signo;
+    ssize_t n = ::write(_signalFds[0], &c, 1);
+    (void) n;
+}
+
+bool CaptureDaemon::installSignalHandlers()
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, _signalFds) < 0) {
+        log_error("Cannot create signal socket pair");
+        return false;
+    }
+
+    _signalNotifier = new QSocketNotifier(_signalFds[1], QSocketNotifier::Read, this);
+    connect(_signalNotifier, SIGNAL(activated(int)), this, SLOT(onSignal()));
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    int signos[] = { SIGHUP, SIGUSR1, SIGINT, SIGTERM };
+    for (unsigned i=0; i<sizeof(signos)/sizeof(signos[0]); i++) {
+        if (sigaction(signos[i], &sa, 0) < 0) {
+            log_error(QString("Cannot install handler for signal %1").arg(signos[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+void CaptureDaemon::onSignal()
+{
+    char c;
+    if (::read(_signalFds[1], &c, 1) != 1) {
+        return;
+    }
+
+    switch (c) {
+        case SIGHUP:
+            rotate();
+            break;
+        case SIGUSR1:
+            printStats();
+            break;
+        case SIGINT:
+        case SIGTERM:
+            quit();
+            break;
+    }
+}
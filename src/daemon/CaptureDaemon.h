@@ -0,0 +1,100 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <core/Log.h>
+#include <core/CanTraceSink.h>
+
+class Backend;
+class CanDumpWriter;
+class QSocketNotifier;
+
+/*
+ * Runs a measurement without the GUI, capturing to candump log files in a
+ * directory and/or handing frames to the stream and shared-memory sinks.
+ *
+ * The trace does not keep frames, so memory stays flat however long it
+ * runs, and nothing polls: between frames only the statistics timer
+ * wakes up.
+ *
+ * Signals:
+ *   SIGHUP          continue in a new capture file
+ *   SIGUSR1         print statistics now
+ *   SIGINT/SIGTERM  stop the measurement, flush and exit
+ */
+class CaptureDaemon : public QObject, public CanTraceSink
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureDaemon(Backend &backend, QObject *parent=0);
+    virtual ~CaptureDaemon();
+
+    // empty for no capture files
+    void setOutputDir(const QString &dir);
+    // 0 prints statistics on SIGUSR1 only
+    void setStatsInterval(int seconds);
+    void setVerbose(bool verbose);
+
+    bool start();
+
+    // counts frames for the statistics
+    virtual void publish(const CanMessage &msg);
+
+public slots:
+    void rotate();
+    void printStats();
+    void stop();
+    void quit();
+
+private slots:
+    void onSignal();
+    void onLogMessage(const QDateTime dt, const log_level_t level, const QString msg);
+
+private:
+    static int _signalFds[2];
+    static void signalHandler(int signo);
+    bool installSignalHandlers();
+
+    Backend &_backend;
+    CanDumpWriter *_writer;
+    QString _outputDir;
+    bool _verbose;
+    bool _stopped;
+
+    QSocketNotifier *_signalNotifier;
+    QTimer _statsTimer;
+    QElapsedTimer _statsElapsed;
+
+    uint64_t _frames;
+    uint64_t _lostFrames;
+    uint64_t _statsFrames;
+
+    QString nextFileName() const;
+};
@@ -0,0 +1,51 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Headless capture daemon: the backend and drivers of cangaroo without any
+# widgets. The drivers leave out their setup dialog pages when
+# CANGAROO_HEADLESS is defined.
+
+QT = core
+QT += xml
+QT += serialport
+
+TARGET = cangaroo-capture
+TEMPLATE = app
+CONFIG += console warn_on c++11
+CONFIG += link_pkgconfig
+CONFIG -= app_bundle
+DEFINES += CANGAROO_HEADLESS
+
+SRC = $$clean_path($$PWD/..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../bin
+MOC_DIR = ../../build/daemon/moc
+OBJECTS_DIR = ../../build/daemon/o
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/CaptureDaemon.cpp
+
+HEADERS += \
+    $$PWD/CaptureDaemon.h
+
+include($$SRC/core/core.pri)
+include($$SRC/publish/publish.pri)
+include($$SRC/driver/driver.pri)
+include($$SRC/parser/dbc/dbc.pri)
+
+# widgets, only used by the GUI
+SOURCES -= \
+    $$SRC/core/ConfigurableWidget.cpp \
+    $$SRC/driver/GenericCanSetupPage.cpp
+HEADERS -= \
+    $$SRC/core/ConfigurableWidget.h \
+    $$SRC/driver/GenericCanSetupPage.h
+FORMS -= \
+    $$SRC/driver/GenericCanSetupPage.ui
+
+PKGCONFIG += libnl-3.0
+PKGCONFIG += libnl-route-3.0
+include($$SRC/driver/SocketCanDriver/SocketCanDriver.pri)
+include($$SRC/driver/CANBlastDriver/CANBlastDriver.pri)
+include($$SRC/driver/SLCANDriver/SLCANDriver.pri)
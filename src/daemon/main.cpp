@@ -0,0 +1,260 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QTimer>
+#include <stdio.h>
+
+#include <core/Backend.h>
+#include <core/CanCaptureFilter.h>
+#include <core/CanDumpReader.h>
+#include <core/CanReplay.h>
+#include <driver/CanInterface.h>
+#include <driver/DefaultDrivers.h>
+#include <publish/TracePublisher.h>
+#include "CaptureDaemon.h"
+
+Q_DECLARE_METATYPE(log_level_t)
+
+static CanInterface *findOpenInterface(Backend &backend, const QString &name)
+{
+    foreach (CanInterfaceId id, backend.getInterfaceList()) {
+        CanInterface *intf = backend.getInterfaceById(id);
+        if (intf && (intf->getName() == name) && intf->isOpen()) {
+            return intf;
+        }
+    }
+    return 0;
+}
+
+// candump notation: 3 digits for a standard id, 8 for an extended one
+static bool parseId(const QString &str, uint32_t &id)
+{
+    bool ok = false;
+    id = str.toUInt(&ok, 16);
+    if (!ok || ((str.length() != 3) && (str.length() != 8))) {
+        return false;
+    }
+    if (str.length() == 8) {
+        id = (id & CanCaptureFilter::mask_id_ext) | CanCaptureFilter::flag_extended;
+    } else if (id > CanCaptureFilter::mask_id_std) {
+        return false;
+    }
+    return true;
+}
+
+static CanReplay *createReplay(Backend &backend, const CanDumpReader &reader, const QStringList &channelMaps, const QStringList &idMaps)
+{
+    CanReplay *replay = new CanReplay();
+    replay->setFrames(reader.getFrames());
+
+    // every channel of the log goes to the interface of the same name, unless mapped elsewhere
+    QStringList names = reader.getInterfaceNames();
+    QStringList targets = names;
+    foreach (QString map, channelMaps) {
+        QStringList parts = map.split("=");
+        int idx = (parts.size() == 2) ? names.indexOf(parts[0]) : -1;
+        if (idx < 0) {
+            log_error(QString("Invalid channel mapping %1: the log has channels %2").arg(map).arg(names.join(", ")));
+            delete replay;
+            return 0;
+        }
+        targets[idx] = parts[1];
+    }
+
+    for (int i=0; i<names.size(); i++) {
+        CanInterface *intf = findOpenInterface(backend, targets[i]);
+        if (intf) {
+            replay->mapChannel(i, intf);
+        } else {
+            log_warning(QString("Not replaying channel %1: no open interface %2").arg(names[i]).arg(targets[i]));
+        }
+    }
+
+    foreach (QString map, idMaps) {
+        QStringList parts = map.split("=");
+        uint32_t from, to;
+        if ((parts.size() != 2) || !parseId(parts[0], from) || !parseId(parts[1], to)) {
+            log_error(QString("Invalid id mapping %1, expected e.g. 123=456 or 12345678=123").arg(map));
+            delete replay;
+            return 0;
+        }
+        replay->mapId(from, to);
+    }
+
+    return replay;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("cangaroo-capture");
+    qRegisterMetaType<log_level_t>("log_level_t");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Capture CAN traffic without the cangaroo GUI, and replay candump logs.\n"
+        "SIGHUP starts a new capture file, SIGUSR1 prints statistics, SIGINT/SIGTERM stop.");
+    parser.addHelpOption();
+    QCommandLineOption workspaceOption(QStringList() << "w" << "workspace",
+        "Take the measurement setup (interfaces, bitrates, filters) from a workspace file. "
+        "Without, every interface found is captured at 500 kbit/s.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+        "Write candump log files to this directory.", "dir");
+    QCommandLineOption tcpOption("tcp", "Stream frames to TCP clients.");
+    QCommandLineOption multicastOption("multicast", "Stream frames to the UDP multicast group.");
+    QCommandLineOption lanOption("lan",
+        "Accept TCP clients and send multicast beyond this host; without it, streams stay on this host. "
+        "The stream is not authenticated.");
+    QCommandLineOption shmOption("shm", "Publish frames to the shared-memory ring.");
+    QCommandLineOption discoverOption("discover",
+        "Listen this long for network adapters (CANblaster servers) announcing themselves "
+        "before taking the setup, 0 to skip (default 3).", "seconds", "3");
+    QCommandLineOption statsOption(QStringList() << "s" << "stats",
+        "Print statistics every n seconds, 0 for SIGUSR1 only (default 10).", "n", "10");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Log debug messages too.");
+    QCommandLineOption replayOption(QStringList() << "r" << "replay",
+        "Send the frames of a candump log file, keeping their timing. "
+        "Without a capture option, exit when done.", "file");
+    QCommandLineOption speedOption("speed", "Replay speed factor, 0 for back to back (default 1).", "factor", "1");
+    QCommandLineOption loopsOption("loops", "Replay passes, 0 to repeat until stopped (default 1).", "n", "1");
+    QCommandLineOption mapOption("map",
+        "Replay the frames of log channel src on interface dst (default: same name). Repeatable.", "src=dst");
+    QCommandLineOption remapOption("remap",
+        "Replay frames with id from with id to instead; 8 digits for extended ids. Repeatable.", "from=to");
+    QCommandLineOption spinOption("spin",
+        "Busy-wait the last us microseconds before each frame (default 200).", "us", "200");
+    QCommandLineOption realtimeOption("realtime", "Replay with SCHED_FIFO priority (needs CAP_SYS_NICE).");
+    parser.addOption(workspaceOption);
+    parser.addOption(outputOption);
+    parser.addOption(tcpOption);
+    parser.addOption(multicastOption);
+    parser.addOption(lanOption);
+    parser.addOption(shmOption);
+    parser.addOption(discoverOption);
+    parser.addOption(statsOption);
+    parser.addOption(verboseOption);
+    parser.addOption(replayOption);
+    parser.addOption(speedOption);
+    parser.addOption(loopsOption);
+    parser.addOption(mapOption);
+    parser.addOption(remapOption);
+    parser.addOption(spinOption);
+    parser.addOption(realtimeOption);
+    parser.process(app);
+
+    bool tcp = parser.isSet(tcpOption);
+    bool multicast = parser.isSet(multicastOption);
+    bool shm = parser.isSet(shmOption);
+    bool capture = parser.isSet(outputOption) || tcp || multicast || shm;
+    bool replay = parser.isSet(replayOption);
+    if (!capture && !replay) {
+        fprintf(stderr, "Nothing to capture to: give --output, --tcp, --multicast or --shm.\n");
+        return 1;
+    }
+
+    bool ok = false;
+    int statsInterval = parser.value(statsOption).toInt(&ok);
+    if (!ok || (statsInterval < 0)) {
+        fprintf(stderr, "Invalid statistics interval: %s\n", parser.value(statsOption).toLocal8Bit().constData());
+        return 1;
+    }
+    double speed = parser.value(speedOption).toDouble(&ok);
+    if (!ok || (speed < 0)) {
+        fprintf(stderr, "Invalid replay speed: %s\n", parser.value(speedOption).toLocal8Bit().constData());
+        return 1;
+    }
+    unsigned loops = parser.value(loopsOption).toUInt(&ok);
+    if (!ok) {
+        fprintf(stderr, "Invalid replay loop count: %s\n", parser.value(loopsOption).toLocal8Bit().constData());
+        return 1;
+    }
+    unsigned spin = parser.value(spinOption).toUInt(&ok);
+    if (!ok) {
+        fprintf(stderr, "Invalid spin time: %s\n", parser.value(spinOption).toLocal8Bit().constData());
+        return 1;
+    }
+    double discover = parser.value(discoverOption).toDouble(&ok);
+    if (!ok || (discover < 0)) {
+        fprintf(stderr, "Invalid discovery time: %s\n", parser.value(discoverOption).toLocal8Bit().constData());
+        return 1;
+    }
+
+    Backend &backend = Backend::instance();
+
+    // before anything logs
+    CaptureDaemon daemon(backend);
+    daemon.setVerbose(parser.isSet(verboseOption));
+    daemon.setOutputDir(parser.value(outputOption));
+    daemon.setStatsInterval(statsInterval);
+
+    addDefaultDrivers(backend);
+    if (discover > 0) {
+        // drivers that discover adapters on the network collect announcements from the event loop
+        QEventLoop loop;
+        QTimer::singleShot((int)(discover * 1000), &loop, SLOT(quit()));
+        loop.exec();
+    }
+    backend.setDefaultSetup();
+    if (parser.isSet(workspaceOption) && !backend.loadWorkspaceSetup(parser.value(workspaceOption))) {
+        return 1;
+    }
+
+    TracePublisher publisher(*backend.getTrace());
+    if (tcp || multicast) {
+        publisher.setStreaming(tcp, multicast, parser.isSet(lanOption));
+    }
+    if (shm) {
+        publisher.setShmPublishing(true);
+        if (!publisher.isShmPublishing()) {
+            return 1;
+        }
+    }
+
+    if (!daemon.start()) {
+        return 1;
+    }
+
+    if (replay) {
+        CanDumpReader reader;
+        if (!reader.load(parser.value(replayOption))) {
+            return 1;
+        }
+        CanReplay *r = createReplay(backend, reader, parser.values(mapOption), parser.values(remapOption));
+        if (!r) {
+            return 1;
+        }
+        r->setSpeed(speed);
+        r->setLoops(loops);
+        r->setSpinTime(spin);
+        r->setRealtime(parser.isSet(realtimeOption));
+
+        if (!capture) {
+            QObject::connect(&backend, SIGNAL(replayFinished()), &daemon, SLOT(quit()));
+        }
+        if (!backend.startReplay(r)) {
+            return 1;
+        }
+    }
+
+    return app.exec();
+}
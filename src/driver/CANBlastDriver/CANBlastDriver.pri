@@ -3,10 +3,12 @@ QT += network
 
 SOURCES += \
     $$PWD/CANBlasterDriver.cpp \
+    $$PWD/CANBlasterDiscovery.cpp \
     $$PWD/CANBlasterInterface.cpp
 
 HEADERS  += \
     $$PWD/CANBlasterDriver.h \
+    $$PWD/CANBlasterDiscovery.h \
     $$PWD/CANBlasterInterface.h
 
 FORMS +=
@@ -0,0 +1,91 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CANBlasterDiscovery.h"
+
+#include <core/Log.h>
+
+#include <QtNetwork/QUdpSocket>
+#include <QNetworkDatagram>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+CANBlasterDiscovery::CANBlasterDiscovery(QObject *parent)
+  : QObject(parent),
+    _socket(new QUdpSocket(this))
+{
+    _clock.start();
+
+    if (!_socket->bind(QHostAddress::AnyIPv4, 20000, QUdpSocket::ShareAddress)
+     || !_socket->joinMulticastGroup(QHostAddress("239.255.43.21"))) {
+        log_warning(QString("CANblaster: cannot listen for server announcements: %1").arg(_socket->errorString()));
+        return;
+    }
+    connect(_socket, SIGNAL(readyRead()), this, SLOT(readAnnouncements()));
+}
+
+CANBlasterDiscovery::~CANBlasterDiscovery()
+{
+}
+
+QStringList CANBlasterDiscovery::servers()
+{
+    // also take what arrived since the event loop last ran
+    readAnnouncements();
+
+    QStringList retval;
+    qint64 now = _clock.elapsed();
+    QMap<QString, qint64>::iterator it = _lastSeen.begin();
+    while (it != _lastSeen.end()) {
+        if ((now - it.value()) > expiry_ms) {
+            it = _lastSeen.erase(it);
+        } else {
+            retval.append(it.key());
+            ++it;
+        }
+    }
+    return retval;
+}
+
+void CANBlasterDiscovery::readAnnouncements()
+{
+    while (_socket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = _socket->receiveDatagram(1024);
+        if (!datagram.isValid()) {
+            continue;
+        }
+
+        QString sender = datagram.senderAddress().toString();
+        QJsonObject rootObj = QJsonDocument::fromJson(datagram.data()).object();
+        if ((rootObj.length() == 2)
+         && (rootObj["protocol"].toString() == "CANblaster")
+         && (rootObj["version"].toInt() == 1)) {
+            if (!_lastSeen.contains(sender)) {
+                log_info(QString("CANblaster: found server %1").arg(sender));
+            }
+            _lastSeen[sender] = _clock.elapsed();
+        } else if (!_rejected.contains(sender)) {
+            log_warning(QString("CANblaster: ignoring announcement from %1, protocol %2 version %3")
+                .arg(sender).arg(rootObj["protocol"].toString()).arg(rootObj["version"].toInt()));
+            _rejected.insert(sender);
+        }
+    }
+}
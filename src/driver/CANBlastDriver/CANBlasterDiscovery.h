@@ -0,0 +1,65 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+
+class QUdpSocket;
+
+/*
+ * Listens for the multicast announcements of CANblaster servers,
+ * {"protocol": "CANblaster", "version": 1} sent to 239.255.43.21:20000.
+ *
+ * The socket stays open for the lifetime of the driver and is read from
+ * the event loop, so servers() answers at once with what has been heard
+ * so far instead of listening for a while on the caller's thread. A server
+ * drops out once it has not announced itself for expiry_ms.
+ */
+class CANBlasterDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CANBlasterDiscovery(QObject *parent=0);
+    virtual ~CANBlasterDiscovery();
+
+    // addresses of the servers heard lately, in order of address
+    QStringList servers();
+
+private slots:
+    void readAnnouncements();
+
+private:
+    enum {
+        expiry_ms = 10000
+    };
+
+    QUdpSocket *_socket;
+    QElapsedTimer _clock;
+    QMap<QString, qint64> _lastSeen; // server address, _clock time of its last announcement
+    QSet<QString> _rejected;         // senders of invalid announcements, reported once
+};
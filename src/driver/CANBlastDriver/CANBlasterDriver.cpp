@@ -22,98 +22,38 @@
 
 #include "CANBlasterDriver.h"
 #include "CANBlasterInterface.h"
+#include "CANBlasterDiscovery.h"
 #include <core/Backend.h>
+#if !defined(CANGAROO_HEADLESS)
 #include <driver/GenericCanSetupPage.h>
+#endif
 
-#include <errno.h>
-#include <cstring>
-#include <stdio.h>
-#include <unistd.h>
-#include <string.h>
-
-#include <QCoreApplication>
-#include <QDebug>
-#include <QtNetwork/QUdpSocket>
-#include <QNetworkDatagram>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QList>
 
 CANBlasterDriver::CANBlasterDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(0),
+    _discovery(new CANBlasterDiscovery())
 {
+#if !defined(CANGAROO_HEADLESS)
+    setupPage = new GenericCanSetupPage();
     QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
+#endif
 }
 
 CANBlasterDriver::~CANBlasterDriver() {
+    delete _discovery;
 }
 
 bool CANBlasterDriver::update() {
 
     deleteAllInterfaces();
 
-    // TODO: Listen for multicast packets for discovery of canblaster servers
-    QUdpSocket udpSocket;
-    QHostAddress groupAddress;
-    groupAddress.setAddress("239.255.43.21");
-    udpSocket.bind(QHostAddress::AnyIPv4, 20000, QUdpSocket::ShareAddress);
-    udpSocket.joinMulticastGroup(groupAddress);
-
-    // Record start time
-    struct timeval start_time;
-    gettimeofday(&start_time,NULL);
-
-    fprintf(stderr, "CANblaster: start listen\r\n");
-
-    QList<QString> detected_servers;
-
-    while(1)
-    {
-        while (udpSocket.hasPendingDatagrams())
-        {
-            QNetworkDatagram res = udpSocket.receiveDatagram(1024);
-            if(res.isValid())
-            {
-                QByteArray asd = res.data();
-                qDebug() << asd;
-                QJsonDocument document = QJsonDocument::fromJson(res.data());
-                QJsonObject rootObj = document.object();
-
-
-                if(rootObj.length() == 2 &&
-                   rootObj["protocol"].toString() == "CANblaster" &&
-                   rootObj["version"].toInt() == 1)
-                {
-                    if(!detected_servers.contains(res.senderAddress().toString()))
-                        detected_servers.append(res.senderAddress().toString());
-                }
-                else
-                {
-                    fprintf(stderr, "Invalid CANblaster server. Protocol: %s  Version: %d \r\n", rootObj["protocol"].toString().toStdString().c_str(), rootObj["version"].toInt());
-                }
-            }
-        }
-
-        struct timeval tv;
-        gettimeofday(&tv,NULL);
-
-        // Iterate until timer expires
-        if(tv.tv_sec - start_time.tv_sec > 2)
-            break;
-    }
-    fprintf(stderr, "CANblaster: stop listen\r\n");
-
-    fprintf(stderr, "Found %d servers: \r\n", detected_servers.length());
+    // servers announce themselves every few seconds; take those heard so far instead of waiting here
     int interface_cnt = 0;
-
-    for(QString server: detected_servers)
-    {
-        fprintf(stderr, "  - %s\r\n", server.toStdString().c_str());
-        createOrUpdateInterface(interface_cnt++, server, false);
+    foreach (QString server, _discovery->servers()) {
+        createOrUpdateInterface(interface_cnt++, server, true);
     }
 
-
     return true;
 }
 
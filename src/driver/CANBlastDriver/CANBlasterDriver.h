@@ -26,6 +26,7 @@
 #include <driver/CanDriver.h>
 
 class CANBlasterInterface;
+class CANBlasterDiscovery;
 class SetupDialogInterfacePage;
 class GenericCanSetupPage;
 
@@ -40,4 +41,5 @@ public:
 private:
     CANBlasterInterface *createOrUpdateInterface(int index, QString name, bool fd_support);
     GenericCanSetupPage *setupPage;
+    CANBlasterDiscovery *_discovery;
 };
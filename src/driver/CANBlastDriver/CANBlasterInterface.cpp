@@ -24,18 +24,26 @@
 #include <core/Backend.h>
 #include <core/MeasurementInterface.h>
 #include <core/CanMessage.h>
+#include <core/HostClock.h>
+#include <driver/CanMessageBatch.h>
 
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <fcntl.h>
 #include <QString>
 #include <QStringList>
 #include <QProcess>
-#include <QThread>
 #include <QTimer>
 #include <QNetworkDatagram>
 
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#endif
+
 
 CANBlasterInterface::CANBlasterInterface(CANBlasterDriver *driver, int index, QString name, bool fd_support)
   : CanInterface((CanDriver *)driver),
@@ -43,8 +51,34 @@ CANBlasterInterface::CANBlasterInterface(CANBlasterDriver *driver, int index, QS
     _isOpen(false),
     _name(name),
     _ts_mode(ts_mode_SIOCSHWTSTAMP),
-    _socket(NULL)
+    _socket(NULL),
+    _rx_count(0),
+    _rx_next(0),
+    _rx_offset(0),
+#if defined(__linux__)
+    _rx_use_mmsg(true),
+#endif
+    _rx_seq_valid(false),
+    _rx_next_seq(0),
+    _rx_lost(0),
+    _rx_lost_reported(0),
+    _rx_syscall_count(0),
+    _rx_datagram_count(0)
 {
+    memset(&_status, 0, sizeof(_status));
+
+#if defined(__linux__)
+    // all buffers are set up once, recvmmsg() only needs msg_controllen reset
+    memset(_rx_mmsg, 0, sizeof(_rx_mmsg));
+    for (int i=0; i<rx_mmsg_count; i++) {
+        _rx_iov[i].iov_base = _rx_buffers[i];
+        _rx_iov[i].iov_len = max_datagram_size;
+        _rx_mmsg[i].msg_hdr.msg_iov = &_rx_iov[i];
+        _rx_mmsg[i].msg_hdr.msg_iovlen = 1;
+        _rx_mmsg[i].msg_hdr.msg_control = _rx_cmsg[i];
+    }
+#endif
+
     // Set defaults
     _settings.setBitrate(500000);
     _settings.setSamplePoint(875);
@@ -195,6 +229,23 @@ int CANBlasterInterface::getNumTxDropped()
     return _status.tx_dropped;
 }
 
+QString CANBlasterInterface::getStatusDetailsStr()
+{
+    if (!_rx_syscall_count) {
+        return "";
+    }
+#if defined(__linux__)
+    QString mode = _rx_use_mmsg ? "recvmmsg" : "readDatagram";
+#else
+    QString mode = "readDatagram";
+#endif
+    return QString("%1: %2 datagrams/call, %3 frames/datagram, %4 frames lost")
+        .arg(mode)
+        .arg((double)_rx_datagram_count / _rx_syscall_count, 0, 'f', 2)
+        .arg(_rx_datagram_count ? ((double)_status.rx_count / _rx_datagram_count) : 0.0, 0, 'f', 2)
+        .arg((unsigned long long)_rx_lost);
+}
+
 int CANBlasterInterface::getIfIndex() {
     return _idx;
 }
@@ -214,8 +265,25 @@ void CANBlasterInterface::open()
     }
     _socket = new QUdpSocket();
 
+    _rx_count = 0;
+    _rx_next = 0;
+    _rx_offset = 0;
+    _rx_seq_valid = false;
+    _rx_lost = 0;
+    _rx_lost_reported = 0;
+    memset(&_status, 0, sizeof(_status));
+
     if(_socket->bind(QHostAddress::AnyIPv4, 20001))
     {
+        // room for bursts while the thread is busy with a full batch
+        _socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, rx_buffer_size);
+#if defined(__linux__)
+        // the kernel receive time of each datagram comes along with it
+        int enable = 1;
+        if (setsockopt(_socket->socketDescriptor(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+            log_warning(QString("%1: SO_TIMESTAMPNS not supported, using host timestamps").arg(getName()));
+        }
+#endif
         _isOpen = true;
     }
     else
@@ -243,11 +311,8 @@ void CANBlasterInterface::sendMessage(const CanMessage &msg) {
 
 }
 
-bool CANBlasterInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms)
+void CANBlasterInterface::sendHeartbeat()
 {
-    // Don't saturate the thread
-    QThread().usleep(250);
-
     // Record start time
     struct timeval now;
     gettimeofday(&now,NULL);
@@ -264,59 +329,230 @@ bool CANBlasterInterface::readMessage(QList<CanMessage> &msglist, unsigned int t
             _socket->writeDatagram(Data, QHostAddress(getName()), 20002);
         }
     }
+}
 
-    // NOTE: This only works with standard CAN frames right now!
+void CANBlasterInterface::waitForDatagrams(unsigned int timeout_ms)
+{
+#if defined(__linux__)
+    struct pollfd pfd;
+    pfd.fd = _socket->socketDescriptor();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll(&pfd, 1, timeout_ms);
+#else
+    _socket->waitForReadyRead(timeout_ms);
+#endif
+}
 
-    // Process all pending datagrams
-    // TODO: Could switch to if from while but the caller expects 1 can frame
-    if (_isOpen && _socket->hasPendingDatagrams())
-    {
-        can_frame frame;
-        QHostAddress address;
-        quint16 port;
-        int res = _socket->readDatagram((char*)&frame, sizeof(can_frame), &address, &port);
-
-        // TODO: Read all bytes... to CANFD_MTU max
-//        if (nbytes == CANFD_MTU) {
-//                printf("got CAN FD frame with length %d\n", cfd.len);
-//                /* cfd.flags contains valid data */
-//        } else if (nbytes == CAN_MTU) {
-//                printf("got Classical CAN frame with length %d\n", cfd.len);
-//                /* cfd.flags is undefined */
-//        } else {
-//                fprintf(stderr, "read: invalid CAN(FD) frame\n");
-//                return 1;
-//        }
-
-        if(res > 0)
-        {
-            // Set timestamp to current time
-            struct timeval tv;
-            gettimeofday(&tv,NULL);
-            CanMessage msg;
-            msg.setTimestamp(tv);
-
-            msg.setInterfaceId(getId());
-            msg.setId(frame.can_id & CAN_ERR_MASK);
-            msg.setBRS(false);
-            msg.setErrorFrame(frame.can_id & CAN_ERR_FLAG);
-            msg.setExtended(frame.can_id & CAN_EFF_FLAG);
-            msg.setRTR(frame.can_id & CAN_RTR_FLAG);
-            msg.setLength(frame.len);
-
-            for(int i=0; i<frame.len && i<CAN_MAX_DLEN; i++)
-            {
-                msg.setDataAt(i, frame.data[i]);
+int CANBlasterInterface::receiveDatagrams()
+{
+    _rx_count = 0;
+    _rx_next = 0;
+    _rx_offset = 0;
+
+#if defined(__linux__)
+    if (_rx_use_mmsg) {
+        // the kernel overwrites msg_controllen with the length actually used
+        for (int i=0; i<rx_mmsg_count; i++) {
+            _rx_mmsg[i].msg_hdr.msg_controllen = sizeof(_rx_cmsg[i]);
+        }
+
+        int rv = recvmmsg(_socket->socketDescriptor(), _rx_mmsg, rx_mmsg_count, MSG_DONTWAIT, NULL);
+        if (rv < 0) {
+            if (errno == ENOSYS) {
+                log_warning(QString("%1: recvmmsg not supported, falling back to per-datagram reads").arg(getName()));
+                _rx_use_mmsg = false;
             }
-            msglist.append(msg);
-            return true;
+            return 0;
         }
-        else
-        {
-            return false;
+        _rx_syscall_count++;
+
+        uint64_t now = HostClock::nowNs();
+        for (int i=0; i<rv; i++) {
+            struct msghdr *hdr = &_rx_mmsg[i].msg_hdr;
+            _rx_lengths[i] = (hdr->msg_flags & MSG_TRUNC) ? -1 : (int)_rx_mmsg[i].msg_len;
+            _rx_stamps_ns[i] = now;
+            _rx_stamp_sources[i] = CanMessage::timestamp_source_host;
+
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    _rx_stamps_ns[i] = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+                    _rx_stamp_sources[i] = CanMessage::timestamp_source_kernel_software;
+                }
+            }
         }
+        _rx_count = rv;
+        _rx_datagram_count += rv;
+        return rv;
     }
-    return false;
+#endif
+
+    uint64_t now = HostClock::nowNs();
+    while ((_rx_count < rx_mmsg_count) && _socket->hasPendingDatagrams()) {
+        int i = _rx_count;
+        bool truncated = (_socket->pendingDatagramSize() > max_datagram_size);
+        qint64 res = _socket->readDatagram(_rx_buffers[i], max_datagram_size);
+        if (res < 0) {
+            break;
+        }
+        _rx_lengths[i] = truncated ? -1 : (int)res;
+        _rx_stamps_ns[i] = now;
+        _rx_stamp_sources[i] = CanMessage::timestamp_source_host;
+        _rx_count++;
+    }
+    _rx_syscall_count++;
+    _rx_datagram_count += _rx_count;
+    return _rx_count;
+}
 
+void CANBlasterInterface::checkSequence(uint32_t seq, uint16_t count)
+{
+    // a jump back means the sender restarted (or UDP reordered); only forward gaps are losses
+    if (_rx_seq_valid && (seq != _rx_next_seq)) {
+        int32_t gap = (int32_t)(seq - _rx_next_seq);
+        if (gap > 0) {
+            _rx_lost += gap;
+            _status.rx_overruns = _rx_lost;
+        }
+    }
+    _rx_next_seq = seq + count;
+    _rx_seq_valid = true;
 }
 
+void CANBlasterInterface::decodeFrame(const char *data, bool is_fd, int datagram, CanMessageBatch &batch)
+{
+    // can_frame and canfd_frame share their layout up to the payload
+    struct canfd_frame frame;
+    memcpy(&frame, data, is_fd ? CANFD_MTU : CAN_MTU);
+
+    if (_rx_lost != _rx_lost_reported) {
+        // a gap marker records the lost frames right before the first frame after the gap
+        CanMessage &marker = batch.next();
+        marker.setTimestampNs(_rx_stamps_ns[datagram]);
+        marker.setTimestampSource(_rx_stamp_sources[datagram]);
+        marker.setId(_rx_lost - _rx_lost_reported);
+        marker.setExtended(false);
+        marker.setRTR(false);
+        marker.setFD(false);
+        marker.setBRS(false);
+        marker.setESI(false);
+        marker.setLength(0);
+        marker.setInterfaceId(getId());
+        marker.setDirection(CanMessage::Rx);
+        marker.setGapMarker(true);
+        batch.commit();
+        _rx_lost_reported = _rx_lost;
+    }
+
+    CanMessage &msg = batch.next();
+    msg.setTimestampNs(_rx_stamps_ns[datagram]);
+    msg.setTimestampSource(_rx_stamp_sources[datagram]);
+    msg.setInterfaceId(getId());
+    msg.setDirection(CanMessage::Rx);
+    msg.setId(frame.can_id & CAN_ERR_MASK);
+    msg.setExtended((frame.can_id & CAN_EFF_FLAG) != 0);
+    msg.setRTR(!is_fd && ((frame.can_id & CAN_RTR_FLAG) != 0));
+    msg.setErrorFrame((frame.can_id & CAN_ERR_FLAG) != 0);
+    msg.setFD(is_fd);
+    msg.setBRS(is_fd && ((frame.flags & CANFD_BRS) != 0));
+    msg.setESI(is_fd && ((frame.flags & CANFD_ESI) != 0));
+
+    uint8_t len = frame.len;
+    uint8_t max_len = is_fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+    if (len > max_len) {
+        len = max_len;
+    }
+    msg.setData(frame.data, len);
+    batch.commit();
+    _status.rx_count++;
+}
+
+void CANBlasterInterface::decodeDatagrams(CanMessageBatch &batch)
+{
+    for (; _rx_next < _rx_count; _rx_next++, _rx_offset = 0) {
+        const char *data = _rx_buffers[_rx_next];
+        int len = _rx_lengths[_rx_next];
+
+        if (_rx_offset == 0) {
+            if (len < 0) {
+                _status.rx_errors++;
+                continue;
+            }
+
+            canblaster_batch_header_t hdr;
+            bool is_batch = false;
+            if (len >= (int)sizeof(hdr)) {
+                memcpy(&hdr, data, sizeof(hdr));
+                is_batch = (hdr.magic == CANBLASTER_BATCH_MAGIC);
+            }
+
+            if (is_batch) {
+                checkSequence(hdr.seq, hdr.count);
+                _rx_offset = sizeof(hdr);
+            } else if ((len == (int)CAN_MTU) || (len == (int)CANFD_MTU)) {
+                // original format: one frame, no sequence number
+                if (((_rx_lost != _rx_lost_reported) ? 2 : 1) > (batch.capacity() - batch.size())) {
+                    return;
+                }
+                decodeFrame(data, len == (int)CANFD_MTU, _rx_next, batch);
+                continue;
+            } else {
+                _status.rx_errors++;
+                continue;
+            }
+        }
+
+        while (_rx_offset < len) {
+            // continue with this datagram in the next call once the batch is full
+            if (((_rx_lost != _rx_lost_reported) ? 2 : 1) > (batch.capacity() - batch.size())) {
+                return;
+            }
+
+            const char *frame = data + _rx_offset;
+            int remaining = len - _rx_offset;
+            bool is_fd = (remaining >= (int)CAN_MTU) && ((frame[offsetof(struct canfd_frame, flags)] & CANFD_FDF) != 0);
+            int size = is_fd ? CANFD_MTU : CAN_MTU;
+            if (remaining < size) {
+                _status.rx_errors++;
+                break;
+            }
+            decodeFrame(frame, is_fd, _rx_next, batch);
+            _rx_offset += size;
+        }
+    }
+}
+
+bool CANBlasterInterface::readMessages(CanMessageBatch &batch, unsigned int timeout_ms)
+{
+    sendHeartbeat();
+
+    if (!_isOpen) {
+        return false;
+    }
+
+    // finish the datagrams of the last call before taking more from the socket
+    int start = batch.size();
+    decodeDatagrams(batch);
+    if (_rx_next < _rx_count) {
+        return batch.size() > start;
+    }
+
+    if (batch.size() == start) {
+        waitForDatagrams(timeout_ms);
+    }
+
+    // drain everything pending, up to the batch capacity
+    while (!batch.isFull()) {
+        int received = receiveDatagrams();
+        decodeDatagrams(batch);
+
+        // stop with datagrams left for the next call, or once a short read shows the socket queue is empty
+        if ((_rx_next < _rx_count) || (received < rx_mmsg_count)) {
+            break;
+        }
+    }
+
+    return batch.size() > start;
+}
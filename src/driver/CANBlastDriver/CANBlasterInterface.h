@@ -23,9 +23,15 @@
 
 #include "../CanInterface.h"
 #include <core/MeasurementInterface.h>
+#include <core/CanMessage.h>
 #include <QtNetwork/QUdpSocket>
 #include <QTimer>
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 class CANBlasterDriver;
 
 typedef struct {
@@ -78,7 +84,7 @@ public:
     virtual bool isOpen();
 
     virtual void sendMessage(const CanMessage &msg);
-    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms);
+    virtual bool readMessages(CanMessageBatch &batch, unsigned int timeout_ms);
 
     virtual bool updateStatistics();
     virtual uint32_t getState();
@@ -90,6 +96,7 @@ public:
     virtual int getNumTxErrors();
     virtual int getNumTxDropped();
 
+    virtual QString getStatusDetailsStr();
 
     int getIfIndex();
 
@@ -100,6 +107,12 @@ private:
         ts_mode_SIOCGSTAMP
     } ts_mode_t;
 
+    enum {
+        rx_mmsg_count = 32,       // datagrams per receive call
+        max_datagram_size = 9216, // a jumbo frame; longer datagrams are counted as errors
+        rx_buffer_size = 4 * 1024 * 1024
+    };
+
     int _idx;
     bool _isOpen;
     QString _name;
@@ -115,8 +128,36 @@ private:
 
     QString _description;
 
+    // datagrams of the last receive call; one that did not fit the batch is continued at _rx_offset
+    char _rx_buffers[rx_mmsg_count][max_datagram_size];
+    int _rx_lengths[rx_mmsg_count];  // -1 if truncated
+    uint64_t _rx_stamps_ns[rx_mmsg_count];
+    CanMessage::TimestampSource _rx_stamp_sources[rx_mmsg_count];
+    int _rx_count;
+    int _rx_next;
+    int _rx_offset;
+#if defined(__linux__)
+    bool _rx_use_mmsg;
+    struct iovec _rx_iov[rx_mmsg_count];
+    struct mmsghdr _rx_mmsg[rx_mmsg_count];
+    char _rx_cmsg[rx_mmsg_count][CMSG_SPACE(sizeof(struct timespec))];
+#endif
+
+    bool _rx_seq_valid;
+    uint32_t _rx_next_seq;
+    uint64_t _rx_lost;          // frames missing from the sequence numbers
+    uint64_t _rx_lost_reported; // ... of which a gap marker was added to the trace
+    uint64_t _rx_syscall_count;
+    uint64_t _rx_datagram_count;
+
     const char *cname();
 
+    void sendHeartbeat();
+    void waitForDatagrams(unsigned int timeout_ms);
+    int receiveDatagrams();
+    void decodeDatagrams(CanMessageBatch &batch);
+    void checkSequence(uint32_t seq, uint16_t count);
+    void decodeFrame(const char *data, bool is_fd, int datagram, CanMessageBatch &batch);
 };
 
 
@@ -240,3 +281,29 @@ struct canfd_frame {
 
 #define CAN_MTU		(sizeof(struct can_frame))
 #define CANFD_MTU	(sizeof(struct canfd_frame))
+
+/*
+ * CANblaster datagrams
+ *
+ * A datagram is in one of two formats:
+ *  - The original one: a single struct can_frame or struct canfd_frame,
+ *    told apart by its size.
+ *  - A batch: a canblaster_batch_header_t followed by frames. Each frame is
+ *    a struct can_frame, or a struct canfd_frame if CANFD_FDF is set in its
+ *    flags byte. In a can_frame that byte is __pad, which is zero.
+ *
+ * seq numbers frames, not datagrams. It is the number of the first frame
+ * in the batch, so the receiver sees from a gap how many frames were lost.
+ * The header is in the byte order of the frames, little endian in practice.
+ * The magic has CAN_RTR_FLAG and CAN_ERR_FLAG set, a combination no single
+ * frame carries.
+ */
+#define CANBLASTER_BATCH_MAGIC 0x7CB1A5B0U
+
+typedef struct {
+    uint32_t magic;    // CANBLASTER_BATCH_MAGIC
+    uint32_t seq;      // number of the first frame in this datagram
+    uint16_t count;    // frames following the header
+    uint16_t flags;    // reserved, 0
+    uint32_t reserved;
+} canblaster_batch_header_t;
@@ -96,6 +96,26 @@ void CanDriver::deleteAllInterfaces()
 
 
 
+bool CanDriver::hasSharedIoThread() const
+{
+    return false;
+}
+
+bool CanDriver::addListener(CanListener *listener, CanInterface *intf)
+{
+    (void) listener;
+    (void) intf;
+    return false;
+}
+
+void CanDriver::startListeners()
+{
+}
+
+void CanDriver::stopListeners()
+{
+}
+
 CanInterface *CanDriver::getInterfaceByName(QString ifName)
 {
     foreach (CanInterface *intf, _interfaces) {
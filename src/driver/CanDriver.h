@@ -27,6 +27,7 @@
 
 class Backend;
 class CanInterface;
+class CanListener;
 
 typedef uint16_t CanInterfaceId;
 typedef QList<uint16_t> CanInterfaceIdList;
@@ -54,6 +55,14 @@ public:
 
     CanInterface *getInterfaceByName(QString ifName);
 
+    // Shared I/O: a driver that can serve all its interfaces from one thread takes
+    // their listeners over in addListener() and runs them from startListeners()
+    // until stopListeners(). Listeners it does not take run their own thread.
+    virtual bool hasSharedIoThread() const;
+    virtual bool addListener(CanListener *listener, CanInterface *intf);
+    virtual void startListeners();
+    virtual void stopListeners();
+
 private:
     Backend &_backend;
     int _id;
@@ -22,6 +22,7 @@
 #include "CanInterface.h"
 
 #include <QList>
+#include <core/CanMessage.h>
 
 CanInterface::CanInterface(CanDriver *driver)
   : _id(-1), _driver(driver)
@@ -77,6 +78,60 @@ bool CanInterface::updateStatistics()
     return false;
 }
 
+void CanInterface::sendMessages(const QList<CanMessage> &msgs)
+{
+    foreach (const CanMessage &msg, msgs) {
+        sendMessage(msg);
+    }
+}
+
+bool CanInterface::startCyclicTransmission(const QList<CanMessage> &frames, unsigned interval_us)
+{
+    (void) frames;
+    (void) interval_us;
+    return false;
+}
+
+void CanInterface::stopCyclicTransmission(const CanMessage &msg)
+{
+    (void) msg;
+}
+
+int CanInterface::getNumRxDropped()
+{
+    return 0;
+}
+
+int CanInterface::getTxFlowState()
+{
+    return tx_flow_ok;
+}
+
+int CanInterface::getTxQueueDepth()
+{
+    return 0;
+}
+
+QString CanInterface::getTxFlowStateText()
+{
+    switch (getTxFlowState()) {
+        case tx_flow_ok: return "ok";
+        case tx_flow_throttled: return "throttled";
+        case tx_flow_full: return "full";
+        default: return "";
+    }
+}
+
+QString CanInterface::getStatusDetailsStr()
+{
+    return "";
+}
+
+QString CanInterface::getTimestampModeStr()
+{
+    return "host clock";
+}
+
 bool CanInterface::get_enable_terminal_res()
 {
     return false;
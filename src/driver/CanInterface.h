@@ -28,6 +28,7 @@
 #include <QObject>
 
 class CanMessage;
+class CanMessageBatch;
 class MeasurementInterface;
 
 class CanInterface: public QObject  {
@@ -49,7 +50,25 @@ public:
         capability_one_shot        = 0x08,
         capability_auto_restart    = 0x10,
         capability_config_os       = 0x20,
-        capability_enable_terminal_res = 0x40
+        capability_enable_terminal_res = 0x40,
+        capability_hw_timestamps   = 0x80,
+        capability_capture_filter  = 0x100, // applies MeasurementInterface::captureFilter() itself
+        capability_rx_buffer_size  = 0x200,
+        capability_cyclic_tx       = 0x400  // startCyclicTransmission() timed by driver or OS
+    };
+
+    // transmit flow control of drivers that queue frames before the device takes them
+    enum {
+        tx_flow_ok,        // below the low watermark, or the driver does not queue
+        tx_flow_throttled, // above the high watermark; senders should hold back until it drains
+        tx_flow_full       // no room left, frames sent now are dropped
+    };
+
+    enum {
+        rx_timestamp_auto,     // best the interface offers: hardware, then kernel software, then legacy
+        rx_timestamp_hardware,
+        rx_timestamp_software,
+        rx_timestamp_legacy
     };
 
 public:
@@ -73,7 +92,20 @@ public:
     virtual bool isOpen();
 
     virtual void sendMessage(const CanMessage &msg) = 0;
-    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms) = 0;
+
+    // Queue a burst of frames for transmission. Drivers that can hand several frames
+    // to the OS at once override this; the default sends them one by one.
+    virtual void sendMessages(const QList<CanMessage> &msgs);
+
+    // Send frames in turn, one every interval_us, until stopped. The cycle is identified by
+    // the first frame's id; starting it again while running updates payload and interval
+    // in place. Returns false if the driver cannot do this, callers then have to time it themselves.
+    virtual bool startCyclicTransmission(const QList<CanMessage> &frames, unsigned interval_us);
+    virtual void stopCyclicTransmission(const CanMessage &msg);
+
+    // Append as many received frames as are available to batch, up to its capacity.
+    // Blocks for at most timeout_ms if nothing is available. Returns true if frames were added.
+    virtual bool readMessages(CanMessageBatch &batch, unsigned int timeout_ms) = 0;
 
     virtual bool updateStatistics();
     virtual uint32_t getState() = 0;
@@ -82,7 +114,13 @@ public:
     virtual int getNumTxFrames() = 0;
     virtual int getNumTxErrors() = 0;
     virtual int getNumRxOverruns() = 0;
+    virtual int getNumRxDropped(); // lost between driver and application, e.g. socket queue overflow
     virtual int getNumTxDropped() = 0;
+    virtual int getTxFlowState();
+    virtual int getTxQueueDepth(); // frames accepted by sendMessage() but not yet handed to the device
+    QString getTxFlowStateText();
+    virtual QString getStatusDetailsStr();
+    virtual QString getTimestampModeStr();
     virtual bool get_enable_terminal_res(void);
     virtual void set_enable_terminal_res(bool enable);
     QString getStateText();
@@ -93,6 +131,9 @@ public:
 signals:
     void _hpm_request_msg(QByteArray msg);
 
+    // the driver learned of a state change by itself (e.g. a link event), no need to wait for the next poll
+    void stateChanged();
+
 private:
     CanInterfaceId _id;
     CanDriver *_driver;
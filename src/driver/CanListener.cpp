@@ -34,7 +34,10 @@ CanListener::CanListener(QObject *parent, Backend &backend, CanInterface &intf)
     _backend(backend),
     _intf(intf),
     _shouldBeRunning(true),
-    _openComplete(false)
+    _openComplete(false),
+    _ring(ring_size),
+    _rxBatch(batch_size),
+    _useCaptureFilter(false)
 {
     _thread = new QThread();
 }
@@ -54,13 +57,42 @@ CanInterface &CanListener::getInterface()
     return _intf;
 }
 
+CanMessageRing &CanListener::getRing()
+{
+    return _ring;
+}
+
+uint32_t CanListener::getRingHighWaterMark() const
+{
+    return _ring.highWaterMark();
+}
+
+uint32_t CanListener::getRingDrops() const
+{
+    return _ring.drops();
+}
+
+void CanListener::setCaptureFilter(const CanCaptureFilter &filter)
+{
+    _captureFilter = filter;
+    _useCaptureFilter = !filter.isEmpty();
+}
+
+void CanListener::pushBatch(const CanMessageBatch &batch)
+{
+    // frames that do not fit are counted as ring drops
+    for (int i = 0; i < batch.size(); i++) {
+        if (_useCaptureFilter && !_captureFilter.matches(batch.at(i))) {
+            continue;
+        }
+        _ring.push(batch.at(i));
+    }
+    _backend.getTrace()->notifyIngest();
+}
+
 void CanListener::run()
 {
     // Note: open and close done from run() so all operations take place in the same thread
-    //CanMessage msg;
-    QList<CanMessage> rxMessages;
-    CanTrace *trace = _backend.getTrace();
-
     if(_intf.isOpen() == true)    //Colin
     {  log_info("===>is opend<===");
         _thread->quit();
@@ -70,14 +102,10 @@ void CanListener::run()
     _intf.open();
 
     _openComplete = true;
-    CanMessage msg;
     while (_shouldBeRunning) {
-        if (_intf.readMessage(rxMessages, 1000)) {
-            for (int i = 0; i < rxMessages.size(); i++) {
-                msg = rxMessages.at(i);
-                trace->enqueueMessage(msg, false);
-            }
-            rxMessages.clear();
+        _rxBatch.clear();
+        if (_intf.readMessages(_rxBatch, 1000)) {
+            pushBatch(_rxBatch);
         }
     }
     _intf.close();
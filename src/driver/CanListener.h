@@ -24,6 +24,9 @@
 #include <QObject>
 #include <driver/CanDriver.h>
 #include <driver/CanInterface.h>
+#include <core/CanTrace.h>
+#include <driver/CanMessageBatch.h>
+#include <core/CanCaptureFilter.h>
 
 class QThread;
 class CanMessage;
@@ -40,6 +43,16 @@ public:
     CanInterfaceId getInterfaceId();
     CanInterface &getInterface();
 
+    CanMessageRing &getRing();
+    uint32_t getRingHighWaterMark() const;
+    uint32_t getRingDrops() const;
+
+    // user-space equivalent for interfaces that cannot apply the capture filter themselves
+    void setCaptureFilter(const CanCaptureFilter &filter);
+
+    // hand received frames to the trace; called from whichever thread reads the interface
+    void pushBatch(const CanMessageBatch &batch);
+
 signals:
     void messageReceived(const CanMessage &msg);
 
@@ -51,10 +64,19 @@ public slots:
     void waitFinish();
 
 private:
+    enum {
+        ring_size = 16384,
+        batch_size = 256
+    };
+
     Backend &_backend;
     CanInterface &_intf;
     bool _shouldBeRunning;
     bool _openComplete;
     QThread *_thread;
+    CanMessageRing _ring;
+    CanMessageBatch _rxBatch;
+    CanCaptureFilter _captureFilter;
+    bool _useCaptureFilter;
 
 };
@@ -0,0 +1,76 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanMessageBatch.h"
+
+CanMessageBatch::CanMessageBatch(int capacity)
+  : _slots(capacity),
+    _size(0)
+{
+}
+
+int CanMessageBatch::capacity() const
+{
+    return _slots.size();
+}
+
+int CanMessageBatch::size() const
+{
+    return _size;
+}
+
+bool CanMessageBatch::isEmpty() const
+{
+    return _size == 0;
+}
+
+bool CanMessageBatch::isFull() const
+{
+    return _size >= _slots.size();
+}
+
+void CanMessageBatch::clear()
+{
+    _size = 0;
+}
+
+CanMessage &CanMessageBatch::next()
+{
+    // callers check isFull() first; never hand out a slot past the end
+    CanMessage &msg = _slots[(_size < _slots.size()) ? _size : (_slots.size() - 1)];
+
+    // clear what only some drivers set: gap markers, and ESI for drivers without CAN FD
+    msg.setGapMarker(false);
+    msg.setESI(false);
+    return msg;
+}
+
+void CanMessageBatch::commit()
+{
+    if (_size < _slots.size()) {
+        _size++;
+    }
+}
+
+const CanMessage &CanMessageBatch::at(int idx) const
+{
+    return _slots.at(idx);
+}
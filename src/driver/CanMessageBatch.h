@@ -0,0 +1,53 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QVector>
+#include <core/CanMessage.h>
+
+/*
+ * Caller-owned, fixed-capacity frame buffer for CanInterface::readMessages().
+ *
+ * The slots are allocated once and reused; drivers decode straight into
+ * the slot returned by next() and then commit() it. Since slots are
+ * recycled, drivers must set every field of the message they fill in.
+ */
+class CanMessageBatch
+{
+public:
+    explicit CanMessageBatch(int capacity);
+
+    int capacity() const;
+    int size() const;
+    bool isEmpty() const;
+    bool isFull() const;
+    void clear();
+
+    CanMessage &next();
+    void commit();
+
+    const CanMessage &at(int idx) const;
+
+private:
+    QVector<CanMessage> _slots;
+    int _size;
+};
@@ -1,5 +1,7 @@
 #include "CandleApiDriver.h"
 #include "CandleApiInterface.h"
+#include <driver/CanMessageBatch.h>
+#include <core/HostClock.h>
 
 #include <QDebug>
 
@@ -477,9 +479,8 @@ void CandleApiInterface::sendMessage(const CanMessage &msg)
 
     if (candle_frame_send(_handle, _channel, &frame)) {
         _numTx++;
-        struct timeval tv;
-        gettimeofday(&tv, nullptr); // 获取当前时间
-        msgCopy.setTimestamp(tv);
+        msgCopy.setTimestampNs(HostClock::nowNs());
+        msgCopy.setTimestampSource(CanMessage::timestamp_source_host);
         _backend.addSentMessage(msgCopy);
     } else {
         _numTxErr++;
@@ -487,14 +488,18 @@ void CandleApiInterface::sendMessage(const CanMessage &msg)
     }
 }
 
-bool CandleApiInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms)
+bool CandleApiInterface::readMessages(CanMessageBatch &batch, unsigned int timeout_ms)
 {
     candle_frame_t frame;
-    CanMessage msg;
     uint8_t msg_len;
+    int start = batch.size();
 
-    if (candle_frame_read(_handle, &frame, timeout_ms)) {
+    // only block for the first frame, then take whatever the device has already queued
+    uint32_t timeout = timeout_ms;
+    while (!batch.isFull() && candle_frame_read(_handle, &frame, timeout)) {
+        timeout = 0;
         if (candle_frame_type(&frame)==CANDLE_FRAMETYPE_RECEIVE) {
+            CanMessage &msg = batch.next();
             _numRx++;
             msg.setDirection(CanMessage::Rx);
             msg.setInterfaceId(getId());
@@ -502,6 +507,7 @@ bool CandleApiInterface::readMessage(QList<CanMessage> &msglist, unsigned int ti
             msg.setId(candle_frame_id(&frame));
             msg.setExtended(candle_frame_is_extended_id(&frame));
             msg.setRTR(candle_frame_is_rtr(&frame));
+            msg.setBRS(false);
             if (frame.flags & CANDLE_FLAG_FD) {
                 msg.setFD(true);
             } else {
@@ -554,19 +560,17 @@ bool CandleApiInterface::readMessage(QList<CanMessage> &msglist, unsigned int ti
                 }
 
                 msg.setTimestamp(ts_us/1000000, ts_us % 1000000);
+                msg.setTimestampSource(CanMessage::timestamp_source_device);
             } else {
-                struct timeval tv;
-                gettimeofday(&tv, nullptr); // 获取当前时间
-                msg.setTimestamp(tv);
+                msg.setTimestampNs(HostClock::nowNs());
+                msg.setTimestampSource(CanMessage::timestamp_source_host);
             }
 
-            msglist.append(msg);
-            return true;
+            batch.commit();
         }
-
     }
 
-    return false;
+    return batch.size() > start;
 }
 
 bool CandleApiInterface::updateStatistics()
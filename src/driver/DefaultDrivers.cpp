@@ -0,0 +1,43 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "DefaultDrivers.h"
+
+#include <core/Backend.h>
+#include <driver/SLCANDriver/SLCANDriver.h>
+#include <driver/CANBlastDriver/CANBlasterDriver.h>
+
+#if defined(__linux__)
+#include <driver/SocketCanDriver/SocketCanDriver.h>
+#else
+#include <driver/CandleApiDriver/CandleApiDriver.h>
+#endif
+
+void addDefaultDrivers(Backend &backend)
+{
+#if defined(__linux__)
+    backend.addCanDriver(*(new SocketCanDriver(backend)));
+#else
+    backend.addCanDriver(*(new CandleApiDriver(backend)));
+#endif
+    backend.addCanDriver(*(new SLCANDriver(backend)));
+    backend.addCanDriver(*(new CANBlasterDriver(backend)));
+}
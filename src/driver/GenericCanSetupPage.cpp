@@ -24,6 +24,20 @@ GenericCanSetupPage::GenericCanSetupPage(QWidget *parent) :
     connect(ui->cbOneShot, SIGNAL(stateChanged(int)), this, SLOT(updateUI()));
     connect(ui->cbTripleSampling, SIGNAL(stateChanged(int)), this, SLOT(updateUI()));
     connect(ui->cbAutoRestart, SIGNAL(stateChanged(int)), this, SLOT(updateUI()));
+
+    ui->cbTimestampMode->addItem("Automatic", CanInterface::rx_timestamp_auto);
+    ui->cbTimestampMode->addItem("Hardware", CanInterface::rx_timestamp_hardware);
+    ui->cbTimestampMode->addItem("Kernel Software", CanInterface::rx_timestamp_software);
+    ui->cbTimestampMode->addItem("Legacy", CanInterface::rx_timestamp_legacy);
+    connect(ui->cbTimestampMode, SIGNAL(currentIndexChanged(int)), this, SLOT(updateUI()));
+    connect(ui->leCaptureFilter, SIGNAL(textChanged(QString)), this, SLOT(updateUI()));
+
+    ui->cbRxBufferSize->addItem("System default", 0);
+    ui->cbRxBufferSize->addItem("256 KiB", 256*1024);
+    ui->cbRxBufferSize->addItem("1 MiB", 1024*1024);
+    ui->cbRxBufferSize->addItem("4 MiB", 4*1024*1024);
+    ui->cbRxBufferSize->addItem("16 MiB", 16*1024*1024);
+    connect(ui->cbRxBufferSize, SIGNAL(currentIndexChanged(int)), this, SLOT(updateUI()));
 }
 
 GenericCanSetupPage::~GenericCanSetupPage()
@@ -60,6 +74,19 @@ void GenericCanSetupPage::onShowInterfacePage(SetupDialog &dlg, MeasurementInter
     ui->cbTripleSampling->setChecked(_mi->isTripleSampling());
     ui->cbAutoRestart->setChecked(_mi->doAutoRestart());
 
+    ui->cbTimestampMode->setCurrentIndex(ui->cbTimestampMode->findData(_mi->rxTimestampMode()));
+    updateTimestampModeLabel(intf);
+    ui->leCaptureFilter->setText(_mi->captureFilter().toString());
+    ui->leCaptureFilter->setStyleSheet("");
+
+    int bufIdx = ui->cbRxBufferSize->findData(_mi->rxBufferSize());
+    if (bufIdx < 0) {
+        // size set by hand in the workspace file; keep it selectable
+        ui->cbRxBufferSize->addItem(QString("%1 KiB").arg(_mi->rxBufferSize() / 1024), _mi->rxBufferSize());
+        bufIdx = ui->cbRxBufferSize->count() - 1;
+    }
+    ui->cbRxBufferSize->setCurrentIndex(bufIdx);
+
     disenableUI(_mi->doConfigure());
     dlg.displayPage(this);
 
@@ -76,6 +103,14 @@ void GenericCanSetupPage::updateUI()
         _mi->setOneShotMode(ui->cbOneShot->isChecked());
         _mi->setTripleSampling(ui->cbTripleSampling->isChecked());
         _mi->setAutoRestart(ui->cbAutoRestart->isChecked());
+        _mi->setRxTimestampMode(ui->cbTimestampMode->currentData().toInt());
+
+        CanCaptureFilter filter;
+        bool filterOk = filter.fromString(ui->leCaptureFilter->text());
+        ui->leCaptureFilter->setStyleSheet(filterOk ? "" : "color: red");
+        _mi->setCaptureFilter(filter);
+
+        _mi->setRxBufferSize(ui->cbRxBufferSize->currentData().toUInt());
 
         _mi->setBitrate(ui->cbBitrate->currentData().toUInt());
         _mi->setSamplePoint(ui->cbSamplePoint->currentData().toUInt());
@@ -194,6 +229,21 @@ void GenericCanSetupPage::disenableUI(bool enabled)
     ui->cbOneShot->setEnabled(enabled && (caps & CanInterface::capability_one_shot));
     ui->cbTripleSampling->setEnabled(enabled && (caps & CanInterface::capability_triple_sampling));
     ui->cbAutoRestart->setEnabled(enabled && (caps & CanInterface::capability_auto_restart));
+
+    // socket options, independent of who configures the link
+    ui->cbRxBufferSize->setEnabled(caps & CanInterface::capability_rx_buffer_size);
+}
+
+void GenericCanSetupPage::updateTimestampModeLabel(CanInterface *intf)
+{
+    QString active = intf->getTimestampModeStr();
+    if (!active.isEmpty()) {
+        ui->laTimestampMode->setText("in use: " + active);
+    } else if (intf->getCapabilities() & CanInterface::capability_hw_timestamps) {
+        ui->laTimestampMode->setText("hardware timestamps supported");
+    } else {
+        ui->laTimestampMode->setText("no hardware timestamps");
+    }
 }
 
 Backend &GenericCanSetupPage::backend()
@@ -37,6 +37,7 @@ private:
     void fillFdBitrate(CanInterface *intf, unsigned selectedBitrate);
     void fillSamplePointsForFDBitrate(CanInterface *intf, unsigned selectedFDBitrate, unsigned selectedSamplePoint);
     void disenableUI(bool enabled);
+    void updateTimestampModeLabel(CanInterface *intf);
 
     Backend &backend();
 };
@@ -0,0 +1,122 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SLCANByteRing.h"
+
+SLCANByteRing::SLCANByteRing(uint32_t capacity)
+  : _head(0),
+    _tail(0),
+    _highWater(0)
+{
+    uint32_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    _buf = new char[size];
+    _mask = size - 1;
+}
+
+SLCANByteRing::~SLCANByteRing()
+{
+    delete[] _buf;
+}
+
+uint32_t SLCANByteRing::capacity() const
+{
+    return _mask + 1;
+}
+
+void SLCANByteRing::clear()
+{
+    _tail.storeRelease(_head.loadAcquire());
+    _highWater.storeRelease(0);
+}
+
+uint32_t SLCANByteRing::space() const
+{
+    return capacity() - (_head.loadAcquire() - _tail.loadAcquire());
+}
+
+char *SLCANByteRing::writeSpan(uint32_t *len)
+{
+    uint32_t head = _head.loadAcquire();
+    uint32_t free = capacity() - (head - _tail.loadAcquire());
+    uint32_t to_end = capacity() - (head & _mask);
+    *len = (free < to_end) ? free : to_end;
+    return _buf + (head & _mask);
+}
+
+void SLCANByteRing::commit(uint32_t len)
+{
+    uint32_t head = _head.loadAcquire() + len;
+    _head.storeRelease(head);
+
+    uint32_t fill = head - _tail.loadAcquire();
+    if (fill > _highWater.loadAcquire()) {
+        _highWater.storeRelease(fill);
+    }
+}
+
+uint32_t SLCANByteRing::available() const
+{
+    return _head.loadAcquire() - _tail.loadAcquire();
+}
+
+const char *SLCANByteRing::readSpan(uint32_t *len) const
+{
+    uint32_t tail = _tail.loadAcquire();
+    uint32_t fill = _head.loadAcquire() - tail;
+    uint32_t to_end = capacity() - (tail & _mask);
+    *len = (fill < to_end) ? fill : to_end;
+    return _buf + (tail & _mask);
+}
+
+void SLCANByteRing::consume(uint32_t len)
+{
+    _tail.storeRelease(_tail.loadAcquire() + len);
+}
+
+uint32_t SLCANByteRing::discardOldestLines(uint32_t len)
+{
+    uint32_t tail = _tail.loadAcquire();
+    uint32_t head = _head.loadAcquire();
+    uint32_t free = capacity() - (head - tail);
+    uint32_t pos = tail;
+
+    // stop right after a line end, so the next line is kept whole
+    while ((pos != head) && (free + (pos - tail) < len)) {
+        while (pos != head) {
+            char c = _buf[pos & _mask];
+            pos++;
+            if ((c == '\r') || (c == '\a') || (c == '\n')) {
+                break;
+            }
+        }
+    }
+
+    _tail.storeRelease(pos);
+    return pos - tail;
+}
+
+uint32_t SLCANByteRing::highWaterMark() const
+{
+    return _highWater.loadAcquire();
+}
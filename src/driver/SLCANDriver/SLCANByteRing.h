@@ -0,0 +1,77 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QAtomicInteger>
+
+/*
+ * Single-producer/single-consumer byte ring for received SLCAN data.
+ *
+ * The producer reads from the port straight into writeSpan() and commits
+ * what it got; the consumer parses straight from readSpan() and consumes
+ * what the parser took. The capacity is rounded up to a power of two.
+ *
+ * When the producer needs more room than is free, the oldest complete
+ * lines are dropped with discardOldestLines(). This moves the consumer
+ * index, so it has to be called by the consumer; in SLCANInterface both
+ * sides run in the I/O thread.
+ */
+class SLCANByteRing
+{
+public:
+    explicit SLCANByteRing(uint32_t capacity);
+    ~SLCANByteRing();
+
+    uint32_t capacity() const;
+    void clear();
+
+    // producer side
+    uint32_t space() const;
+    char *writeSpan(uint32_t *len);
+    void commit(uint32_t len);
+
+    // consumer side
+    uint32_t available() const;
+    const char *readSpan(uint32_t *len) const;
+    void consume(uint32_t len);
+
+    // drop whole lines from the read end until at least len bytes are free; returns the bytes dropped
+    uint32_t discardOldestLines(uint32_t len);
+
+    // statistics, safe to read from any thread
+    uint32_t highWaterMark() const;
+
+private:
+    Q_DISABLE_COPY(SLCANByteRing)
+
+    char *_buf;
+    uint32_t _mask;
+
+    // keep producer and consumer indices on separate cache lines
+    QAtomicInteger<uint32_t> _head;
+    char _pad0[64 - sizeof(QAtomicInteger<uint32_t>)];
+    QAtomicInteger<uint32_t> _tail;
+    char _pad1[64 - sizeof(QAtomicInteger<uint32_t>)];
+
+    QAtomicInteger<uint32_t> _highWater;
+};
@@ -0,0 +1,83 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SLCANDeviceClock.h"
+
+#include <math.h>
+
+SLCANDeviceClock::SLCANDeviceClock()
+  : _tick_ns(1000000)
+{
+    reset();
+}
+
+void SLCANDeviceClock::reset()
+{
+    _wrap = 60000;
+    _last_ticks = 0;
+    _last_arrival_ns = 0;
+    _device_ns = 0;
+    _aligner.reset();
+}
+
+void SLCANDeviceClock::setTickNs(uint32_t tick_ns)
+{
+    _tick_ns = tick_ns;
+}
+
+bool SLCANDeviceClock::isRunning() const
+{
+    return _aligner.isRunning();
+}
+
+double SLCANDeviceClock::getDriftPpm() const
+{
+    return _aligner.getDriftPpm();
+}
+
+uint64_t SLCANDeviceClock::unwrap(uint16_t ticks, uint64_t arrival_ns)
+{
+    if (ticks >= _wrap) {
+        _wrap = 0x10000;
+    }
+
+    if (_aligner.isRunning()) {
+        uint32_t delta = (ticks + _wrap - _last_ticks) % _wrap;
+
+        // whole wrap periods that passed without a frame, judged by the host clock
+        double host_ticks = (arrival_ns > _last_arrival_ns) ? (double)(arrival_ns - _last_arrival_ns) / _tick_ns : 0;
+        int64_t wraps = llround((host_ticks - delta) / _wrap);
+        if (wraps < 0) {
+            wraps = 0;
+        }
+
+        _device_ns += ((uint64_t)delta + (uint64_t)wraps * _wrap) * _tick_ns;
+    }
+
+    _last_ticks = ticks;
+    _last_arrival_ns = arrival_ns;
+    return _device_ns;
+}
+
+uint64_t SLCANDeviceClock::toHostNs(uint16_t ticks, uint64_t arrival_ns)
+{
+    return _aligner.toHostNs(unwrap(ticks, arrival_ns), arrival_ns);
+}
@@ -0,0 +1,62 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <core/ClockAligner.h>
+
+/*
+ * Maps the 16 bit timestamps of the SLCAN timestamp extension (Z1, four
+ * hex digits after the data) to the host clock.
+ *
+ * The tick counter is unwrapped with help from the host arrival times, so
+ * pauses longer than a wrap period do not lose whole periods. Lawicel
+ * adapters count milliseconds modulo 60000; a device that reports a larger
+ * value is taken to count the full 16 bits. The unwrapped device time is
+ * aligned to the arrival times by a ClockAligner.
+ */
+class SLCANDeviceClock
+{
+public:
+    SLCANDeviceClock();
+
+    void reset();
+    void setTickNs(uint32_t tick_ns);
+
+    // host time of a frame the device stamped with ticks, whose bytes arrived at arrival_ns
+    uint64_t toHostNs(uint16_t ticks, uint64_t arrival_ns);
+
+    bool isRunning() const;
+    double getDriftPpm() const;
+
+private:
+    uint32_t _tick_ns;
+    uint32_t _wrap;
+
+    uint16_t _last_ticks;
+    uint64_t _last_arrival_ns;
+    uint64_t _device_ns;
+
+    ClockAligner _aligner;
+
+    uint64_t unwrap(uint16_t ticks, uint64_t arrival_ns);
+};
@@ -22,8 +22,11 @@
 
 #include "SLCANDriver.h"
 #include "SLCANInterface.h"
+#include "SLCANSimulator.h"
 #include <core/Backend.h>
+#if !defined(CANGAROO_HEADLESS)
 #include <driver/GenericCanSetupPage.h>
+#endif
 
 #include <errno.h>
 #include <cstring>
@@ -41,12 +44,42 @@ int hpmicro_can = 0;
 
 SLCANDriver::SLCANDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(0)
 {
+#if !defined(CANGAROO_HEADLESS)
+    setupPage = new GenericCanSetupPage();
     QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
+#endif
+    startSimulators();
 }
 
 SLCANDriver::~SLCANDriver() {
+    foreach (SLCANSimulator *sim, _simulators) {
+        delete sim;
+    }
+}
+
+void SLCANDriver::startSimulators()
+{
+    // CANGAROO_SLCAN_SIM="pattern=mixed,rate=20000;pattern=classic,rate=1000" adds one simulated adapter per entry
+    QString specs = QString::fromLocal8Bit(qgetenv("CANGAROO_SLCAN_SIM"));
+    foreach (const QString &spec, specs.split(';', QString::SkipEmptyParts)) {
+        SLCANSimulator::config_t config;
+        config.channel = _simulators.size();
+        config.pattern = SLCANSimulator::pattern_classic;
+        config.rate = 1000;
+        if (!SLCANSimulator::parseConfig(spec, config)) {
+            log_error(QString("invalid SLCAN simulator setting: %1").arg(spec));
+            continue;
+        }
+
+        SLCANSimulator *sim = new SLCANSimulator(config);
+        if (!sim->startSimulation()) {
+            delete sim;
+            break;
+        }
+        _simulators.append(sim);
+    }
 }
 
 bool SLCANDriver::update() {
@@ -131,6 +164,13 @@ bool SLCANDriver::update() {
         serial.close();
      }
     }
+
+    // pseudo-terminals are not listed as serial ports, the simulators are added explicitly
+    foreach (SLCANSimulator *sim, _simulators) {
+        SLCANInterface *intf = createOrUpdateInterface(interface_cnt, sim->getPortName(), sim->getDescription(), true);
+        intf->setSimulator(sim);
+        interface_cnt++;
+    }
     return true;
 }
 
@@ -22,10 +22,12 @@
 #pragma once
 
 #include <QString>
+#include <QList>
 #include <core/Backend.h>
 #include <driver/CanDriver.h>
 
 class SLCANInterface;
+class SLCANSimulator;
 class SetupDialogInterfacePage;
 class GenericCanSetupPage;
 
@@ -40,4 +42,7 @@ public:
 private:
     SLCANInterface *createOrUpdateInterface(int index, QString name,QString description, bool fd_support);
     GenericCanSetupPage *setupPage;
+    QList<SLCANSimulator*> _simulators;
+
+    void startSimulators();
 };
@@ -2,10 +2,18 @@ CONFIG += c++11
 
 SOURCES += \
     $$PWD/SLCANInterface.cpp \
+    $$PWD/SLCANParser.cpp \
+    $$PWD/SLCANDeviceClock.cpp \
+    $$PWD/SLCANByteRing.cpp \
+    $$PWD/SLCANSimulator.cpp \
     $$PWD/SLCANDriver.cpp
 
 HEADERS  += \
     $$PWD/SLCANInterface.h \
+    $$PWD/SLCANParser.h \
+    $$PWD/SLCANDeviceClock.h \
+    $$PWD/SLCANByteRing.h \
+    $$PWD/SLCANSimulator.h \
     $$PWD/SLCANDriver.h
 
 FORMS +=
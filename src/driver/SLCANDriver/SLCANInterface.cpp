@@ -20,12 +20,16 @@
 */
 
 #include "SLCANInterface.h"
+#include "SLCANSimulator.h"
 
 #include <core/Backend.h>
 #include <core/MeasurementInterface.h>
 #include <core/CanMessage.h>
+#include <core/HostClock.h>
+#include <driver/CanMessageBatch.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <fcntl.h>
@@ -35,22 +39,39 @@
 #include <QProcess>
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
-#include <QThread>
 #include <QRegularExpression>
 
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#endif
+
 SLCANInterface::SLCANInterface(SLCANDriver *driver, int index, QString name, QString description, bool fd_support)
   : CanInterface((CanDriver *)driver),
 	_idx(index),
     _isOpen(false),
     _serport(NULL),
-    _msg_queue(),
+    _tx_queue_frames(0),
+    _tx_flow_state(tx_flow_ok),
+    _config_next_tag(1),
+    _config_in_flight(false),
+#if defined(__linux__)
+    _tx_wakeup_fd(-1),
+    _last_rx_wake_ns(0),
+#endif
     _name(name),
     _description(description),
-    _rx_linbuf_ctr(0),
-    _rxbuf_head(0),
-    _rxbuf_tail(0),
-    _ts_mode(ts_mode_SIOCSHWTSTAMP)
+    _rxring(rx_ring_size),
+    _simulator(0),
+    _rx_arrival_us(0),
+    _rx_timestamp_mode(CanInterface::rx_timestamp_auto)
 {
+    memset(&_status, 0, sizeof(_status));
+
+    // both halves keep their capacity across swaps, sendMessage() never allocates
+    _tx_queue.reserve(tx_queue_size);
+    _tx_out.reserve(tx_queue_size);
+
     // Set defaults
     _settings.setBitrate(500000);
     _settings.setSamplePoint(875);
@@ -115,6 +136,7 @@ void SLCANInterface::applyConfig(const MeasurementInterface &mi)
 {
     // Save settings for port configuration
     _settings = mi;
+    _rx_timestamp_mode = mi.rxTimestampMode();
 }
 
 bool SLCANInterface::updateStatus()
@@ -175,6 +197,9 @@ uint32_t SLCANInterface::getCapabilities()
     if (supportsTripleSampling()) {
         retval |= CanInterface::capability_triple_sampling;
     }
+
+    // the timestamp extension (Z1) stamps frames on the device
+    retval |= CanInterface::capability_hw_timestamps;
     return retval;
 }
 
@@ -221,40 +246,89 @@ int SLCANInterface::getNumTxDropped()
     return _status.tx_dropped;
 }
 
+int SLCANInterface::getTxFlowState()
+{
+    QMutexLocker locker(&_tx_queue_mutex);
+    return _tx_flow_state;
+}
+
+int SLCANInterface::getTxQueueDepth()
+{
+    QMutexLocker locker(&_tx_queue_mutex);
+    return _tx_queue_frames;
+}
+
+QString SLCANInterface::getTimestampModeStr()
+{
+    if (_clock.isRunning()) {
+        return QString("device timestamps, drift %1 ppm to host clock").arg(_clock.getDriftPpm(), 0, 'f', 1);
+    } else {
+        return "host clock at arrival";
+    }
+}
+
+QString SLCANInterface::getStatusDetailsStr()
+{
+    QString details = QString("rx ring %1/%2 bytes peak, %3 bytes discarded")
+        .arg(_rxring.highWaterMark())
+        .arg(_rxring.capacity())
+        .arg((unsigned long long)_status.rx_discarded);
+    if (_simulator) {
+        details += "; " + _simulator->getStatsStr();
+    }
+    return details;
+}
+
 int SLCANInterface::getIfIndex() {
     return _idx;
 }
 
+void SLCANInterface::setSimulator(SLCANSimulator *simulator)
+{
+    _simulator = simulator;
+}
+
 bool SLCANInterface::get_enable_terminal_res()
 {
-    char data[256];
-    int len;
-    QByteArray readData;
     if (_serport == nullptr) {
         return false;
     }
-    _serport_mutex.lock();
-    len = sprintf(data, "hpm_cfg_g_120r"); 
-   _hpm_msg_queue.append(QString(data));
-    _serport_mutex.unlock();
+
+    // the answer arrives later, through _hpm_request_msg
+    queueConfigCommand("hpm_cfg_g_120r", "hpm_cfg_g_120r_", [this](bool ok, const QByteArray &reply) {
+        if (ok) {
+            emit _hpm_request_msg(reply);
+        } else {
+            log_warning(QString("%1: no reply to terminal resistor query").arg(getName()));
+        }
+    });
     return false;
 }
 
 void SLCANInterface::set_enable_terminal_res(bool enable)
 {
-    char data[256];
-    int len;
     if (_serport == nullptr) {
         return;
     }
-    _serport_mutex.lock();
-    if (enable== true) {
-        len = sprintf(data, "hpm_cfg_s_120r_1");
-    } else {
-        len = sprintf(data, "hpm_cfg_s_120r_0");
-    }
-    _hpm_msg_queue.append(QString(data));
-    _serport_mutex.unlock();
+    queueConfigCommand(enable ? "hpm_cfg_s_120r_1" : "hpm_cfg_s_120r_0", QByteArray(), ConfigCallback());
+}
+
+uint32_t SLCANInterface::queueConfigCommand(const QByteArray &command, const QByteArray &reply_prefix,
+                                            const ConfigCallback &done, unsigned timeout_ms)
+{
+    config_request_t req;
+    req.command = command;
+    req.reply_prefix = reply_prefix;
+    req.timeout_ms = timeout_ms;
+    req.done = done;
+
+    _tx_queue_mutex.lock();
+    req.tag = _config_next_tag++;
+    _config_queue.append(req);
+    _tx_queue_mutex.unlock();
+
+    wakeIoThread();
+    return req.tag;
 }
 
 void SLCANInterface::open()
@@ -399,11 +473,32 @@ void SLCANInterface::open()
     _serport->waitForBytesWritten(300);
 
 
+    // Device timestamps are taken when the frame was on the bus, not when USB delivered it.
+    // Adapters without the extension answer with BEL and keep sending plain lines.
+    bool device_timestamps = (_rx_timestamp_mode == rx_timestamp_auto) || (_rx_timestamp_mode == rx_timestamp_hardware);
+    _serport->write(device_timestamps ? "Z1\r" : "Z0\r", 3);
+    _serport->flush();
+    _serport->waitForBytesWritten(300);
+
     // Open the port
     _serport->write("O\r", 3);
     _serport->flush();
     _serport->waitForBytesWritten(150);
 
+#if defined(__linux__)
+    _tx_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+
+    _rxring.clear();
+    _parser.reset();
+    _parser.setInterfaceId(getId());
+    _parser.setReplyHandler([this](const char *line, int len) { onDeviceReply(line, len); });
+
+    // Z1 ticks are milliseconds
+    _clock.reset();
+    _clock.setTickNs(1000000);
+    _parser.setDeviceClock(device_timestamps ? &_clock : 0);
+
     _isOpen = true;
 
      //Release port mutex
@@ -424,6 +519,31 @@ void SLCANInterface::close()
         _serport->close();
     }
 
+    // frames not yet written are lost with the port, commands fail
+    _tx_queue_mutex.lock();
+    _tx_queue.resize(0);
+    _tx_queue_frames = 0;
+    _tx_flow_state = tx_flow_ok;
+    QList<config_request_t> config_queue;
+    config_queue.swap(_config_queue);
+    _tx_queue_mutex.unlock();
+
+    if (_config_in_flight) {
+        finishConfigCommand(false, QByteArray());
+    }
+    foreach (const config_request_t &req, config_queue) {
+        if (req.done) {
+            req.done(false, QByteArray());
+        }
+    }
+
+#if defined(__linux__)
+    if (_tx_wakeup_fd >= 0) {
+        ::close(_tx_wakeup_fd);
+        _tx_wakeup_fd = -1;
+    }
+#endif
+
     _isOpen = false;
     _serport_mutex.unlock();
 }
@@ -552,326 +672,279 @@ void SLCANInterface::sendMessage(const CanMessage &msg) {
     // Add CR for slcan EOL
     buf[msg_idx++] = '\r';
 
-    // Ensure null termination
-    buf[msg_idx] = '\0';
+    // Queue for the I/O thread; when it cannot keep up the frame is dropped, not waited for
+    _tx_queue_mutex.lock();
+    if ((_tx_queue.size() + msg_idx) > tx_queue_size) {
+        _status.tx_dropped++;
+        _tx_queue_mutex.unlock();
+        return;
+    }
+    _tx_queue.append(buf, msg_idx);
+    _tx_queue_frames++;
+    updateTxFlowState();
+    _tx_queue_mutex.unlock();
+    wakeIoThread();
 
-    _msg_queue.append(QString(buf));
-    struct timeval tv;
-    gettimeofday(&tv, nullptr); // 获取当前时间
-    msgCopy.setTimestamp(tv);
+    msgCopy.setTimestampNs(HostClock::nowNs());
+    msgCopy.setTimestampSource(CanMessage::timestamp_source_host);
     Backend::instance().addSentMessage(msgCopy);
 }
 
-bool SLCANInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms)
+bool SLCANInterface::hasQueuedMessages()
 {
-    // Don't saturate the thread. Read the buffer every 1ms.
-    QThread().msleep(1);
-
-    // Transmit all items that are queued
-    while(!_msg_queue.empty())
-    {
-        // Consume first item
-        QString tmp = _msg_queue.front();
-        _msg_queue.pop_front();
+    QMutexLocker locker(&_tx_queue_mutex);
+    return !_tx_queue.isEmpty() || (!_config_queue.isEmpty() && !_config_in_flight);
+}
 
-        _serport_mutex.lock();
-        // Write string to serial device
-        _serport->write(tmp.toStdString().c_str(), tmp.length());
-        _serport->flush();
-        _serport->waitForBytesWritten(300);
-        _serport_mutex.unlock();
-    }
-    if (!_hpm_msg_queue.isEmpty()) {
-        QString tmp = _hpm_msg_queue.front();
-        _hpm_msg_queue.pop_front();
-        _serport_mutex.lock();
-        // Write string to serial device
-        _serport->write(tmp.toStdString().c_str(), tmp.length());
-        _serport->flush();
-        _serport->waitForBytesWritten(300);
-        _serport_mutex.unlock();
-        QThread().msleep(100);
-       _serport->waitForReadyRead(1);
-       if(_serport->bytesAvailable()) {
-           QByteArray readdata = _serport->readAll();
-            _rxbuf_mutex.lock();
-            emit _hpm_request_msg(readdata);
-            _rxbuf_mutex.unlock();
-       }
+void SLCANInterface::updateTxFlowState()
+{
+    // called with _tx_queue_mutex held; throttled until the queue is well below the high watermark
+    int fill = _tx_queue.size();
+    if ((fill + SLCAN_MTU) > tx_queue_size) {
+        _tx_flow_state = tx_flow_full;
+    } else if (fill >= tx_queue_high) {
+        _tx_flow_state = tx_flow_throttled;
+    } else if (fill <= tx_queue_low) {
+        _tx_flow_state = tx_flow_ok;
+    } else if (_tx_flow_state == tx_flow_full) {
+        _tx_flow_state = tx_flow_throttled;
     }
-    // RX doesn't work on windows unless we call this for some reason
-    _serport->waitForReadyRead(1);
-    if(_serport->bytesAvailable())
-    {
-        // This is called when readyRead() is emitted
-        QByteArray datas = _serport->readAll();
-        _rxbuf_mutex.lock();
-        for(int i=0; i<datas.count(); i++)
-        {
-            // If incrementing the head will hit the tail, we've filled the buffer. Reset and discard all data.
-            if(((_rxbuf_head + 1) % RXCIRBUF_LEN) == _rxbuf_tail)
-            {
-                _rxbuf_head = 0;
-                _rxbuf_tail = 0;
-            }
-            else
-            {
-                // Put inbound data at the head locatoin
-                _rxbuf[_rxbuf_head] = datas.at(i);
-                _rxbuf_head = (_rxbuf_head + 1) % RXCIRBUF_LEN; // Wrap at MTU
-            }
+}
+
+void SLCANInterface::wakeIoThread()
+{
+#if defined(__linux__)
+    uint64_t one = 1;
+    if (_tx_wakeup_fd >= 0) {
+        if (::write(_tx_wakeup_fd, &one, sizeof(one)) < 0) {
+            // counter saturated, the I/O thread is awake anyway
         }
-        _rxbuf_mutex.unlock();
     }
+#endif
+}
 
+void SLCANInterface::waitForIo(unsigned int timeout_ms)
+{
+    // queued frames only count while the port can take them, otherwise this would spin
+    bool port_backlogged = (_serport->bytesToWrite() >= tx_port_backlog);
+    if (_serport->bytesAvailable() || (hasQueuedMessages() && !port_backlogged)) {
+        return;
+    }
 
+#if defined(__linux__)
+    // sleep until the adapter sends something, a frame is queued for it,
+    // or the port can take more of what is still pending
+    struct pollfd fds[2];
+    fds[0].fd = _serport->handle();
+    fds[0].events = POLLIN | (_serport->bytesToWrite() ? POLLOUT : 0);
+    fds[1].fd = _tx_wakeup_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    int nfds = (_tx_wakeup_fd >= 0) ? 2 : 1;
+    if (poll(fds, nfds, timeout_ms) <= 0) {
+        return;
+    }
 
-    //////////////////////////
-
-    bool ret = false;
-    int count =0;
-    _rxbuf_mutex.lock();
-    while(_rxbuf_tail != _rxbuf_head)
-    {
-        // Save data if room
-        if(_rx_linbuf_ctr < SLCAN_MTU)
-        {
-            _rx_linbuf[_rx_linbuf_ctr++] = _rxbuf[_rxbuf_tail];
-
-            // If we have a newline, then we just finished parsing a CAN message.
-            if(_rxbuf[_rxbuf_tail] == '\r')
-            {
-                CanMessage msg;
-                ret = parseMessage(msg);
-                struct timeval tv;
-                gettimeofday(&tv, nullptr); // 获取当前时间
-                msg.setTimestamp(tv);
-                msg.setDirection(CanMessage::Rx);
-                msglist.append(msg);
-                msglist.replace(count, msg);
-                count++;
-                _rx_linbuf_ctr = 0;
-            }
-        }
-        // Discard data if not
-        else
-        {
-            perror("Linbuf full");
-            _rx_linbuf_ctr = 0;
+    if (!(fds[1].revents & POLLIN) && (fds[0].revents & POLLIN)) {
+        // the adapter writes each frame on its own, so at high bus load every wakeup
+        // would find a single frame. Once wakeups come faster than every half interval,
+        // let input gather for the rest of it; queued frames still end the wait.
+        uint64_t since_ns = HostClock::nowNs() - _last_rx_wake_ns;
+        if (since_ns < rx_coalesce_us * 500ULL) {
+            struct timespec rest;
+            rest.tv_sec = 0;
+            rest.tv_nsec = rx_coalesce_us * 1000L - (long)since_ns;
+            fds[1].revents = 0;
+            ppoll(&fds[1], nfds - 1, &rest, NULL);
         }
-
-        _rxbuf_tail = (_rxbuf_tail + 1) % RXCIRBUF_LEN;
+        _last_rx_wake_ns = HostClock::nowNs();
     }
-    _rxbuf_mutex.unlock();
 
-    return ret;
+    if (fds[1].revents & POLLIN) {
+        uint64_t count;
+        if (::read(_tx_wakeup_fd, &count, sizeof(count)) < 0) {
+            // already reset
+        }
+    }
+#else
+    // the port cannot be waited on together with the tx queue, so bound the wait
+    _serport->waitForReadyRead((timeout_ms < max_tx_latency_ms) ? timeout_ms : max_tx_latency_ms);
+#endif
 }
 
-bool SLCANInterface::parseMessage(CanMessage &msg)
+void SLCANInterface::transmitQueued()
 {
-    // Set timestamp to current time
-    struct timeval tv;
-    gettimeofday(&tv,NULL);
-    msg.setTimestamp(tv);
+    QMutexLocker locker(&_serport_mutex);
 
-    // Defaults
-    msg.setErrorFrame(0);
-    msg.setInterfaceId(getId());
-    msg.setId(0);
-
-    bool msg_is_fd = false;
-
-    // Convert from ASCII (2nd character to end)
-    for (int i = 1; i < _rx_linbuf_ctr; i++)
-    {
-        // Lowercase letters
-        if(_rx_linbuf[i] >= 'a')
-            _rx_linbuf[i] = _rx_linbuf[i] - 'a' + 10;
-        // Uppercase letters
-        else if(_rx_linbuf[i] >= 'A')
-            _rx_linbuf[i] = _rx_linbuf[i] - 'A' + 10;
-        // Numbers
-        else
-            _rx_linbuf[i] = _rx_linbuf[i] - '0';
+    // flush() writes what the OS takes without blocking; the rest stays in QSerialPort
+    if (_serport->bytesToWrite()) {
+        _serport->flush();
+    }
+    if (_serport->bytesToWrite() >= tx_port_backlog) {
+        return;
     }
 
+    // take everything queued since the last cycle, senders continue in the other buffer
+    _tx_queue_mutex.lock();
+    _tx_out.swap(_tx_queue);
+    int frames = _tx_queue_frames;
+    _tx_queue_frames = 0;
+    updateTxFlowState();
+    _tx_queue_mutex.unlock();
 
-    // Handle each incoming command
-    switch(_rx_linbuf[0])
-    {
-
-        // Transmit data frame command
-        case 'T':
-            msg.setFD(false);
-            msg.setExtended(true);
-            break;
-        case 't':
-            msg.setFD(false);
-            msg.setExtended(false);
-            break;
-
-        // Transmit remote frame command
-        case 'r':
-            msg.setFD(false);
-            msg.setExtended(false);
-            msg.setRTR(true);
-            break;
-        case 'R':
-            msg.setFD(false);
-            msg.setExtended(true);
-            msg.setRTR(true);
-            break;
-
-        // CANFD transmit - no BRS
-        case 'd':
-            msg.setFD(1);
-            msg.setExtended(false);
-            msg.setBRS(false);
-            msg_is_fd = true;
-            break;
-        case 'D':
-            msg.setFD(true);
-            msg.setExtended(true);
-            msg.setBRS(false);
-            msg_is_fd = true;
-            break;
-
-        // CANFD transmit - with BRS
-        case 'b':
-            msg.setFD(true);
-            msg.setExtended(false);
-            msg.setBRS(true);
-            msg_is_fd = true;
-            break;
-        case 'B':
-            msg.setFD(true);
-            msg.setExtended(true);
-            msg.setBRS(true);
-            msg_is_fd = true;
-            break;
-
-
-
-        // Invalid command
-        default:
-            return false;
+    if (!_tx_out.isEmpty()) {
+        // all frames of this cycle in one write
+        if (_serport->write(_tx_out) == _tx_out.size()) {
+            _status.tx_count += frames;
+        } else {
+            _status.tx_errors += frames;
+        }
+        _serport->flush();
+        _tx_out.resize(0);
     }
+}
 
-    // Start parsing at second byte (skip command byte)
-    uint8_t parse_loc = 1;
+unsigned SLCANInterface::configWaitMs(unsigned timeout_ms)
+{
+    // wake up in time to fail a command the device does not answer
+    if (_config_in_flight) {
+        qint64 left = _config_pending.timeout_ms - _config_timer.elapsed();
+        if (left < 0) {
+            return 0;
+        }
+        if (left < timeout_ms) {
+            return left;
+        }
+    }
+    return timeout_ms;
+}
 
-    // Default to standard id len
-    uint8_t id_len = SLCAN_STD_ID_LEN;
+void SLCANInterface::serviceConfigCommands()
+{
+    if (_config_in_flight && _config_timer.hasExpired(_config_pending.timeout_ms)) {
+        finishConfigCommand(false, QByteArray());
+    }
+    if (_config_in_flight) {
+        return;
+    }
 
-    // Update length if message is extended ID
-    if(msg.isExtended())
-        id_len = SLCAN_EXT_ID_LEN;
+    // replies carry no tag, so commands go out one after the other and are matched in order
+    _tx_queue_mutex.lock();
+    if (_config_queue.isEmpty()) {
+        _tx_queue_mutex.unlock();
+        return;
+    }
+    _config_pending = _config_queue.takeFirst();
+    _tx_queue_mutex.unlock();
 
-    uint32_t id_tmp = 0;
+    _serport_mutex.lock();
+    bool written = (_serport->write(_config_pending.command) == _config_pending.command.size());
+    _serport->flush();
+    _serport_mutex.unlock();
 
-    // Iterate through ID bytes
-    while(parse_loc <= id_len)
-    {
-        id_tmp *= 16;
-        id_tmp += _rx_linbuf[parse_loc++];
+    _config_in_flight = true;
+    if (!written || _config_pending.reply_prefix.isEmpty()) {
+        finishConfigCommand(written, QByteArray());
+    } else {
+        _config_timer.start();
     }
+}
 
+void SLCANInterface::finishConfigCommand(bool ok, const QByteArray &reply)
+{
+    // clear first, the callback may queue the next command
+    config_request_t req = _config_pending;
+    _config_pending = config_request_t();
+    _config_in_flight = false;
 
-    msg.setId(id_tmp);
+    if (req.done) {
+        req.done(ok, reply);
+    }
+}
 
-    // Attempt to parse DLC and check sanity
-    uint8_t dlc_code_raw = _rx_linbuf[parse_loc++];
+void SLCANInterface::onDeviceReply(const char *line, int len)
+{
+    const QByteArray &prefix = _config_pending.reply_prefix;
+    if (_config_in_flight && !prefix.isEmpty() && (len >= prefix.size())
+     && (memcmp(line, prefix.constData(), prefix.size()) == 0)) {
+        finishConfigCommand(true, QByteArray(line, len));
+    }
+}
 
-    // If dlc is too long for an FD frame
-    if(msg_is_fd && dlc_code_raw > 0xF)
-    {
-        return false;
+void SLCANInterface::readSerial()
+{
+    // QSerialPort has no event loop in this thread; let it pull in what poll() reported.
+    // RX doesn't work on windows unless we call this for some reason
+    _serport->waitForReadyRead(0);
+    qint64 pending = _serport->bytesAvailable();
+    if (pending <= 0) {
+        return;
     }
-    if(!msg_is_fd && dlc_code_raw > 0x8)
-    {
-        return false;
+
+    // Make room by dropping the oldest complete lines; the parser then restarts at a line boundary.
+    uint32_t needed = (pending < _rxring.capacity()) ? pending : _rxring.capacity();
+    if (needed > _rxring.space()) {
+        _status.rx_overruns++;
+        _status.rx_discarded += _rxring.discardOldestLines(needed);
+        _parser.discardLine();
     }
 
-    if(dlc_code_raw > 0x8)
-    {
-        switch(dlc_code_raw)
-        {
-        case 0x9:
-            dlc_code_raw = 12;
+    // read straight into the ring, in at most two pieces when it wraps
+    while (pending > 0) {
+        uint32_t len;
+        char *dst = _rxring.writeSpan(&len);
+        if (len == 0) {
             break;
-        case 0xA:
-            dlc_code_raw = 16;
-            break;
-        case 0xB:
-            dlc_code_raw = 20;
-            break;
-        case 0xC:
-            dlc_code_raw = 24;
-            break;
-        case 0xD:
-            dlc_code_raw = 32;
-            break;
-        case 0xE:
-            dlc_code_raw = 48;
-            break;
-        case 0xF:
-            dlc_code_raw = 64;
-            break;
-        default:
-            dlc_code_raw = 0;
-            perror("Invalid length");
+        }
+        qint64 got = _serport->read(dst, (pending < len) ? pending : len);
+        if (got <= 0) {
             break;
         }
+        _rxring.commit(got);
+        pending -= got;
     }
 
-    msg.setLength(dlc_code_raw);
-
-    // Calculate number of bytes we expect in the message
-    int8_t bytes_in_msg = dlc_code_raw;
-
-    if(bytes_in_msg < 0) {
-        perror("Invalid length < 0");
-        return false;
-    }
-    if(bytes_in_msg > 64) {
-        perror("Invalid length > 64");
-        return false;
-    }
+    // Timestamp with the arrival of the bytes, not with the time of parsing
+    uint64_t now = HostClock::nowNs();
+    _parser.setTimestampNs(now);
+    _rx_arrival_us = now / 1000;
+}
 
-    // Parse data
-    // TODO: Guard against walking off the end of the string!
-    for (uint8_t i = 0; i < bytes_in_msg; i++)
-    {
-        msg.setByte(i,  (_rx_linbuf[parse_loc] << 4) + _rx_linbuf[parse_loc+1]);
-        parse_loc += 2;
+bool SLCANInterface::readMessages(CanMessageBatch &batch, unsigned int timeout_ms)
+{
+    // Block until bytes arrive or frames are queued for transmission. Lines left over
+    // from a full batch are parsed right away.
+    if (!_rxring.available()) {
+        waitForIo(configWaitMs(timeout_ms));
     }
 
-    // Reset buffer
-    _rx_linbuf_ctr = 0;
-    _rx_linbuf[0] = '\0';
-    return true;
+    transmitQueued();
 
+    serviceConfigCommands();
 
-/*
+    // drain the port even while batches are full, so it is the ring that overflows, visibly,
+    // and not the buffers of the serial driver
+    readSerial();
 
-    // FIXME
-    if (_ts_mode == ts_mode_SIOCSHWTSTAMP) {
-        // TODO implement me
-        _ts_mode = ts_mode_SIOCGSTAMPNS;
+    // Stop once the batch is full; the rest stays in the ring for the next call
+    int start = batch.size();
+    while (!batch.isFull()) {
+        uint32_t len;
+        const char *span = _rxring.readSpan(&len);
+        if (len == 0) {
+            break;
+        }
+        _rxring.consume(_parser.parse(span, len, batch));
     }
 
-    if (_ts_mode==ts_mode_SIOCGSTAMPNS) {
-        if (ioctl(_fd, SIOCGSTAMPNS, &ts_rcv) == 0) {
-            msg.setTimestamp(ts_rcv.tv_sec, ts_rcv.tv_nsec/1000);
-        } else {
-            _ts_mode = ts_mode_SIOCGSTAMP;
+    if (_simulator) {
+        for (int i = start; i < batch.size(); i++) {
+            _simulator->checkFrame(batch.at(i), _rx_arrival_us);
         }
     }
 
-    if (_ts_mode==ts_mode_SIOCGSTAMP) {
-        ioctl(_fd, SIOCGSTAMP, &tv_rcv);
-        msg.setTimestamp(tv_rcv.tv_sec, tv_rcv.tv_usec);
-    }*/
-
+    _status.rx_count = _parser.numFrames();
+    _status.rx_errors = _parser.numErrors();
 
+    return batch.size() > start;
 }
@@ -22,19 +22,25 @@
 #pragma once
 
 #include "../CanInterface.h"
+#include "SLCANParser.h"
+#include "SLCANDeviceClock.h"
+#include "SLCANByteRing.h"
 #include <core/MeasurementInterface.h>
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
 #include <QMutex>
+#include <QByteArray>
+#include <QList>
+#include <QElapsedTimer>
+#include <functional>
 
 // Maximum rx buffer len
 #define SLCAN_MTU 138 + 1 + 16 // canfd 64 frame plus \r plus some padding
 #define SLCAN_STD_ID_LEN 3
 #define SLCAN_EXT_ID_LEN 8
 
-#define RXCIRBUF_LEN 8192 // Buffer for received serial data, serviced at 1ms intervals
-
 class SLCANDriver;
+class SLCANSimulator;
 
 typedef struct {
     bool supports_canfd;
@@ -52,6 +58,7 @@ typedef struct {
     uint64_t rx_count;
     int rx_errors;
     uint64_t rx_overruns;
+    uint64_t rx_discarded; // bytes dropped from the receive ring on overruns
 
     uint64_t tx_count;
     int tx_errors;
@@ -60,6 +67,9 @@ typedef struct {
 
 class SLCANInterface: public CanInterface {
 public:
+    // ok is false if the device did not reply in time or the port was closed; called from the I/O thread
+    typedef std::function<void(bool ok, const QByteArray &reply)> ConfigCallback;
+
     SLCANInterface(SLCANDriver *driver, int index, QString name, QString description,bool fd_support);
     virtual ~SLCANInterface();
 
@@ -88,7 +98,7 @@ public:
     virtual bool isOpen();
 
     virtual void sendMessage(const CanMessage &msg);
-    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms);
+    virtual bool readMessages(CanMessageBatch &batch, unsigned int timeout_ms);
 
     virtual bool updateStatistics();
     virtual uint32_t getState();
@@ -99,44 +109,90 @@ public:
     virtual int getNumTxFrames();
     virtual int getNumTxErrors();
     virtual int getNumTxDropped();
+    virtual int getTxFlowState();
+    virtual int getTxQueueDepth();
 
     virtual bool get_enable_terminal_res(void);
     virtual void set_enable_terminal_res(bool enable);
 
+    // Send a configuration command to the device next to the CAN traffic and return its tag.
+    // The reply is the first line starting with reply_prefix; with an empty prefix none is
+    // expected and done is called once the command is written. One command is in flight at a time.
+    uint32_t queueConfigCommand(const QByteArray &command, const QByteArray &reply_prefix,
+                                const ConfigCallback &done, unsigned timeout_ms=config_timeout_ms);
+
     int getIfIndex();
 
-private:
-    typedef enum {
-        ts_mode_SIOCSHWTSTAMP,
-        ts_mode_SIOCGSTAMPNS,
-        ts_mode_SIOCGSTAMP
-    } ts_mode_t;
+    // check received frames against the simulator serving this port; 0 for real adapters
+    void setSimulator(SLCANSimulator *simulator);
+
+    virtual QString getTimestampModeStr();
+    virtual QString getStatusDetailsStr();
 
+private:
     int _idx;
     bool _isOpen;
     QSerialPort* _serport;
-    QStringList _msg_queue;
-    QStringList _hpm_msg_queue;
+    QByteArray _tx_queue;  // encoded frames for the I/O thread; preallocated, appended to by sendMessage()
+    QByteArray _tx_out;    // swapped with _tx_queue once per I/O cycle and written in one go
+    int _tx_queue_frames;
+    int _tx_flow_state;
+    QMutex _tx_queue_mutex;
+
+    typedef struct {
+        uint32_t tag;
+        QByteArray command;
+        QByteArray reply_prefix; // empty if the command has no reply
+        unsigned timeout_ms;
+        ConfigCallback done;
+    } config_request_t;
+
+    QList<config_request_t> _config_queue; // guarded by _tx_queue_mutex
+    uint32_t _config_next_tag;
+    config_request_t _config_pending;      // I/O thread only
+    bool _config_in_flight;
+    QElapsedTimer _config_timer;
     QMutex _serport_mutex;
+#if defined(__linux__)
+    int _tx_wakeup_fd; // eventfd, wakes the I/O thread out of poll() when frames are queued
+    uint64_t _last_rx_wake_ns; // HostClock time the port last woke the I/O thread
+#endif
     QString _name;
     QString _description;
 
-    char _rx_linbuf[SLCAN_MTU];
-    int _rx_linbuf_ctr;
-
-    char _rxbuf[RXCIRBUF_LEN];
-    uint32_t _rxbuf_head;
-    uint32_t _rxbuf_tail;
-
-    QMutex _rxbuf_mutex;
+    SLCANParser _parser;
+    SLCANByteRing _rxring; // read from the port straight into it, parsed in place
+    SLCANDeviceClock _clock;
+    SLCANSimulator *_simulator;
+    uint64_t _rx_arrival_us;
+    int _rx_timestamp_mode;
     MeasurementInterface _settings;
 
     can_config_t _config;
     can_status_t _status;
-    ts_mode_t _ts_mode;
+
+    enum {
+        max_tx_latency_ms = 5, // without poll(), how long queued frames may wait for a blocked reader
+        rx_coalesce_us = 1000, // under heavy input, wake for the port at most this often
+        tx_queue_size = 16384, // bytes, about 120 frames at full FD length or 700 classic frames
+        tx_queue_high = 12288, // throttle senders above this fill level ...
+        tx_queue_low = 4096,   // ... until it drained below this one
+        tx_port_backlog = 4096, // bytes the serial port may have pending before the queue is held back
+        rx_ring_size = 65536,   // about 0.6 s of input at 1 Mbaud
+        config_timeout_ms = 500
+    };
 
     bool updateStatus();
-    bool parseMessage(CanMessage &msg);
+    bool hasQueuedMessages();
+    void wakeIoThread();
+    void waitForIo(unsigned int timeout_ms);
+    void transmitQueued();
+    void serviceConfigCommands();
+    void finishConfigCommand(bool ok, const QByteArray &reply);
+    void onDeviceReply(const char *line, int len);
+    unsigned configWaitMs(unsigned timeout_ms);
+    void updateTxFlowState();
+    void readSerial();
 
 
 };
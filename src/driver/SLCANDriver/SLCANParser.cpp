@@ -0,0 +1,322 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SLCANParser.h"
+#include "SLCANDeviceClock.h"
+
+#include <string.h>
+#include <core/CanMessage.h>
+#include <driver/CanMessageBatch.h>
+
+// value of an ASCII hex digit, -1 for anything else
+const int8_t SLCANParser::hex_table[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+// type_* flags of the frame commands t, T, r, R, d, D, b, B; 0 for all other lines
+const uint8_t SLCANParser::type_table[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x1b, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x07, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x19, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// payload length of a DLC code, CAN FD codes included
+const uint8_t SLCANParser::dlc_table[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+SLCANParser::SLCANParser()
+  : _interfaceId(0),
+    _arrival_ns(0),
+    _clock(0),
+    _partialLen(0),
+    _discarding(false),
+    _numFrames(0),
+    _numErrors(0)
+{
+}
+
+void SLCANParser::reset()
+{
+    _partialLen = 0;
+    _discarding = false;
+    _numFrames = 0;
+    _numErrors = 0;
+}
+
+void SLCANParser::setInterfaceId(CanInterfaceId id)
+{
+    _interfaceId = id;
+}
+
+void SLCANParser::setTimestampNs(uint64_t arrival_ns)
+{
+    _arrival_ns = arrival_ns;
+}
+
+void SLCANParser::setDeviceClock(SLCANDeviceClock *clock)
+{
+    _clock = clock;
+}
+
+void SLCANParser::setReplyHandler(const ReplyHandler &handler)
+{
+    _replyHandler = handler;
+}
+
+uint64_t SLCANParser::numFrames() const
+{
+    return _numFrames;
+}
+
+uint64_t SLCANParser::numErrors() const
+{
+    return _numErrors;
+}
+
+int SLCANParser::parse(const char *data, int len, CanMessageBatch &batch)
+{
+    const uint8_t *pos = (const uint8_t *)data;
+    const uint8_t *end = pos + len;
+
+    while ((pos < end) && !batch.isFull()) {
+
+        // Fast path: the header of a frame line tells where the line has to end,
+        // so a complete, valid frame is decoded without searching for its end.
+        if (!_partialLen && !_discarding) {
+            int line_len = frameLineLength(pos, end - pos);
+            if ((line_len >= 0) && ((line_len + 4) < (end - pos)) && (pos[line_len] != '\r')) {
+                line_len += 4; // device timestamp after the data
+            }
+            if ((line_len >= 0) && (line_len < (end - pos)) && (pos[line_len] == '\r')) {
+                CanMessage &msg = batch.next();
+                if (decodeLine(pos, line_len, msg)) {
+                    batch.commit();
+                    _numFrames++;
+                    pos += line_len + 1;
+                    continue;
+                }
+            }
+        }
+
+        // lines end with CR; a bare BEL is the adapter's error reply and ends a line as well,
+        // and LF, which some firmwares put after their configuration replies
+        const uint8_t *eol = pos;
+        while ((eol < end) && (*eol != '\r') && (*eol != '\a') && (*eol != '\n')) {
+            eol++;
+        }
+
+        if (eol == end) {
+            appendPartial(pos, end - pos);
+            pos = end;
+            break;
+        }
+
+        if (_partialLen || _discarding) {
+            appendPartial(pos, eol - pos);
+            if (!_discarding) {
+                decodeInto(batch, _partial, _partialLen);
+            }
+            _partialLen = 0;
+            _discarding = false;
+        } else {
+            decodeInto(batch, pos, eol - pos);
+        }
+
+        pos = eol + 1;
+    }
+
+    return pos - (const uint8_t *)data;
+}
+
+void SLCANParser::discardLine()
+{
+    _partialLen = 0;
+    _discarding = false;
+}
+
+void SLCANParser::appendPartial(const uint8_t *data, int len)
+{
+    if (_discarding) {
+        return;
+    }
+
+    if ((_partialLen + len) > max_line_length) {
+        // no valid line is this long; drop everything up to the next line end
+        uint8_t first = _partialLen ? _partial[0] : data[0];
+        if (type_table[first]) {
+            _numErrors++;
+        }
+        _partialLen = 0;
+        _discarding = true;
+        return;
+    }
+
+    memcpy(_partial + _partialLen, data, len);
+    _partialLen += len;
+}
+
+void SLCANParser::decodeInto(CanMessageBatch &batch, const uint8_t *line, int len)
+{
+    // empty lines are command acknowledges
+    if (len < 1) {
+        return;
+    }
+
+    if (!type_table[line[0]]) {
+        if (_replyHandler) {
+            _replyHandler((const char *)line, len);
+        }
+        return;
+    }
+
+    CanMessage &msg = batch.next();
+    if (decodeLine(line, len, msg)) {
+        batch.commit();
+        _numFrames++;
+    } else {
+        _numErrors++;
+    }
+}
+
+int SLCANParser::frameLineLength(const uint8_t *line, int avail)
+{
+    uint8_t type = (avail > 0) ? type_table[line[0]] : 0;
+    int id_len = (type & type_ext) ? 8 : 3;
+    if (!type || (avail <= (1 + id_len))) {
+        return -1;
+    }
+
+    int8_t dlc = hex_table[line[1 + id_len]];
+    if (dlc < 0) {
+        return -1;
+    }
+
+    // remote frames carry a dlc but no data
+    return 1 + id_len + 1 + ((type & type_rtr) ? 0 : (2 * dlc_table[dlc]));
+}
+
+bool SLCANParser::decodeLine(const uint8_t *line, int len, CanMessage &msg)
+{
+    uint8_t type = type_table[line[0]];
+    int id_len = (type & type_ext) ? 8 : 3;
+
+    // command, id and dlc must be there before anything is read
+    if (len < (1 + id_len + 1)) {
+        return false;
+    }
+
+    uint32_t id = 0;
+    int8_t nibble_or = 0;
+    for (int i=1; i<=id_len; i++) {
+        int8_t nibble = hex_table[line[i]];
+        nibble_or |= nibble;
+        id = (id << 4) | (uint8_t)nibble;
+    }
+    if ((nibble_or < 0) || (id > ((type & type_ext) ? 0x1FFFFFFFu : 0x7FFu))) {
+        return false;
+    }
+
+    int8_t dlc = hex_table[line[1 + id_len]];
+    if ((dlc < 0) || (!(type & type_fd) && (dlc > 8))) {
+        return false;
+    }
+    uint8_t length = dlc_table[dlc];
+
+    // adapters with timestamps enabled append four digits after the data
+    int data_pos = 1 + id_len + 1;
+    int data_len = (type & type_rtr) ? 0 : length;
+    int data_end = data_pos + 2 * data_len;
+    if ((len != data_end) && (len != (data_end + 4))) {
+        return false;
+    }
+
+    uint8_t payload[64];
+    const uint8_t *digit = line + data_pos;
+    for (int i=0; i<data_len; i++) {
+        int8_t hi = hex_table[digit[0]];
+        int8_t lo = hex_table[digit[1]];
+        nibble_or |= hi | lo;
+        payload[i] = (hi << 4) | lo;
+        digit += 2;
+    }
+    // device timestamp, 16 bit
+    uint16_t ticks = 0;
+    bool has_ticks = (len == (data_end + 4));
+    if (has_ticks) {
+        for (int i=0; i<4; i++) {
+            int8_t nibble = hex_table[digit[i]];
+            nibble_or |= nibble;
+            ticks = (ticks << 4) | (uint8_t)nibble;
+        }
+    }
+
+    if (nibble_or < 0) {
+        return false;
+    }
+
+    msg.setData(payload, data_len);
+    msg.setLength(length);
+    msg.setId(id);
+    msg.setExtended(type & type_ext);
+    msg.setRTR(type & type_rtr);
+    msg.setFD(type & type_fd);
+    msg.setBRS(type & type_brs);
+    msg.setErrorFrame(false);
+    msg.setInterfaceId(_interfaceId);
+    msg.setDirection(CanMessage::Rx);
+    if (has_ticks && _clock) {
+        msg.setTimestampNs(_clock->toHostNs(ticks, _arrival_ns));
+        msg.setTimestampSource(CanMessage::timestamp_source_device);
+    } else {
+        msg.setTimestampNs(_arrival_ns);
+        msg.setTimestampSource(CanMessage::timestamp_source_host);
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <driver/CanDriver.h>
+
+class CanMessage;
+class CanMessageBatch;
+class SLCANDeviceClock;
+
+/*
+ * Decoder for the SLCAN (Lawicel) ASCII line protocol.
+ *
+ * Frames are decoded straight from the bytes passed to parse(), using
+ * lookup tables for hex digits, frame types and DLC codes. Only a line
+ * that is split across two reads is copied, into a buffer of
+ * max_line_length bytes. Every line is checked against its DLC before
+ * a data byte is decoded; malformed frame lines are counted and skipped.
+ *
+ * Lines carrying the four digit device timestamp are stamped through the
+ * device clock, if one is set; all other frames get their arrival time.
+ * Lines that are not frames (replies to commands) go to the reply handler.
+ */
+class SLCANParser
+{
+public:
+    typedef std::function<void(const char *line, int len)> ReplyHandler;
+
+    enum {
+        // 'T' + 8 id digits + dlc + 64 data bytes + 4 timestamp digits
+        max_line_length = 1 + 8 + 1 + 2*64 + 4
+    };
+
+    SLCANParser();
+
+    void reset();
+    void setInterfaceId(CanInterfaceId id);
+
+    // arrival time of the bytes passed to the following parse() calls, see HostClock
+    void setTimestampNs(uint64_t arrival_ns);
+    void setDeviceClock(SLCANDeviceClock *clock);
+    void setReplyHandler(const ReplyHandler &handler);
+
+    // Decodes complete lines into batch until the input is used up or the
+    // batch is full, and returns the number of bytes consumed. A trailing
+    // incomplete line is kept and counts as consumed; bytes left over
+    // because the batch filled up must be passed in again.
+    int parse(const char *data, int len, CanMessageBatch &batch);
+
+    // forget a partially received line; the next input starts at a line boundary
+    void discardLine();
+
+    uint64_t numFrames() const;
+    uint64_t numErrors() const;
+
+private:
+    enum {
+        type_frame = 0x01,
+        type_ext = 0x02,
+        type_rtr = 0x04,
+        type_fd = 0x08,
+        type_brs = 0x10
+    };
+
+    static const int8_t hex_table[256];
+    static const uint8_t type_table[256];
+    static const uint8_t dlc_table[16];
+
+    CanInterfaceId _interfaceId;
+    uint64_t _arrival_ns;
+    SLCANDeviceClock *_clock;
+    ReplyHandler _replyHandler;
+
+    uint8_t _partial[max_line_length];
+    int _partialLen;
+    bool _discarding;
+
+    uint64_t _numFrames;
+    uint64_t _numErrors;
+
+    void appendPartial(const uint8_t *data, int len);
+    void decodeInto(CanMessageBatch &batch, const uint8_t *line, int len);
+    static int frameLineLength(const uint8_t *line, int avail);
+    bool decodeLine(const uint8_t *line, int len, CanMessage &msg);
+};
@@ -0,0 +1,567 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SLCANSimulator.h"
+
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+#include <core/HostClock.h>
+
+#include <QStringList>
+#include <QMutexLocker>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+SLCANSimulator::SLCANSimulator(const config_t &config)
+  : _config(config),
+    _master_fd(-1),
+    _slave_fd(-1),
+    _wakeup_fd(-1),
+    _stop(0),
+    _out_pos(0),
+    _channel_open(false),
+    _device_timestamps(false),
+    _terminal_res(false),
+    _seq(0),
+    _stream_start_ns(0),
+    _stream_frames(0),
+    _clock_start_ns(0),
+    _num_generated(0),
+    _num_overflowed(0),
+    _num_echoed(0),
+    _rx_frames(0),
+    _rx_lost(0),
+    _rx_next_seq(0),
+    _rx_first_us(0),
+    _rx_last_us(0),
+    _latency_sum_us(0),
+    _latency_max_us(0)
+{
+    // room for everything the adapter holds back, plus one burst
+    _out.reserve(out_limit + max_burst * (max_line_length + 1));
+}
+
+SLCANSimulator::~SLCANSimulator()
+{
+    stopSimulation();
+}
+
+bool SLCANSimulator::parseConfig(const QString &spec, config_t &config)
+{
+    foreach (const QString &item, spec.split(',', QString::SkipEmptyParts)) {
+        QString key = item.section('=', 0, 0).trimmed();
+        QString value = item.section('=', 1).trimmed();
+        if (key == "pattern") {
+            if (value == "classic") {
+                config.pattern = pattern_classic;
+            } else if (value == "extended") {
+                config.pattern = pattern_extended;
+            } else if (value == "fd") {
+                config.pattern = pattern_fd;
+            } else if (value == "fd_brs") {
+                config.pattern = pattern_fd_brs;
+            } else if (value == "mixed") {
+                config.pattern = pattern_mixed;
+            } else {
+                return false;
+            }
+        } else if (key == "rate") {
+            bool ok;
+            config.rate = value.toUInt(&ok);
+            if (!ok) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString SLCANSimulator::getPortName() const
+{
+    return _port_name;
+}
+
+QString SLCANSimulator::getDescription() const
+{
+    // open() takes the channel from the last number of the description
+    static const char *patterns[] = { "classic", "extended", "fd", "fd_brs", "mixed" };
+    return QString("SLCAN simulator, %1 at %2 frames/s, can%3")
+        .arg(patterns[_config.pattern])
+        .arg(_config.rate)
+        .arg(_config.channel);
+}
+
+bool SLCANSimulator::startSimulation()
+{
+#if defined(__linux__)
+    if (_master_fd >= 0) {
+        return true;
+    }
+
+    char name[64];
+    _master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((_master_fd < 0) || (grantpt(_master_fd) < 0) || (unlockpt(_master_fd) < 0)
+     || (ptsname_r(_master_fd, name, sizeof(name)) != 0)) {
+        log_error(QString("SLCAN simulator: cannot create pseudo-terminal: %1").arg(strerror(errno)));
+        stopSimulation();
+        return false;
+    }
+    fcntl(_master_fd, F_SETFL, fcntl(_master_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(_master_fd, F_SETFD, FD_CLOEXEC);
+
+    // raw, so CR is not turned into LF and nothing is echoed before QSerialPort configures the port
+    struct termios tio;
+    _slave_fd = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if ((_slave_fd < 0) || (tcgetattr(_slave_fd, &tio) < 0)) {
+        log_error(QString("SLCAN simulator: cannot open %1: %2").arg(name).arg(strerror(errno)));
+        stopSimulation();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(_slave_fd, TCSANOW, &tio);
+
+    _wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_wakeup_fd < 0) {
+        log_error(QString("SLCAN simulator: eventfd failed: %1").arg(strerror(errno)));
+        stopSimulation();
+        return false;
+    }
+
+    _port_name = name;
+    _clock_start_ns = monotonicNs();
+    _stop.storeRelease(0);
+    start();
+
+    log_info(QString("SLCAN simulator for can%1 listening on %2").arg(_config.channel).arg(_port_name));
+    return true;
+#else
+    log_warning("the SLCAN simulator needs Linux pseudo-terminals");
+    return false;
+#endif
+}
+
+void SLCANSimulator::stopSimulation()
+{
+#if defined(__linux__)
+    if (isRunning()) {
+        uint64_t one = 1;
+        _stop.storeRelease(1);
+        if (::write(_wakeup_fd, &one, sizeof(one)) != sizeof(one)) {
+            log_error(QString("SLCAN simulator: cannot wake up thread: %1").arg(strerror(errno)));
+        }
+        wait();
+    }
+
+    if (_wakeup_fd >= 0) {
+        ::close(_wakeup_fd);
+        _wakeup_fd = -1;
+    }
+    if (_slave_fd >= 0) {
+        ::close(_slave_fd);
+        _slave_fd = -1;
+    }
+    if (_master_fd >= 0) {
+        ::close(_master_fd);
+        _master_fd = -1;
+    }
+#endif
+}
+
+void SLCANSimulator::run()
+{
+#if defined(__linux__)
+    char buf[4096];
+
+    while (!_stop.loadAcquire()) {
+        struct pollfd fds[2];
+        fds[0].fd = _master_fd;
+        fds[0].events = POLLIN | ((_out.size() > _out_pos) ? POLLOUT : 0);
+        fds[0].revents = 0;
+        fds[1].fd = _wakeup_fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        // sleep until the host writes, the host reads, or the next frame is due
+        unsigned wait_us = waitTimeoutUs();
+        struct timespec timeout;
+        timeout.tv_sec = wait_us / 1000000;
+        timeout.tv_nsec = (wait_us % 1000000) * 1000;
+        if (ppoll(fds, 2, (wait_us != (unsigned)-1) ? &timeout : NULL, NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error(QString("SLCAN simulator: poll failed: %1").arg(strerror(errno)));
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t got;
+            while ((got = ::read(_master_fd, buf, sizeof(buf))) > 0) {
+                _in.append(buf, got);
+            }
+            handleInput();
+        }
+
+        if (_channel_open && _config.rate) {
+            generateFrames();
+        }
+        flushOut();
+    }
+#endif
+}
+
+unsigned SLCANSimulator::waitTimeoutUs()
+{
+    if (!_channel_open || !_config.rate) {
+        return (unsigned)-1;
+    }
+
+    uint64_t next_due_ns = _stream_start_ns + ((_stream_frames + 1) * 1000000000ULL) / _config.rate;
+    uint64_t now = monotonicNs();
+    return (next_due_ns > now) ? (next_due_ns - now + 999) / 1000 : 0;
+}
+
+uint64_t SLCANSimulator::monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int SLCANSimulator::hpmCommandLength(const char *p, int len)
+{
+    // the HPMicro commands are sent without CR, each in one write; 0 if p does not start with a complete one
+    static const char r_can[] = "r_can";
+    static const char get_res[] = "hpm_cfg_g_120r";
+    static const char set_res[] = "hpm_cfg_s_120r_";
+
+    if ((len > 5) && (memcmp(p, r_can, 5) == 0) && (p[5] >= '0') && (p[5] <= '9')) {
+        int n = 6;
+        while ((n < len) && (p[n] >= '0') && (p[n] <= '9')) {
+            n++;
+        }
+        return n;
+    }
+    if ((len >= 14) && (memcmp(p, get_res, 14) == 0)) {
+        return 14;
+    }
+    if ((len >= 16) && (memcmp(p, set_res, 15) == 0) && ((p[15] == '0') || (p[15] == '1'))) {
+        return 16;
+    }
+    return 0;
+}
+
+void SLCANSimulator::handleInput()
+{
+    const char *p = _in.constData();
+    int len = _in.size();
+    int start = 0;
+
+    for (;;) {
+        int n;
+        while ((n = hpmCommandLength(p + start, len - start)) > 0) {
+            if (p[start] == 'r') {
+                reply(getDescription().toLatin1().constData());
+                reply("\r");
+            } else if (p[start + 8] == 'g') {
+                reply(_terminal_res ? "hpm_cfg_g_120r_1\r" : "hpm_cfg_g_120r_0\r");
+            } else {
+                _terminal_res = (p[start + 15] == '1');
+            }
+            start += n;
+        }
+
+        int eol = start;
+        while ((eol < len) && (p[eol] != '\r') && (p[eol] != '\n')) {
+            eol++;
+        }
+        if (eol == len) {
+            break;
+        }
+        if (eol > start) {
+            handleCommand(p + start, eol - start);
+        }
+        start = eol + 1;
+    }
+
+    _in.remove(0, start);
+    if (_in.size() > max_line_length) {
+        _in.resize(0);
+        reply("\a");
+    }
+}
+
+void SLCANSimulator::handleCommand(const char *line, int len)
+{
+    switch (line[0]) {
+        case 't': case 'T': case 'r': case 'R':
+        case 'd': case 'D': case 'b': case 'B':
+            handleFrame(line, len);
+            return;
+
+        case 'S':
+            reply(((len == 2) && (line[1] >= '0') && (line[1] <= '9')) ? "\r" : "\a");
+            return;
+
+        case 'Y':
+            reply((len == 2) ? "\r" : "\a");
+            return;
+
+        case 'Z':
+            if ((len == 2) && ((line[1] == '0') || (line[1] == '1'))) {
+                _device_timestamps = (line[1] == '1');
+                reply("\r");
+            } else {
+                reply("\a");
+            }
+            return;
+
+        case 'O':
+            // every measurement starts a new sequence, checkFrame() restarts with it
+            _channel_open = true;
+            _seq = 0;
+            _stream_start_ns = monotonicNs();
+            _stream_frames = 0;
+            _num_generated.storeRelease(0);
+            _num_overflowed.storeRelease(0);
+            _num_echoed.storeRelease(0);
+            reply("\r");
+            return;
+
+        case 'C':
+            _channel_open = false;
+            reply("\r");
+            return;
+
+        default:
+            reply("\a");
+            return;
+    }
+}
+
+void SLCANSimulator::handleFrame(const char *line, int len)
+{
+    if (!_channel_open || (len > max_line_length)) {
+        reply("\a");
+        return;
+    }
+
+    // echo as received from the bus, with the time it was sent
+    _out.append(line, len);
+    appendTimestamp();
+    _out.append('\r');
+    _num_echoed.fetchAndAddRelaxed(1);
+}
+
+void SLCANSimulator::reply(const char *text)
+{
+    _out.append(text);
+}
+
+void SLCANSimulator::appendTimestamp()
+{
+    // Z1: milliseconds, wrapping after one minute
+    if (_device_timestamps) {
+        char ts[5];
+        unsigned ms = ((monotonicNs() - _clock_start_ns) / 1000000) % 60000;
+        snprintf(ts, sizeof(ts), "%04X", ms);
+        _out.append(ts, 4);
+    }
+}
+
+void SLCANSimulator::generateFrames()
+{
+    uint64_t due = ((monotonicNs() - _stream_start_ns) / 1000) * _config.rate / 1000000;
+    if (due <= _stream_frames) {
+        return;
+    }
+
+    // after the thread was held up, continue at the rate instead of catching up at once
+    if ((due - _stream_frames) > max_burst) {
+        _stream_frames = due - max_burst;
+    }
+
+    // the clock the interface stamps arrivals with, so checkFrame() can compare them
+    uint32_t sent_us = (uint32_t)(HostClock::nowNs() / 1000);
+
+    uint8_t data[64];
+    for (; _stream_frames < due; _stream_frames++) {
+        uint32_t seq = _seq++;
+
+        // an adapter whose host does not read drops what it cannot buffer; this is seen as a sequence gap
+        if ((_out.size() - _out_pos) >= out_limit) {
+            _num_overflowed.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        // sequence number and send time little endian in front, the rest is filler
+        for (int i = 0; i < 4; i++) {
+            data[i] = seq >> (8 * i);
+            data[4 + i] = sent_us >> (8 * i);
+        }
+        memset(data + 8, seq & 0xFF, sizeof(data) - 8);
+
+        pattern_t pattern = (_config.pattern == pattern_mixed) ? (pattern_t)(seq % pattern_mixed) : _config.pattern;
+        switch (pattern) {
+            case pattern_extended:
+                appendFrame('T', sim_ext_id, data, 8);
+                break;
+            case pattern_fd:
+                appendFrame('d', sim_fd_id, data, 64);
+                break;
+            case pattern_fd_brs:
+                appendFrame('b', sim_fd_id, data, 64);
+                break;
+            default:
+                appendFrame('t', sim_std_id, data, 8);
+                break;
+        }
+        _num_generated.fetchAndAddRelaxed(1);
+    }
+}
+
+void SLCANSimulator::appendFrame(char type, uint32_t id, const uint8_t *data, int len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char line[max_line_length + 1];
+    int pos = 0;
+
+    line[pos++] = type;
+    for (int shift = ((type >= 'A') && (type <= 'Z')) ? 28 : 8; shift >= 0; shift -= 4) {
+        line[pos++] = hex[(id >> shift) & 0xF];
+    }
+
+    int dlc = len;
+    if (len > 8) {
+        dlc = (len <= 24) ? (8 + (len - 8) / 4) : ((len == 32) ? 13 : ((len == 48) ? 14 : 15));
+    }
+    line[pos++] = hex[dlc];
+
+    for (int i = 0; i < len; i++) {
+        line[pos++] = hex[data[i] >> 4];
+        line[pos++] = hex[data[i] & 0xF];
+    }
+    _out.append(line, pos);
+    appendTimestamp();
+    _out.append('\r');
+}
+
+void SLCANSimulator::flushOut()
+{
+#if defined(__linux__)
+    while (_out.size() > _out_pos) {
+        ssize_t written = ::write(_master_fd, _out.constData() + _out_pos, _out.size() - _out_pos);
+        if (written <= 0) {
+            break; // pty full, continue on POLLOUT
+        }
+        _out_pos += written;
+    }
+
+    if (_out_pos == _out.size()) {
+        _out.resize(0);
+        _out_pos = 0;
+    } else if (_out_pos >= out_limit) {
+        _out.remove(0, _out_pos);
+        _out_pos = 0;
+    }
+#endif
+}
+
+void SLCANSimulator::checkFrame(const CanMessage &msg, uint64_t arrival_us)
+{
+    uint32_t id = msg.getId();
+    bool generated = msg.isExtended() ? (id == sim_ext_id) : ((id == sim_std_id) || (id == sim_fd_id));
+    if (!generated || (msg.getLength() < 8) || (msg.direction() != CanMessage::Rx)) {
+        return;
+    }
+
+    uint32_t seq = 0;
+    uint32_t sent_us = 0;
+    for (int i = 0; i < 4; i++) {
+        seq |= (uint32_t)msg.getByte(i) << (8 * i);
+        sent_us |= (uint32_t)msg.getByte(4 + i) << (8 * i);
+    }
+
+    QMutexLocker locker(&_rx_mutex);
+
+    // a serial line does not reorder, so a lower sequence number means the channel was reopened
+    if ((_rx_frames == 0) || (seq < _rx_next_seq)) {
+        _rx_frames = 0;
+        _rx_lost = seq;
+        _rx_first_us = arrival_us;
+        _latency_sum_us = 0;
+        _latency_max_us = 0;
+    } else {
+        _rx_lost += seq - _rx_next_seq;
+    }
+    _rx_next_seq = seq + 1;
+    _rx_frames++;
+    _rx_last_us = arrival_us;
+
+    // both are host wall clock; only the low 32 bits are sent, which is enough for a difference
+    int32_t latency_us = (int32_t)((uint32_t)arrival_us - sent_us);
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+    _latency_sum_us += latency_us;
+    if ((uint32_t)latency_us > _latency_max_us) {
+        _latency_max_us = latency_us;
+    }
+}
+
+QString SLCANSimulator::getStatsStr() const
+{
+    uint64_t generated = _num_generated.loadAcquire();
+    uint64_t overflowed = _num_overflowed.loadAcquire();
+    uint64_t echoed = _num_echoed.loadAcquire();
+
+    QMutexLocker locker(&_rx_mutex);
+    uint64_t frames = _rx_frames;
+    uint64_t span_us = _rx_last_us - _rx_first_us;
+    return QString("simulator: %1 of %2 frames received, %3 frames/s, latency %4 us avg / %5 us max, "
+                   "%6 lost (%7 in the adapter), %8 echoed")
+        .arg((unsigned long long)frames)
+        .arg((unsigned long long)(generated + overflowed))
+        .arg(span_us ? (unsigned long long)((frames - 1) * 1000000 / span_us) : 0ULL)
+        .arg(frames ? (unsigned long long)(_latency_sum_us / frames) : 0ULL)
+        .arg(_latency_max_us)
+        .arg((unsigned long long)_rx_lost)
+        .arg((unsigned long long)overflowed)
+        .arg((unsigned long long)echoed);
+}
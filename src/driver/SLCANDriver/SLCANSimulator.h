@@ -0,0 +1,152 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QThread>
+#include <QString>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QMutex>
+
+class CanMessage;
+
+/*
+ * SLCAN adapter simulated on a pseudo-terminal pair, for testing the SLCAN
+ * driver without hardware. Linux only.
+ *
+ * The slave side of the pty is an ordinary tty that SLCANInterface opens
+ * like the USB CDC port of an adapter. The simulator thread serves the
+ * master side:
+ *  - It answers the commands open() and close() send: r_canN, Sx, Yx, Zx,
+ *    O, C and the HPMicro hpm_cfg_* commands.
+ *  - While the channel is open, it streams frames of the configured
+ *    pattern at the configured rate.
+ *  - It echoes every frame written to it.
+ * With Z1, all lines carry a device timestamp in milliseconds, as the
+ * adapter sends them. There is no bus timing model; the rate is not
+ * limited by the bitrate.
+ *
+ * Generated frames carry a sequence number and the host time they were
+ * written at. checkFrame() uses them on the receiving side to measure
+ * rate, latency and loss. The generator uses its own identifiers
+ * (sim_std_id, sim_ext_id, sim_fd_id); don't transmit frames with these
+ * identifiers during a test.
+ */
+class SLCANSimulator : public QThread
+{
+public:
+    typedef enum {
+        pattern_classic,  // 8 byte standard frames
+        pattern_extended, // 8 byte extended frames
+        pattern_fd,       // 64 byte FD frames
+        pattern_fd_brs,   // 64 byte FD frames with bitrate switch
+        pattern_mixed     // all of the above in turn
+    } pattern_t;
+
+    typedef struct {
+        int channel;
+        pattern_t pattern;
+        unsigned rate; // frames per second, 0 to only answer commands and echo
+    } config_t;
+
+    enum {
+        sim_std_id = 0x100,
+        sim_ext_id = 0x1F000100,
+        sim_fd_id = 0x200
+    };
+
+    explicit SLCANSimulator(const config_t &config);
+    virtual ~SLCANSimulator();
+
+    // "pattern=mixed,rate=20000"; returns false on unknown keys or values
+    static bool parseConfig(const QString &spec, config_t &config);
+
+    // open the pty pair and start serving it; false if that is not possible here
+    bool startSimulation();
+    void stopSimulation();
+
+    QString getPortName() const;
+    QString getDescription() const;
+
+    // Receiving side: called by the interface for every frame parsed, with the host
+    // time its bytes were read at. Call it from one I/O thread only; getStatsStr()
+    // can be called from any thread.
+    void checkFrame(const CanMessage &msg, uint64_t arrival_us);
+    QString getStatsStr() const;
+
+protected:
+    virtual void run();
+
+private:
+    config_t _config;
+    QString _port_name;
+    int _master_fd;
+    int _slave_fd;  // kept open, so the master does not see a hangup between two measurements
+    int _wakeup_fd;
+    QAtomicInt _stop;
+
+    // simulator thread only
+    QByteArray _in;
+    QByteArray _out;
+    int _out_pos;
+    bool _channel_open;
+    bool _device_timestamps;
+    bool _terminal_res;
+    uint32_t _seq;
+    uint64_t _stream_start_ns;
+    uint64_t _stream_frames;
+    uint64_t _clock_start_ns;
+
+    // written by the simulator thread, read by getStatsStr()
+    QAtomicInteger<quint64> _num_generated;
+    QAtomicInteger<quint64> _num_overflowed; // generated while the host did not read, dropped like the adapter does
+    QAtomicInteger<quint64> _num_echoed;
+
+    // receiving side, see checkFrame(); guarded by _rx_mutex
+    mutable QMutex _rx_mutex;
+    uint64_t _rx_frames;
+    uint64_t _rx_lost;
+    uint32_t _rx_next_seq;
+    uint64_t _rx_first_us;
+    uint64_t _rx_last_us;
+    uint64_t _latency_sum_us;
+    uint32_t _latency_max_us;
+
+    enum {
+        max_line_length = 1 + 8 + 1 + 128 + 4,
+        out_limit = 65536, // bytes the adapter holds for a host that does not read
+        max_burst = 1024   // frames generated at once after the thread was held up
+    };
+
+    void handleInput();
+    void handleCommand(const char *line, int len);
+    void handleFrame(const char *line, int len);
+    void reply(const char *text);
+    void appendTimestamp();
+    void generateFrames();
+    void appendFrame(char type, uint32_t id, const uint8_t *data, int len);
+    void flushOut();
+    unsigned waitTimeoutUs();
+    static uint64_t monotonicNs();
+    static int hpmCommandLength(const char *p, int len);
+};
@@ -22,8 +22,12 @@
 
 #include "SocketCanDriver.h"
 #include "SocketCanInterface.h"
+#include "SocketCanNetlink.h"
+#include "SocketCanReactor.h"
 #include <core/Backend.h>
+#if !defined(CANGAROO_HEADLESS)
 #include <driver/GenericCanSetupPage.h>
+#endif
 
 #include <sys/socket.h>
 #include <linux/if.h>
@@ -39,28 +43,66 @@
 
 SocketCanDriver::SocketCanDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(0),
+    _netlink(new SocketCanNetlink()),
+    _reactor(0)
 {
+#if !defined(CANGAROO_HEADLESS)
+    setupPage = new GenericCanSetupPage();
     QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
+#endif
 }
 
 SocketCanDriver::~SocketCanDriver() {
+    stopListeners();
+    delete _netlink;
 }
 
-bool SocketCanDriver::update() {
+SocketCanNetlink *SocketCanDriver::netlink()
+{
+    return _netlink;
+}
 
-    deleteAllInterfaces();
+bool SocketCanDriver::hasSharedIoThread() const
+{
+    return true;
+}
 
-    struct nl_sock *sock = nl_socket_alloc();
-    struct nl_cache *cache;
+bool SocketCanDriver::addListener(CanListener *listener, CanInterface *intf)
+{
+    SocketCanInterface *scintf = dynamic_cast<SocketCanInterface*>(intf);
+    if (!scintf) {
+        return false;
+    }
+    if (!_reactor) {
+        _reactor = new SocketCanReactor();
+    }
+    _reactor->addListener(listener, scintf);
+    return true;
+}
 
-    nl_connect(sock, NETLINK_ROUTE);
-    int result = rtnl_link_alloc_cache(sock, AF_UNSPEC, &cache);
+void SocketCanDriver::startListeners()
+{
+    if (_reactor) {
+        _reactor->startThread();
+    }
+}
 
-    if (result < 0) {
-        log_error(QString("Could not access netlink device list: %1").arg(result));
-    } else {
+void SocketCanDriver::stopListeners()
+{
+    if (_reactor) {
+        _reactor->waitFinish();
+        delete _reactor;
+        _reactor = 0;
+    }
+}
 
+bool SocketCanDriver::update() {
+
+    deleteAllInterfaces();
+
+    struct nl_cache *cache = _netlink->allocLinkCache();
+    if (cache) {
         for (struct nl_object *obj = nl_cache_get_first(cache); obj!=0; obj=nl_cache_get_next(obj)) {
             struct rtnl_link *link = (struct rtnl_link *)obj;
 
@@ -69,12 +111,9 @@ bool SocketCanDriver::update() {
                 intf->readConfigFromLink(link);
             }
         }
+        nl_cache_free(cache);
     }
 
-    nl_cache_free(cache);
-    nl_close(sock);
-    nl_socket_free(sock);
-
     return true;
 }
 
@@ -26,6 +26,8 @@
 #include <driver/CanDriver.h>
 
 class SocketCanInterface;
+class SocketCanNetlink;
+class SocketCanReactor;
 class SetupDialogInterfacePage;
 class GenericCanSetupPage;
 
@@ -37,7 +39,17 @@ public:
     virtual QString getName();
     virtual bool update();
 
+    SocketCanNetlink *netlink();
+
+    // all SocketCAN interfaces of a measurement on one epoll thread (see SocketCanReactor)
+    virtual bool hasSharedIoThread() const;
+    virtual bool addListener(CanListener *listener, CanInterface *intf);
+    virtual void startListeners();
+    virtual void stopListeners();
+
 private:
     SocketCanInterface *createOrUpdateInterface(int index, QString name);
     GenericCanSetupPage *setupPage;
+    SocketCanNetlink *_netlink;
+    SocketCanReactor *_reactor;
 };
@@ -2,10 +2,16 @@ CONFIG += c++11
 
 SOURCES += \
     $$PWD/SocketCanInterface.cpp \
+    $$PWD/SocketCanReactor.cpp \
+    $$PWD/SocketCanNetlink.cpp \
+    $$PWD/SocketCanHwClock.cpp \
     $$PWD/SocketCanDriver.cpp
 
 HEADERS  += \
     $$PWD/SocketCanInterface.h \
+    $$PWD/SocketCanReactor.h \
+    $$PWD/SocketCanNetlink.h \
+    $$PWD/SocketCanHwClock.h \
     $$PWD/SocketCanDriver.h
 
 FORMS +=
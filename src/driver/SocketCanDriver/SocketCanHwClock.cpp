@@ -0,0 +1,68 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SocketCanHwClock.h"
+
+#include <stdlib.h>
+
+SocketCanHwClock::SocketCanHwClock()
+{
+    reset();
+}
+
+void SocketCanHwClock::reset()
+{
+    _last_hw_ns = 0;
+    _last_ref_ns = 0;
+    _aligner.reset();
+}
+
+bool SocketCanHwClock::isRunning() const
+{
+    return _aligner.isRunning();
+}
+
+double SocketCanHwClock::getDriftPpm() const
+{
+    return _aligner.getDriftPpm();
+}
+
+bool SocketCanHwClock::isStep(uint64_t hw_ns, uint64_t ref_ns) const
+{
+    // the hardware clock was set, or the controller restarted it
+    if (hw_ns < _last_hw_ns) {
+        return true;
+    }
+    int64_t hw_delta = (int64_t)(hw_ns - _last_hw_ns);
+    int64_t ref_delta = (int64_t)(ref_ns - _last_ref_ns);
+    return llabs(hw_delta - ref_delta) > ((int64_t)max_step_ms * 1000000);
+}
+
+uint64_t SocketCanHwClock::toHostNs(uint64_t hw_ns, uint64_t ref_ns)
+{
+    if (_aligner.isRunning() && isStep(hw_ns, ref_ns)) {
+        _aligner.reset();
+    }
+    _last_hw_ns = hw_ns;
+    _last_ref_ns = ref_ns;
+
+    return _aligner.toHostNs(hw_ns, ref_ns);
+}
@@ -0,0 +1,61 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <core/ClockAligner.h>
+
+/*
+ * Maps raw hardware receive stamps (SO_TIMESTAMPING, the PTP hardware
+ * clock of the CAN controller) to the host clock the other frames of a
+ * trace are stamped with.
+ *
+ * The hardware clock keeps its own epoch, so the raw stamps cannot be
+ * merged with host stamps as they are. Every frame also carries a kernel
+ * software stamp, which, moved onto host time, is the reference for a
+ * ClockAligner. A step of the hardware clock against the reference starts
+ * the alignment over.
+ */
+class SocketCanHwClock
+{
+public:
+    SocketCanHwClock();
+
+    void reset();
+
+    // host time of a frame stamped hw_ns by the controller and ref_ns (host time) by the kernel
+    uint64_t toHostNs(uint64_t hw_ns, uint64_t ref_ns);
+
+    bool isRunning() const;
+    double getDriftPpm() const;
+
+private:
+    enum {
+        max_step_ms = 100
+    };
+
+    uint64_t _last_hw_ns;
+    uint64_t _last_ref_ns;
+    ClockAligner _aligner;
+
+    bool isStep(uint64_t hw_ns, uint64_t ref_ns) const;
+};
@@ -20,17 +20,24 @@
 */
 
 #include "SocketCanInterface.h"
+#include "SocketCanDriver.h"
+#include "SocketCanNetlink.h"
 
 #include <core/Backend.h>
 #include <core/MeasurementInterface.h>
 #include <core/CanMessage.h>
+#include <core/HostClock.h>
+#include <driver/CanMessageBatch.h>
 
 #include <stdio.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #include <time.h>
 #include <QString>
 #include <QStringList>
-#include <QProcess>
+#include <QVector>
+#include <QByteArray>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
@@ -39,8 +46,11 @@
 #include <linux/if.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/can/bcm.h>
 #include <linux/can/netlink.h>
 #include <linux/sockios.h>
+#include <linux/ethtool.h>
+#include <linux/net_tstamp.h>
 #include <netlink/version.h>
 #include <netlink/route/link.h>
 #include <netlink/route/link/can.h>
@@ -51,8 +61,24 @@ SocketCanInterface::SocketCanInterface(SocketCanDriver *driver, int index, QStri
     _isOpen(false),
 	_fd(0),
     _name(name),
-    _ts_mode(ts_mode_SIOCSHWTSTAMP)
+    _netlink(driver->netlink()),
+    _rx_timestamp_mode(CanInterface::rx_timestamp_auto),
+    _rx_buffer_request(0),
+    _rx_buffer_size(0),
+    _ts_mode(ts_mode_SIOCGSTAMPNS),
+    _supports_hw_timestamps(false),
+    _rt_offset_ns(0),
+    _rx_mode(rx_mode_recvmmsg),
+    _fd_frames_enabled(false),
+    _bcm_fd(-1),
+    _rx_syscall_count(0),
+    _rx_frame_count(0),
+    _rx_ts_fallback_count(0),
+    _rx_drop_count(0),
+    _rx_drops_reported(0)
 {
+    _supports_hw_timestamps = queryHardwareTimestamps();
+    connect(_netlink, SIGNAL(linkChanged(int)), this, SLOT(onLinkChanged(int)));
 }
 
 SocketCanInterface::~SocketCanInterface() {
@@ -117,47 +143,84 @@ QString SocketCanInterface::buildIpRouteCmd(const MeasurementInterface &mi)
     return cmd.join(' ');
 }
 
-QStringList SocketCanInterface::buildCanIfConfigArgs(const MeasurementInterface &mi)
+bool SocketCanInterface::configureLink(const MeasurementInterface &mi)
 {
-    QStringList args;
-    args << "-d";
-    args << "-i" << getName();
-    args << "-b" << QString::number(mi.bitrate());
-    args << "-p" << QString::number(mi.samplePoint());
-    args << "-u";
-    return args;
-}
-
+    struct rtnl_link *orig = _netlink->getLink(_idx);
+    if (!orig) {
+        log_error(QString("cannot read link %1 via netlink").arg(getName()));
+        return false;
+    }
 
-void SocketCanInterface::applyConfig(const MeasurementInterface &mi)
-{
-    if (!mi.doConfigure()) {
-        log_info(QString("interface %1 not managed by cangaroo, not touching configuration").arg(getName()));
-        return;
+    // bit timing can only be changed while the link is down
+    struct rtnl_link *down = rtnl_link_alloc();
+    rtnl_link_unset_flags(down, IFF_UP);
+    int err = _netlink->changeLink(orig, down);
+    rtnl_link_put(down);
+    if (err < 0) {
+        log_error(QString("cannot set interface %1 down: %2").arg(getName()).arg(SocketCanNetlink::errorStr(err)));
+        rtnl_link_put(orig);
+        return false;
     }
 
-    log_info(QString("calling canifconfig to reconfigure interface %1").arg(getName()));
-    QStringList sl = buildCanIfConfigArgs(mi);
-    sl.prepend("canifconfig");
-    log_info(sl.join(" "));
+    // the kernel derives the remaining bit timing parameters from bitrate and sample point;
+    // the CAN settings are applied before the link is brought up again within the same request
+    struct rtnl_link *change = rtnl_link_alloc();
+    rtnl_link_set_type(change, "can");
+    rtnl_link_can_set_bitrate(change, mi.bitrate());
+    rtnl_link_can_set_sample_point(change, mi.samplePoint());
+    rtnl_link_can_set_restart_ms(change, mi.doAutoRestart() ? mi.autoRestartMs() : 0);
 
-    QProcess canIfConfig;
-    canIfConfig.start("canifconfig", buildCanIfConfigArgs(mi));
-    if (!canIfConfig.waitForFinished()) {
-        log_error(QString("timeout waiting for canifconfig"));
-        return;
+    if (mi.isListenOnlyMode()) {
+        rtnl_link_can_set_ctrlmode(change, CAN_CTRLMODE_LISTENONLY);
+    } else {
+        rtnl_link_can_unset_ctrlmode(change, CAN_CTRLMODE_LISTENONLY);
     }
 
-    if (canIfConfig.exitStatus()!=QProcess::NormalExit) {
-        log_error(QString("canifconfig crashed"));
-        return;
+    if (supportsCanFD()) {
+        if (mi.isCanFD()) {
+            rtnl_link_can_set_ctrlmode(change, CAN_CTRLMODE_FD);
+#if (LIBNL_CURRENT>=226)
+            struct can_bittiming dbt;
+            memset(&dbt, 0, sizeof(dbt));
+            dbt.bitrate = mi.fdBitrate();
+            dbt.sample_point = mi.fdSamplePoint();
+            rtnl_link_can_set_data_bittiming(change, &dbt);
+#else
+            log_warning(QString("%1: libnl too old to set the CAN FD data bitrate").arg(getName()));
+#endif
+        } else {
+            rtnl_link_can_unset_ctrlmode(change, CAN_CTRLMODE_FD);
+        }
     }
 
-    if (canIfConfig.exitCode() != 0) {
-        log_error(QString("canifconfig failed: ") + QString(canIfConfig.readAllStandardError()).trimmed());
+    rtnl_link_set_flags(change, IFF_UP);
+    err = _netlink->changeLink(orig, change);
+    rtnl_link_put(change);
+    rtnl_link_put(orig);
+
+    if (err < 0) {
+        log_error(QString("cannot configure interface %1: %2").arg(getName()).arg(SocketCanNetlink::errorStr(err)));
+        return false;
+    }
+
+    readConfig();
+    return true;
+}
+
+void SocketCanInterface::applyConfig(const MeasurementInterface &mi)
+{
+    // timestamping is a property of our socket, not of the link, so it applies to unmanaged interfaces too
+    _rx_timestamp_mode = mi.rxTimestampMode();
+    _captureFilter = mi.captureFilter();
+    _rx_buffer_request = mi.rxBufferSize();
+
+    if (!mi.doConfigure()) {
+        log_info(QString("interface %1 not managed by cangaroo, not touching configuration").arg(getName()));
         return;
     }
 
+    log_info(QString("reconfiguring interface %1 via netlink: %2").arg(getName()).arg(buildIpRouteCmd(mi)));
+    configureLink(mi);
 }
 
 #if (LIBNL_CURRENT<=216)
@@ -172,41 +235,31 @@ int rtnl_link_can_state(struct rtnl_link *link, uint32_t *state) {
 bool SocketCanInterface::updateStatus()
 {
     bool retval = false;
-
-    struct nl_sock *sock = nl_socket_alloc();
-    struct nl_cache *cache;
-    struct rtnl_link *link;
     uint32_t state;
 
     _status.can_state = state_unknown;
 
-    nl_connect(sock, NETLINK_ROUTE);
-    if (rtnl_link_alloc_cache(sock, AF_UNSPEC, &cache) >= 0) {
-        if (rtnl_link_get_kernel(sock, _idx, 0, &link) == 0) {
+    struct rtnl_link *link = _netlink->getLink(_idx);
+    if (link) {
+        _status.rx_count = rtnl_link_get_stat(link, RTNL_LINK_RX_PACKETS);
+        _status.rx_overruns = rtnl_link_get_stat(link, RTNL_LINK_RX_OVER_ERR);
+        _status.tx_count = rtnl_link_get_stat(link, RTNL_LINK_TX_PACKETS);
+        _status.tx_dropped = rtnl_link_get_stat(link, RTNL_LINK_TX_DROPPED);
 
-            _status.rx_count = rtnl_link_get_stat(link, RTNL_LINK_RX_PACKETS);
-            _status.rx_overruns = rtnl_link_get_stat(link, RTNL_LINK_RX_OVER_ERR);
-            _status.tx_count = rtnl_link_get_stat(link, RTNL_LINK_TX_PACKETS);
-            _status.tx_dropped = rtnl_link_get_stat(link, RTNL_LINK_TX_DROPPED);
-
-            if (rtnl_link_is_can(link)) {
-                if (rtnl_link_can_state(link, &state)==0) {
-                    _status.can_state = state;
-                }
-                _status.rx_errors = rtnl_link_can_berr_rx(link);
-                _status.tx_errors = rtnl_link_can_berr_tx(link);
-            } else {
-                _status.rx_errors = 0;
-                _status.tx_errors = 0;
+        if (rtnl_link_is_can(link)) {
+            if (rtnl_link_can_state(link, &state)==0) {
+                _status.can_state = state;
             }
-            retval = true;
+            _status.rx_errors = rtnl_link_can_berr_rx(link);
+            _status.tx_errors = rtnl_link_can_berr_tx(link);
+        } else {
+            _status.rx_errors = 0;
+            _status.tx_errors = 0;
         }
+        retval = true;
+        rtnl_link_put(link);
     }
 
-    nl_cache_free(cache);
-    nl_close(sock);
-    nl_socket_free(sock);
-
     return retval;
 }
 
@@ -214,24 +267,24 @@ bool SocketCanInterface::readConfig()
 {
     bool retval = false;
 
-    struct nl_sock *sock = nl_socket_alloc();
-    struct nl_cache *cache;
-    struct rtnl_link *link;
+    struct rtnl_link *link = _netlink->getLink(_idx);
+    if (link) {
+        retval = readConfigFromLink(link);
+        rtnl_link_put(link);
+    }
 
-    nl_connect(sock, NETLINK_ROUTE);
-    int result = rtnl_link_alloc_cache(sock, AF_UNSPEC, &cache);
+    return retval;
+}
 
-    if (result>=0) {
-        if (rtnl_link_get_kernel(sock, _idx, 0, &link) == 0) {
-            retval = readConfigFromLink(link);
-        }
+void SocketCanInterface::onLinkChanged(int ifindex)
+{
+    if (ifindex != _idx) {
+        return;
     }
 
-    nl_cache_free(cache);
-    nl_close(sock);
-    nl_socket_free(sock);
-
-    return retval;
+    // pushed by the kernel on up/down, carrier loss (bus-off) and restarts
+    updateStatus();
+    emit stateChanged();
 }
 
 bool SocketCanInterface::readConfigFromLink(rtnl_link *link)
@@ -274,12 +327,45 @@ unsigned SocketCanInterface::getBitrate() {
     }
 }
 
+bool SocketCanInterface::supportsHardwareTimestamps()
+{
+    return _supports_hw_timestamps;
+}
+
+bool SocketCanInterface::queryHardwareTimestamps()
+{
+    // ask the driver via ethtool; works without the interface being open or up
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct ethtool_ts_info info;
+    memset(&info, 0, sizeof(info));
+    info.cmd = ETHTOOL_GET_TS_INFO;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, _name.toStdString().c_str(), IFNAMSIZ-1);
+    ifr.ifr_data = (char *)&info;
+
+    bool retval = (ioctl(fd, SIOCETHTOOL, &ifr) == 0)
+               && (info.so_timestamping & SOF_TIMESTAMPING_RX_HARDWARE)
+               && (info.so_timestamping & SOF_TIMESTAMPING_RAW_HARDWARE);
+
+    ::close(fd);
+    return retval;
+}
+
 uint32_t SocketCanInterface::getCapabilities()
 {
     uint32_t retval =
         CanInterface::capability_config_os |
         CanInterface::capability_listen_only |
-        CanInterface::capability_auto_restart;
+        CanInterface::capability_auto_restart |
+        CanInterface::capability_capture_filter |
+        CanInterface::capability_rx_buffer_size |
+        CanInterface::capability_cyclic_tx;
 
     if (supportsCanFD()) {
         retval |= CanInterface::capability_canfd;
@@ -289,6 +375,10 @@ uint32_t SocketCanInterface::getCapabilities()
         retval |= CanInterface::capability_triple_sampling;
     }
 
+    if (supportsHardwareTimestamps()) {
+        retval |= CanInterface::capability_hw_timestamps;
+    }
+
     return retval;
 }
 
@@ -334,11 +424,51 @@ int SocketCanInterface::getNumRxOverruns()
     return _status.rx_overruns;
 }
 
+int SocketCanInterface::getNumRxDropped()
+{
+    return _rx_drop_count;
+}
+
 int SocketCanInterface::getNumTxDropped()
 {
     return _status.tx_dropped;
 }
 
+QString SocketCanInterface::getStatusDetailsStr()
+{
+    if (_rx_syscall_count == 0) {
+        return "";
+    }
+    QString retval = QString("%1: %2 frames/syscall, %3, rcvbuf %4 KiB")
+        .arg((_rx_mode==rx_mode_recvmmsg) ? "recvmmsg" : "read")
+        .arg((double)_rx_frame_count / _rx_syscall_count, 0, 'f', 2)
+        .arg(getTimestampModeStr())
+        .arg(_rx_buffer_size / 1024);
+    if (_rx_ts_fallback_count) {
+        retval += QString(" (%1 frames without hw stamp)").arg(_rx_ts_fallback_count);
+    }
+    return retval;
+}
+
+QString SocketCanInterface::getTimestampModeStr()
+{
+    if (!_isOpen) {
+        return "";
+    }
+    switch (_ts_mode) {
+        case ts_mode_hardware:
+            if (_hw_clock.isRunning()) {
+                return QString("hardware timestamps, drift %1 ppm to host clock").arg(_hw_clock.getDriftPpm(), 0, 'f', 1);
+            }
+            return "hardware timestamps";
+        case ts_mode_software: return "kernel software timestamps";
+        case ts_mode_SO_TIMESTAMPNS: return "kernel timestamps (SO_TIMESTAMPNS)";
+        case ts_mode_SIOCGSTAMPNS: return "kernel timestamps (SIOCGSTAMPNS)";
+        case ts_mode_SIOCGSTAMP: return "kernel timestamps (SIOCGSTAMP)";
+        default: return "";
+    }
+}
+
 int SocketCanInterface::getIfIndex() {
     return _idx;
 }
@@ -367,6 +497,30 @@ void SocketCanInterface::open() {
         _isOpen = false;
 	}
 
+    // receive and send CAN FD frames next to classic ones; fails only on kernels without CAN FD
+    int enable_fd = 1;
+    _fd_frames_enabled = (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable_fd, sizeof(enable_fd)) == 0);
+    if (!_fd_frames_enabled) {
+        log_info(QString("%1: CAN_RAW_FD_FRAMES not supported, CAN FD frames will not be received").arg(getName()));
+    }
+
+    setupTimestamping();
+    setupCaptureFilter();
+    setupReceiveQueue();
+
+    for (int i=0; i<rx_mmsg_count; i++) {
+        _rx_iov[i].iov_base = &_rx_frames[i];
+        _rx_iov[i].iov_len = sizeof(struct canfd_frame);
+        memset(&_rx_mmsg[i].msg_hdr, 0, sizeof(struct msghdr));
+        _rx_mmsg[i].msg_hdr.msg_iov = &_rx_iov[i];
+        _rx_mmsg[i].msg_hdr.msg_iovlen = 1;
+        _rx_mmsg[i].msg_hdr.msg_control = _rx_cmsg[i];
+    }
+    _rx_syscall_count = 0;
+    _rx_frame_count = 0;
+    _rx_ts_fallback_count = 0;
+    _hw_clock.reset();
+
     _isOpen = true;
 }
 
@@ -376,97 +530,603 @@ bool SocketCanInterface::isOpen()
 }
 
 void SocketCanInterface::close() {
+    closeBcmSocket();
 	::close(_fd);
     _isOpen = false;
+
+    if (_rx_syscall_count) {
+        log_info(QString("%1: received %2 frames in %3 syscalls (%4)")
+            .arg(getName()).arg(_rx_frame_count).arg(_rx_syscall_count).arg(getStatusDetailsStr()));
+    }
 }
 
-void SocketCanInterface::sendMessage(const CanMessage &msg) {
-	struct can_frame frame;
+static uint8_t fdPaddedLength(uint8_t len)
+{
+    // CAN FD only knows 0..8, 12, 16, 20, 24, 32, 48 and 64 data bytes
+    static const uint8_t fd_lengths[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+    for (unsigned i=0; i<sizeof(fd_lengths); i++) {
+        if (len <= fd_lengths[i]) {
+            return (i==0) ? len : fd_lengths[i];
+        }
+    }
+    return CANFD_MAX_DLEN;
+}
 
-	frame.can_id = msg.getId();
+size_t SocketCanInterface::messageToFrame(const CanMessage &msg, struct canfd_frame &frame)
+{
+    memset(&frame, 0, sizeof(frame));
 
-	if (msg.isExtended()) {
-		frame.can_id |= CAN_EFF_FLAG;
-	}
+    frame.can_id = msg.getId();
 
-	if (msg.isRTR()) {
-		frame.can_id |= CAN_RTR_FLAG;
-	}
+    if (msg.isExtended()) {
+        frame.can_id |= CAN_EFF_FLAG;
+    }
 
-	if (msg.isErrorFrame()) {
-		frame.can_id |= CAN_ERR_FLAG;
-	}
+    if (msg.isErrorFrame()) {
+        frame.can_id |= CAN_ERR_FLAG;
+    }
 
-	uint8_t len = msg.getLength();
-	if (len>8) { len = 8; }
+    uint8_t len = msg.getLength();
 
-	frame.can_dlc = len;
-	for (int i=0; i<len; i++) {
-		frame.data[i] = msg.getByte(i);
-	}
+    if (msg.isFD()) {
+        // no remote frames in CAN FD; unused padding bytes stay zero
+        frame.len = fdPaddedLength(len);
+        if (msg.isBRS()) {
+            frame.flags |= CANFD_BRS;
+        }
+        if (msg.isESI()) {
+            frame.flags |= CANFD_ESI;
+        }
+    } else {
+        if (msg.isRTR()) {
+            frame.can_id |= CAN_RTR_FLAG;
+        }
+        if (len > CAN_MAX_DLEN) {
+            len = CAN_MAX_DLEN;
+        }
+        frame.len = len;
+    }
+
+    for (int i=0; i<len; i++) {
+        frame.data[i] = msg.getByte(i);
+    }
 
-	::write(_fd, &frame, sizeof(struct can_frame));
+    // a classic frame is sent as struct can_frame, which shares the layout of the first CAN_MTU bytes
+    return msg.isFD() ? CANFD_MTU : CAN_MTU;
 }
 
-bool SocketCanInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms) {
+void SocketCanInterface::sendMessage(const CanMessage &msg) {
+    struct canfd_frame frame;
+    size_t mtu = messageToFrame(msg, frame);
 
-    struct can_frame frame;
-    struct timespec ts_rcv;
-    struct timeval tv_rcv;
-    struct timeval timeout;
-    //struct ifreq hwtstamp;
-    fd_set fdset;
+    if (::write(_fd, &frame, mtu) != (ssize_t)mtu) {
+        log_error(QString("%1: cannot send frame: %2").arg(getName()).arg(strerror(errno)));
+    }
+}
 
-    timeout.tv_sec = timeout_ms / 1000;
-    timeout.tv_usec = 1000 * (timeout_ms % 1000);
+void SocketCanInterface::sendMessages(const QList<CanMessage> &msgs)
+{
+    // local buffers, as sending may happen from any thread
+    struct canfd_frame frames[tx_mmsg_count];
+    struct iovec iov[tx_mmsg_count];
+    struct mmsghdr mmsg[tx_mmsg_count];
+
+    int pos = 0;
+    while (pos < msgs.size()) {
+        int count = msgs.size() - pos;
+        if (count > tx_mmsg_count) {
+            count = tx_mmsg_count;
+        }
 
-    FD_ZERO(&fdset);
-    FD_SET(_fd, &fdset);
+        memset(mmsg, 0, count * sizeof(struct mmsghdr));
+        for (int i=0; i<count; i++) {
+            iov[i].iov_base = &frames[i];
+            iov[i].iov_len = messageToFrame(msgs[pos+i], frames[i]);
+            mmsg[i].msg_hdr.msg_iov = &iov[i];
+            mmsg[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // sendmmsg may stop early, e.g. on a full tx queue; resume with the first frame not sent
+        int sent = 0;
+        while (sent < count) {
+            int rv = sendmmsg(_fd, &mmsg[sent], count - sent, 0);
+            if (rv < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                log_error(QString("%1: cannot send %2 frames: %3").arg(getName()).arg(msgs.size() - pos - sent).arg(strerror(errno)));
+                return;
+            }
+            sent += rv;
+        }
+        pos += count;
+    }
+}
+
+uint32_t SocketCanInterface::cyclicKey(const CanMessage &msg)
+{
+    return msg.isExtended() ? ((msg.getId() & CAN_EFF_MASK) | CAN_EFF_FLAG) : (msg.getId() & CAN_SFF_MASK);
+}
+
+bool SocketCanInterface::openBcmSocket()
+{
+    if (_bcm_fd >= 0) {
+        return true;
+    }
 
-    CanMessage msg;
+    _bcm_fd = socket(PF_CAN, SOCK_DGRAM, CAN_BCM);
+    if (_bcm_fd < 0) {
+        log_error(QString("%1: cannot open CAN_BCM socket: %2").arg(getName()).arg(strerror(errno)));
+        return false;
+    }
 
-    int rv = select(_fd+1, &fdset, NULL, NULL, &timeout);
-    if (rv>0) {
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = _idx;
+    if (::connect(_bcm_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        log_error(QString("%1: cannot connect CAN_BCM socket: %2").arg(getName()).arg(strerror(errno)));
+        ::close(_bcm_fd);
+        _bcm_fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void SocketCanInterface::closeBcmSocket()
+{
+    // closing the socket makes the kernel remove all of its TX_SETUP operations
+    if (_bcm_fd >= 0) {
+        ::close(_bcm_fd);
+        _bcm_fd = -1;
+    }
+    _cyclic_tx.clear();
+}
+
+bool SocketCanInterface::startCyclicTransmission(const QList<CanMessage> &frames, unsigned interval_us)
+{
+    if (frames.isEmpty() || (frames.size() > bcm_max_frames) || (interval_us == 0)) {
+        return false;
+    }
 
-        if (read(_fd, &frame, sizeof(struct can_frame)) < 0) {
+    // one BCM operation carries either classic or FD frames
+    bool is_fd = frames.first().isFD();
+    foreach (const CanMessage &msg, frames) {
+        if (msg.isFD() != is_fd) {
             return false;
         }
+    }
+
+    if (!_isOpen || !openBcmSocket()) {
+        return false;
+    }
+
+    uint32_t key = cyclicKey(frames.first());
+    bool update = _cyclic_tx.contains(key);
+    if (update && ((_cyclic_tx[key].nframes != frames.size()) || (_cyclic_tx[key].is_fd != is_fd))) {
+        // the kernel cannot resize an operation, start over
+        stopCyclicTransmission(frames.first());
+        update = false;
+    }
+
+    struct bcm_msg_head head;
+    memset(&head, 0, sizeof(head));
+    head.opcode = TX_SETUP;
+    head.can_id = key;
+    head.nframes = frames.size();
+    if (is_fd) {
+        head.flags |= CAN_FD_FRAME;
+    }
+
+    // without SETTIMER the kernel only swaps the frame contents, the running cycle is not disturbed
+    if (!update || (_cyclic_tx[key].interval_us != interval_us)) {
+        head.flags |= SETTIMER | STARTTIMER;
+        head.count = 0;
+        head.ival2.tv_sec = interval_us / 1000000;
+        head.ival2.tv_usec = interval_us % 1000000;
+    }
+
+    size_t frame_size = is_fd ? sizeof(struct canfd_frame) : sizeof(struct can_frame);
+    QByteArray buf(sizeof(head) + frames.size() * frame_size, 0);
+    memcpy(buf.data(), &head, sizeof(head));
+    for (int i=0; i<frames.size(); i++) {
+        struct canfd_frame frame;
+        messageToFrame(frames[i], frame);
+        memcpy(buf.data() + sizeof(head) + i * frame_size, &frame, frame_size);
+    }
+
+    if (::write(_bcm_fd, buf.constData(), buf.size()) != buf.size()) {
+        log_error(QString("%1: CAN_BCM TX_SETUP failed: %2").arg(getName()).arg(strerror(errno)));
+        return false;
+    }
+
+    cyclic_tx_t op;
+    op.interval_us = interval_us;
+    op.nframes = frames.size();
+    op.is_fd = is_fd;
+    _cyclic_tx[key] = op;
+    return true;
+}
 
-        if (_ts_mode == ts_mode_SIOCSHWTSTAMP) {
-            // TODO implement me
-            _ts_mode = ts_mode_SIOCGSTAMPNS;
+void SocketCanInterface::stopCyclicTransmission(const CanMessage &msg)
+{
+    uint32_t key = cyclicKey(msg);
+    if ((_bcm_fd < 0) || !_cyclic_tx.contains(key)) {
+        return;
+    }
+
+    struct bcm_msg_head head;
+    memset(&head, 0, sizeof(head));
+    head.opcode = TX_DELETE;
+    head.can_id = key;
+    if (_cyclic_tx[key].is_fd) {
+        head.flags |= CAN_FD_FRAME;
+    }
+    if (::write(_bcm_fd, &head, sizeof(head)) != sizeof(head)) {
+        log_error(QString("%1: CAN_BCM TX_DELETE failed: %2").arg(getName()).arg(strerror(errno)));
+    }
+    _cyclic_tx.remove(key);
+}
+
+bool SocketCanInterface::enableHardwareTimestamps()
+{
+    struct hwtstamp_config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, _name.toStdString().c_str(), IFNAMSIZ-1);
+    ifr.ifr_data = (char *)&cfg;
+
+    // many CAN controllers stamp every frame unconditionally and only support the query
+    if ((ioctl(_fd, SIOCGHWTSTAMP, &ifr) == 0) && (cfg.rx_filter == HWTSTAMP_FILTER_ALL)) {
+        return true;
+    }
+
+    cfg.flags = 0;
+    cfg.tx_type = HWTSTAMP_TX_OFF;
+    cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    return (ioctl(_fd, SIOCSHWTSTAMP, &ifr) == 0) && (cfg.rx_filter != HWTSTAMP_FILTER_NONE);
+}
+
+void SocketCanInterface::setupTimestamping()
+{
+    // have the kernel attach the receive timestamp to each frame instead of asking for it per frame
+    _rx_mode = rx_mode_recvmmsg;
+
+    if ((_rx_timestamp_mode == rx_timestamp_auto) || (_rx_timestamp_mode == rx_timestamp_hardware)) {
+        int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                  | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (enableHardwareTimestamps() && (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)) {
+            _ts_mode = ts_mode_hardware;
+            return;
         }
+        if (_rx_timestamp_mode == rx_timestamp_hardware) {
+            log_warning(QString("%1: hardware timestamps not available, using kernel software timestamps").arg(getName()));
+        }
+    }
+
+    if (_rx_timestamp_mode != rx_timestamp_legacy) {
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) {
+            _ts_mode = ts_mode_software;
+            return;
+        }
+    }
 
-        if (_ts_mode==ts_mode_SIOCGSTAMPNS) {
-            if (ioctl(_fd, SIOCGSTAMPNS, &ts_rcv) == 0) {
-                msg.setTimestamp(ts_rcv.tv_sec, ts_rcv.tv_nsec/1000);
-            } else {
-                _ts_mode = ts_mode_SIOCGSTAMP;
+    int enable = 1;
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0) {
+        _ts_mode = ts_mode_SO_TIMESTAMPNS;
+        return;
+    }
+
+    log_warning(QString("%1: SO_TIMESTAMPNS not supported, falling back to per-frame reads").arg(getName()));
+    _ts_mode = ts_mode_SIOCGSTAMPNS;
+    _rx_mode = rx_mode_read;
+}
+
+void SocketCanInterface::setupCaptureFilter()
+{
+    // let the kernel drop what we do not want before it is queued on our socket
+    if (!_captureFilter.capturesEverything()) {
+        QVector<struct can_filter> filters;
+        foreach (const CanCaptureFilter::Rule &rule, _captureFilter.rules()) {
+            struct can_filter f;
+            f.can_id = rule.id;
+            f.can_mask = rule.mask;
+            if (rule.inverted) {
+                f.can_id |= CAN_INV_FILTER;
             }
+            filters.append(f);
+        }
+        if (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FILTER, filters.constData(), filters.size() * sizeof(struct can_filter)) < 0) {
+            log_error(QString("%1: cannot install capture filter: %2").arg(getName()).arg(strerror(errno)));
+        }
+    }
+
+    can_err_mask_t err_mask = _captureFilter.errorMask();
+    if (err_mask) {
+        if (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) < 0) {
+            log_error(QString("%1: cannot install error frame filter: %2").arg(getName()).arg(strerror(errno)));
         }
+    }
+}
 
-        if (_ts_mode==ts_mode_SIOCGSTAMP) {
-            ioctl(_fd, SIOCGSTAMP, &tv_rcv);
-            msg.setTimestamp(tv_rcv.tv_sec, tv_rcv.tv_usec);
+void SocketCanInterface::setupReceiveQueue()
+{
+    if (_rx_buffer_request) {
+        // SO_RCVBUFFORCE may exceed net.core.rmem_max, but needs CAP_NET_ADMIN
+        int size = _rx_buffer_request;
+        if (setsockopt(_fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+            if (setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+                log_warning(QString("%1: cannot set receive buffer size: %2").arg(getName()).arg(strerror(errno)));
+            }
         }
+    }
 
-        msg.setId(frame.can_id);
-        msg.setExtended((frame.can_id & CAN_EFF_FLAG)!=0);
-        msg.setRTR((frame.can_id & CAN_RTR_FLAG)!=0);
-        msg.setErrorFrame((frame.can_id & CAN_ERR_FLAG)!=0);
-        msg.setInterfaceId(getId());
+    // the kernel reports twice the requested size, to account for its bookkeeping overhead
+    socklen_t len = sizeof(_rx_buffer_size);
+    if (getsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &_rx_buffer_size, &len) < 0) {
+        _rx_buffer_size = 0;
+    }
+    if (_rx_buffer_request && ((unsigned)_rx_buffer_size < _rx_buffer_request)) {
+        log_warning(QString("%1: receive buffer limited to %2 bytes, %3 requested (raise net.core.rmem_max)")
+            .arg(getName()).arg(_rx_buffer_size).arg(_rx_buffer_request));
+    }
 
-        uint8_t len = frame.can_dlc;
-        if (len>8) { len = 8; }
+    int enable = 1;
+    if (setsockopt(_fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+        log_warning(QString("%1: SO_RXQ_OVFL not supported, socket drops will not be detected").arg(getName()));
+    }
+    _rx_drop_count = 0;
+    _rx_drops_reported = 0;
+}
 
-        msg.setLength(len);
-        for (int i=0; i<len; i++) {
-            msg.setByte(i, frame.data[i]);
+CanMessage &SocketCanInterface::commitGapMarker(CanMessageBatch &batch, CanMessage &msg)
+{
+    // msg already holds the timestamp of the first frame after the gap; turn it
+    // into the marker and hand out a fresh slot for the frame itself
+    uint64_t ts = msg.getTimestampNs();
+    CanMessage::TimestampSource source = msg.getTimestampSource();
+
+    msg.setId(_rx_drop_count - _rx_drops_reported);
+    msg.setExtended(false);
+    msg.setRTR(false);
+    msg.setFD(false);
+    msg.setBRS(false);
+    msg.setESI(false);
+    msg.setLength(0);
+    msg.setInterfaceId(getId());
+    msg.setDirection(CanMessage::Rx);
+    msg.setGapMarker(true);
+    batch.commit();
+    _rx_drops_reported = _rx_drop_count;
+
+    CanMessage &next = batch.next();
+    next.setTimestampNs(ts);
+    next.setTimestampSource(source);
+    return next;
+}
+
+uint64_t SocketCanInterface::kernelToHostNs(const struct timespec &ts) const
+{
+    // kernel stamps are CLOCK_REALTIME; keep them in line with host stamps if the system clock was set
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - _rt_offset_ns;
+}
+
+bool SocketCanInterface::decodeAncillaryData(struct msghdr *hdr, CanMessage &msg)
+{
+    bool has_timestamp = false;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
         }
 
-	msglist.append(msg);
-        return true;
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            // cumulative count of frames dropped on this socket, sent along once non-zero
+            memcpy(&_rx_drop_count, CMSG_DATA(cmsg), sizeof(_rx_drop_count));
+        } else if (has_timestamp) {
+            continue;
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0]: kernel software, ts[1]: deprecated, ts[2]: raw hardware
+            struct timespec ts[3];
+            memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+            if (ts[2].tv_sec || ts[2].tv_nsec) {
+                // the hardware clock has its own epoch; map it onto the host clock via the software stamp
+                uint64_t hw_ns = (uint64_t)ts[2].tv_sec * 1000000000 + ts[2].tv_nsec;
+                uint64_t ref_ns = (ts[0].tv_sec || ts[0].tv_nsec) ? kernelToHostNs(ts[0]) : HostClock::nowNs();
+                msg.setTimestampNs(_hw_clock.toHostNs(hw_ns, ref_ns));
+                msg.setTimestampSource(CanMessage::timestamp_source_kernel_hardware);
+                has_timestamp = true;
+                continue;
+            }
+            if (_ts_mode == ts_mode_hardware) {
+                _rx_ts_fallback_count++;
+            }
+            if (ts[0].tv_sec || ts[0].tv_nsec) {
+                msg.setTimestampNs(kernelToHostNs(ts[0]));
+                msg.setTimestampSource(CanMessage::timestamp_source_kernel_software);
+                has_timestamp = true;
+            }
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts_rcv;
+            memcpy(&ts_rcv, CMSG_DATA(cmsg), sizeof(ts_rcv));
+            msg.setTimestampNs(kernelToHostNs(ts_rcv));
+            msg.setTimestampSource(CanMessage::timestamp_source_kernel_software);
+            has_timestamp = true;
+        }
+    }
+
+    return has_timestamp;
+}
+
+void SocketCanInterface::readTimestamp(CanMessage &msg)
+{
+    struct timespec ts_rcv;
+    struct timeval tv_rcv;
+
+    if (_ts_mode != ts_mode_SIOCGSTAMP) {
+        if (ioctl(_fd, SIOCGSTAMPNS, &ts_rcv) == 0) {
+            msg.setTimestampNs(kernelToHostNs(ts_rcv));
+            msg.setTimestampSource(CanMessage::timestamp_source_kernel_software);
+            return;
+        } else {
+            _ts_mode = ts_mode_SIOCGSTAMP;
+        }
+    }
+
+    if (ioctl(_fd, SIOCGSTAMP, &tv_rcv) == 0) {
+        ts_rcv.tv_sec = tv_rcv.tv_sec;
+        ts_rcv.tv_nsec = tv_rcv.tv_usec * 1000;
+        msg.setTimestampNs(kernelToHostNs(ts_rcv));
+        msg.setTimestampSource(CanMessage::timestamp_source_kernel_software);
     } else {
+        msg.setTimestampNs(HostClock::nowNs());
+        msg.setTimestampSource(CanMessage::timestamp_source_host);
+    }
+}
+
+void SocketCanInterface::frameToMessage(const struct canfd_frame &frame, bool is_fd, CanMessage &msg)
+{
+    msg.setId(frame.can_id);
+    msg.setExtended((frame.can_id & CAN_EFF_FLAG)!=0);
+    msg.setRTR(!is_fd && ((frame.can_id & CAN_RTR_FLAG)!=0));
+    msg.setErrorFrame((frame.can_id & CAN_ERR_FLAG)!=0);
+    msg.setFD(is_fd);
+    msg.setBRS(is_fd && ((frame.flags & CANFD_BRS)!=0));
+    msg.setESI(is_fd && ((frame.flags & CANFD_ESI)!=0));
+    msg.setInterfaceId(getId());
+    msg.setDirection(CanMessage::Rx);
+
+    uint8_t len = frame.len;
+    uint8_t max_len = is_fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+    if (len>max_len) { len = max_len; }
+
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, frame.data[i]);
+    }
+}
+
+void SocketCanInterface::readMessagesMmsg(CanMessageBatch &batch)
+{
+    // keep one slot spare for a gap marker
+    while ((batch.capacity() - batch.size()) >= 2) {
+        int count = batch.capacity() - batch.size() - 1;
+        if (count > rx_mmsg_count) {
+            count = rx_mmsg_count;
+        }
+
+        // the kernel overwrites msg_controllen with the length actually used
+        for (int i=0; i<count; i++) {
+            _rx_mmsg[i].msg_hdr.msg_controllen = sizeof(_rx_cmsg[i]);
+        }
+
+        int rv = recvmmsg(_fd, _rx_mmsg, count, MSG_DONTWAIT, NULL);
+        if (rv < 0) {
+            if (errno == ENOSYS) {
+                log_warning(QString("%1: recvmmsg not supported, falling back to per-frame reads").arg(getName()));
+                _rx_mode = rx_mode_read;
+            }
+            return;
+        }
+        _rx_syscall_count++;
+        _rx_frame_count += rv;
+        _rt_offset_ns = HostClock::realtimeOffsetNs();
+
+        bool has_gap_marker = false;
+        for (int i=0; i<rv; i++) {
+            if ((_rx_mmsg[i].msg_len != CAN_MTU) && (_rx_mmsg[i].msg_len != CANFD_MTU)) {
+                continue;
+            }
+
+            CanMessage *msg = &batch.next();
+            if (!decodeAncillaryData(&_rx_mmsg[i].msg_hdr, *msg)) {
+                msg->setTimestampNs(HostClock::nowNs());
+                msg->setTimestampSource(CanMessage::timestamp_source_host);
+            }
+
+            // at most one marker per call; a later increase is reported with the next call
+            if ((_rx_drop_count != _rx_drops_reported) && !has_gap_marker) {
+                msg = &commitGapMarker(batch, *msg);
+                has_gap_marker = true;
+            }
+
+            frameToMessage(_rx_frames[i], _rx_mmsg[i].msg_len == CANFD_MTU, *msg);
+            batch.commit();
+        }
+
+        // a short read means the socket queue is empty
+        if (rv < count) {
+            return;
+        }
+    }
+}
+
+void SocketCanInterface::readMessagesRead(CanMessageBatch &batch)
+{
+    struct msghdr *hdr = &_rx_mmsg[0].msg_hdr;
+
+    // keep one slot spare for a gap marker
+    while ((batch.capacity() - batch.size()) >= 2) {
+        hdr->msg_controllen = sizeof(_rx_cmsg[0]);
+        ssize_t rv = recvmsg(_fd, hdr, MSG_DONTWAIT);
+        if (rv < 0) {
+            return;
+        }
+        _rx_syscall_count++;
+        if ((rv != CAN_MTU) && (rv != CANFD_MTU)) {
+            return;
+        }
+        _rt_offset_ns = HostClock::realtimeOffsetNs();
+        _rx_frame_count++;
+
+        CanMessage *msg = &batch.next();
+        if (!decodeAncillaryData(hdr, *msg)) {
+            readTimestamp(*msg);
+        }
+        if (_rx_drop_count != _rx_drops_reported) {
+            msg = &commitGapMarker(batch, *msg);
+        }
+        frameToMessage(_rx_frames[0], rv == CANFD_MTU, *msg);
+        batch.commit();
+    }
+}
+
+bool SocketCanInterface::readMessages(CanMessageBatch &batch, unsigned int timeout_ms) {
+
+    struct timeval timeout;
+    fd_set fdset;
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = 1000 * (timeout_ms % 1000);
+
+    FD_ZERO(&fdset);
+    FD_SET(_fd, &fdset);
+
+    if (select(_fd+1, &fdset, NULL, NULL, &timeout) <= 0) {
         return false;
     }
+
+    // socket is readable, drain whatever is queued without blocking again
+    return readAvailableMessages(batch);
+}
+
+int SocketCanInterface::getFd() const
+{
+    return _isOpen ? _fd : -1;
+}
+
+bool SocketCanInterface::readAvailableMessages(CanMessageBatch &batch)
+{
+    int start = batch.size();
+    if (_rx_mode == rx_mode_recvmmsg) {
+        readMessagesMmsg(batch);
+    } else {
+        readMessagesRead(batch);
+    }
+
+    return batch.size() > start;
 }
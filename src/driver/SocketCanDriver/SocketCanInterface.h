@@ -22,9 +22,15 @@
 #pragma once
 
 #include "../CanInterface.h"
+#include "SocketCanHwClock.h"
+#include <core/CanCaptureFilter.h>
+#include <QMap>
+#include <sys/socket.h>
+#include <linux/can.h>
 #include <linux/can/netlink.h>
 
 class SocketCanDriver;
+class SocketCanNetlink;
 
 typedef struct {
     bool supports_canfd;
@@ -50,6 +56,8 @@ typedef struct {
 } can_status_t;
 
 class SocketCanInterface: public CanInterface {
+    Q_OBJECT
+
 public:
     SocketCanInterface(SocketCanDriver *driver, int index, QString name);
 	virtual ~SocketCanInterface();
@@ -76,40 +84,122 @@ public:
 	virtual void close();
 
     virtual void sendMessage(const CanMessage &msg);
-    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms);
+    virtual void sendMessages(const QList<CanMessage> &msgs);
+    virtual bool startCyclicTransmission(const QList<CanMessage> &frames, unsigned interval_us);
+    virtual void stopCyclicTransmission(const CanMessage &msg);
+    virtual bool readMessages(CanMessageBatch &batch, unsigned int timeout_ms);
+
+    // for SocketCanReactor: socket to poll, and a non-blocking drain once it is readable
+    int getFd() const;
+    bool readAvailableMessages(CanMessageBatch &batch);
 
     virtual bool updateStatistics();
     virtual uint32_t getState();
     virtual int getNumRxFrames();
     virtual int getNumRxErrors();
     virtual int getNumRxOverruns();
+    virtual int getNumRxDropped();
 
     virtual int getNumTxFrames();
     virtual int getNumTxErrors();
     virtual int getNumTxDropped();
 
+    virtual QString getStatusDetailsStr();
+    virtual QString getTimestampModeStr();
+
+    bool supportsHardwareTimestamps();
 
     int getIfIndex();
 
+private slots:
+    void onLinkChanged(int ifindex);
+
 private:
     typedef enum {
-        ts_mode_SIOCSHWTSTAMP,
+        ts_mode_hardware,       // SO_TIMESTAMPING, raw hardware stamp with kernel software stamp as fallback
+        ts_mode_software,       // SO_TIMESTAMPING, kernel software stamp only
+        ts_mode_SO_TIMESTAMPNS,
         ts_mode_SIOCGSTAMPNS,
         ts_mode_SIOCGSTAMP
     } ts_mode_t;
 
+    typedef enum {
+        rx_mode_recvmmsg,
+        rx_mode_read
+    } rx_mode_t;
+
+    enum {
+        rx_mmsg_count = 64,
+        tx_mmsg_count = 64,
+        bcm_max_frames = 256 // MAX_NFRAMES of the kernel's CAN_BCM
+    };
+
+    // a TX_SETUP operation the broadcast manager currently runs for us
+    struct cyclic_tx_t {
+        unsigned interval_us;
+        int nframes;
+        bool is_fd;
+    };
+
     int _idx;
     bool _isOpen;
 	int _fd;
     QString _name;
+    SocketCanNetlink *_netlink;
 
     can_config_t _config;
     can_status_t _status;
+    int _rx_timestamp_mode;
+    CanCaptureFilter _captureFilter;
+    unsigned _rx_buffer_request;
+    int _rx_buffer_size;
     ts_mode_t _ts_mode;
+    bool _supports_hw_timestamps; // asked once via ethtool when the interface is created
+    SocketCanHwClock _hw_clock;
+    int64_t _rt_offset_ns; // HostClock::realtimeOffsetNs(), sampled once per receive syscall
+    rx_mode_t _rx_mode;
+    bool _fd_frames_enabled; // CAN_RAW_FD_FRAMES: socket exchanges canfd_frame as well as can_frame
+
+    // CAN_BCM socket for cyclic transmission, opened on first use; ops keyed by can_id incl. CAN_EFF_FLAG
+    int _bcm_fd;
+    QMap<uint32_t, cyclic_tx_t> _cyclic_tx;
+
+    // recvmmsg() state, set up once in open() and reused for every call.
+    // Classic frames arrive as CAN_MTU bytes, FD frames as CANFD_MTU, so every slot holds a canfd_frame.
+    struct canfd_frame _rx_frames[rx_mmsg_count];
+    struct iovec _rx_iov[rx_mmsg_count];
+    struct mmsghdr _rx_mmsg[rx_mmsg_count];
+    // large enough for SCM_TIMESTAMPING, which carries three timespecs (software, legacy, raw hardware),
+    // plus the SO_RXQ_OVFL drop counter
+    char _rx_cmsg[rx_mmsg_count][CMSG_SPACE(3*sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+
+    uint64_t _rx_syscall_count;
+    uint64_t _rx_frame_count;
+    uint64_t _rx_ts_fallback_count;
+
+    // SO_RXQ_OVFL: frames the kernel dropped because our socket queue was full
+    uint32_t _rx_drop_count;
+    uint32_t _rx_drops_reported;
 
     const char *cname();
     bool updateStatus();
-
+    bool queryHardwareTimestamps();
+    uint64_t kernelToHostNs(const struct timespec &ts) const;
+    bool enableHardwareTimestamps();
+    void setupTimestamping();
+    void setupCaptureFilter();
+    void setupReceiveQueue();
+    bool decodeAncillaryData(struct msghdr *hdr, CanMessage &msg);
+    CanMessage &commitGapMarker(CanMessageBatch &batch, CanMessage &msg);
+    void readTimestamp(CanMessage &msg);
+    void frameToMessage(const struct canfd_frame &frame, bool is_fd, CanMessage &msg);
+    size_t messageToFrame(const CanMessage &msg, struct canfd_frame &frame);
+    uint32_t cyclicKey(const CanMessage &msg);
+    bool openBcmSocket();
+    void closeBcmSocket();
+    void readMessagesMmsg(CanMessageBatch &batch);
+    void readMessagesRead(CanMessageBatch &batch);
+
+    bool configureLink(const MeasurementInterface &mi);
     QString buildIpRouteCmd(const MeasurementInterface &mi);
-    QStringList buildCanIfConfigArgs(const MeasurementInterface &mi);
 };
@@ -0,0 +1,138 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SocketCanNetlink.h"
+
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <core/Backend.h>
+
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/errno.h>
+#include <netlink/route/link.h>
+
+SocketCanNetlink::SocketCanNetlink(QObject *parent)
+  : QObject(parent),
+    _sock(0),
+    _events(0),
+    _notifier(0)
+{
+    _sock = nl_socket_alloc();
+    if (!_sock || (nl_connect(_sock, NETLINK_ROUTE) < 0)) {
+        log_error("cannot connect netlink route socket");
+        if (_sock) {
+            nl_socket_free(_sock);
+            _sock = 0;
+        }
+    }
+
+    // events arrive unsolicited, so there are no sequence numbers to check
+    _events = nl_socket_alloc();
+    if (_events) {
+        nl_socket_disable_seq_check(_events);
+        nl_socket_modify_cb(_events, NL_CB_VALID, NL_CB_CUSTOM, eventCallback, this);
+        if ((nl_connect(_events, NETLINK_ROUTE) < 0)
+         || (nl_socket_add_memberships(_events, RTNLGRP_LINK, 0) < 0)
+         || (nl_socket_set_nonblocking(_events) < 0)) {
+            log_warning("cannot subscribe to netlink link events, interface state will only be polled");
+            nl_socket_free(_events);
+            _events = 0;
+        }
+    }
+
+    if (_events) {
+        _notifier = new QSocketNotifier(nl_socket_get_fd(_events), QSocketNotifier::Read, this);
+        connect(_notifier, SIGNAL(activated(int)), this, SLOT(onEventsReadable()));
+    }
+}
+
+SocketCanNetlink::~SocketCanNetlink()
+{
+    delete _notifier;
+    if (_events) {
+        nl_socket_free(_events);
+    }
+    if (_sock) {
+        nl_socket_free(_sock);
+    }
+}
+
+struct nl_cache *SocketCanNetlink::allocLinkCache()
+{
+    QMutexLocker locker(&_mutex);
+    struct nl_cache *cache = 0;
+    if (!_sock) {
+        return 0;
+    }
+
+    int err = rtnl_link_alloc_cache(_sock, AF_UNSPEC, &cache);
+    if (err < 0) {
+        log_error(QString("Could not access netlink device list: %1").arg(errorStr(err)));
+        return 0;
+    }
+    return cache;
+}
+
+struct rtnl_link *SocketCanNetlink::getLink(int ifindex)
+{
+    QMutexLocker locker(&_mutex);
+    struct rtnl_link *link = 0;
+    if (!_sock || (rtnl_link_get_kernel(_sock, ifindex, 0, &link) < 0)) {
+        return 0;
+    }
+    return link;
+}
+
+int SocketCanNetlink::changeLink(struct rtnl_link *orig, struct rtnl_link *changes)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_sock) {
+        return -NLE_BAD_SOCK;
+    }
+    return rtnl_link_change(_sock, orig, changes, 0);
+}
+
+QString SocketCanNetlink::errorStr(int err)
+{
+    return QString(nl_geterror(err));
+}
+
+void SocketCanNetlink::onEventsReadable()
+{
+    // non-blocking, so this returns once everything queued is processed
+    nl_recvmsgs_default(_events);
+}
+
+int SocketCanNetlink::eventCallback(struct nl_msg *msg, void *arg)
+{
+    SocketCanNetlink *self = (SocketCanNetlink *)arg;
+    struct nlmsghdr *hdr = nlmsg_hdr(msg);
+
+    if ((hdr->nlmsg_type == RTM_NEWLINK) || (hdr->nlmsg_type == RTM_DELLINK)) {
+        struct ifinfomsg *ifi = (struct ifinfomsg *)nlmsg_data(hdr);
+        emit self->linkChanged(ifi->ifi_index);
+    }
+
+    return NL_OK;
+}
@@ -0,0 +1,75 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QString>
+
+struct nl_sock;
+struct nl_msg;
+struct nl_cache;
+struct rtnl_link;
+class QSocketNotifier;
+
+/*
+ * Netlink route sockets shared by all SocketCAN interfaces.
+ *
+ * One socket is kept connected for requests (link dumps, per-link queries
+ * for statistics, link configuration), so none of these need a new socket
+ * or an external process. A second socket is subscribed to RTNLGRP_LINK;
+ * the kernel pushes link changes (up/down, carrier loss on bus-off,
+ * restarts) to it, and linkChanged() is emitted from the event loop.
+ */
+class SocketCanNetlink : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SocketCanNetlink(QObject *parent=0);
+    virtual ~SocketCanNetlink();
+
+    // all links of the system; free with nl_cache_free(), 0 on error
+    struct nl_cache *allocLinkCache();
+
+    // current state of one link with a single RTM_GETLINK; release with rtnl_link_put(), 0 on error
+    struct rtnl_link *getLink(int ifindex);
+
+    // apply changes to orig (see rtnl_link_change()); returns 0 or a negative libnl error code
+    int changeLink(struct rtnl_link *orig, struct rtnl_link *changes);
+
+    static QString errorStr(int err);
+
+signals:
+    void linkChanged(int ifindex);
+
+private slots:
+    void onEventsReadable();
+
+private:
+    QMutex _mutex;
+    struct nl_sock *_sock;
+    struct nl_sock *_events;
+    QSocketNotifier *_notifier;
+
+    static int eventCallback(struct nl_msg *msg, void *arg);
+};
@@ -0,0 +1,162 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SocketCanReactor.h"
+#include "SocketCanInterface.h"
+
+#include <QThread>
+
+#include <core/Backend.h>
+#include <driver/CanListener.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+static const uint32_t wakeup_token = 0xFFFFFFFF;
+
+SocketCanReactor::SocketCanReactor(QObject *parent)
+  : QObject(parent),
+    _openComplete(0),
+    _rxBatch(batch_size)
+{
+    _thread = new QThread();
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        log_error(QString("epoll_create1 failed: %1").arg(strerror(errno)));
+    }
+
+    _wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_wakeup_fd < 0) {
+        log_error(QString("eventfd failed: %1").arg(strerror(errno)));
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = wakeup_token;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &ev);
+}
+
+SocketCanReactor::~SocketCanReactor()
+{
+    if (_wakeup_fd >= 0) {
+        ::close(_wakeup_fd);
+    }
+    if (_epoll_fd >= 0) {
+        ::close(_epoll_fd);
+    }
+    delete _thread;
+}
+
+void SocketCanReactor::addListener(CanListener *listener, SocketCanInterface *intf)
+{
+    Entry entry;
+    entry.listener = listener;
+    entry.intf = intf;
+    _entries.append(entry);
+}
+
+void SocketCanReactor::run()
+{
+    // Note: open and close done from run() so all socket operations take place in this thread
+    for (int i=0; i<_entries.size(); i++) {
+        SocketCanInterface *intf = _entries[i].intf;
+        intf->open();
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if ((intf->getFd() < 0) || (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, intf->getFd(), &ev) < 0)) {
+            log_error(QString("%1: cannot add socket to I/O thread").arg(intf->getName()));
+        }
+    }
+    _openComplete.storeRelease(1);
+
+    struct epoll_event events[max_events];
+    bool running = (_epoll_fd >= 0) && (_wakeup_fd >= 0);
+    while (running) {
+        int n = epoll_wait(_epoll_fd, events, max_events, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error(QString("epoll_wait failed: %1").arg(strerror(errno)));
+            break;
+        }
+
+        // one batch per ready socket and round; level triggering brings us back for the rest,
+        // so a single busy bus cannot starve the others
+        for (int i=0; i<n; i++) {
+            uint32_t token = events[i].data.u32;
+            if (token == wakeup_token) {
+                running = false;
+                continue;
+            }
+
+            Entry &entry = _entries[token];
+            _rxBatch.clear();
+            if (entry.intf->readAvailableMessages(_rxBatch)) {
+                entry.listener->pushBatch(_rxBatch);
+            }
+        }
+    }
+
+    for (int i=0; i<_entries.size(); i++) {
+        SocketCanInterface *intf = _entries[i].intf;
+        if (intf->getFd() >= 0) {
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, intf->getFd(), 0);
+        }
+        intf->close();
+    }
+    _thread->quit();
+}
+
+void SocketCanReactor::startThread()
+{
+    moveToThread(_thread);
+    connect(_thread, SIGNAL(started()), this, SLOT(run()));
+    _thread->start();
+
+    // Wait for interfaces to be open before returning so that beginMeasurement is emitted after interface open
+    while (!_openComplete.loadAcquire()) {
+        QThread::usleep(250);
+    }
+}
+
+void SocketCanReactor::requestStop()
+{
+    uint64_t one = 1;
+    if (::write(_wakeup_fd, &one, sizeof(one)) != sizeof(one)) {
+        log_error(QString("cannot wake up I/O thread: %1").arg(strerror(errno)));
+    }
+}
+
+void SocketCanReactor::waitFinish()
+{
+    requestStop();
+    _thread->wait();
+}
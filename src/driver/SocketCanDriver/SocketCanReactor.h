@@ -0,0 +1,75 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QAtomicInt>
+#include <driver/CanMessageBatch.h>
+
+class QThread;
+class CanListener;
+class SocketCanInterface;
+
+/*
+ * Single I/O thread serving all SocketCAN interfaces of a measurement.
+ *
+ * Instead of one blocking thread per interface, every socket is registered
+ * with one epoll instance; ready sockets are drained in batches into their
+ * listener's ingest ring. Stopping writes to an eventfd, so the thread
+ * leaves epoll_wait() immediately instead of waiting for a timeout.
+ */
+class SocketCanReactor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SocketCanReactor(QObject *parent=0);
+    virtual ~SocketCanReactor();
+
+    void addListener(CanListener *listener, SocketCanInterface *intf);
+
+public slots:
+    void run();
+
+    void startThread();
+    void requestStop();
+    void waitFinish();
+
+private:
+    enum {
+        batch_size = 256,
+        max_events = 16
+    };
+
+    struct Entry {
+        CanListener *listener;
+        SocketCanInterface *intf;
+    };
+
+    QThread *_thread;
+    QList<Entry> _entries;
+    int _epoll_fd;
+    int _wakeup_fd;
+    QAtomicInt _openComplete;
+    CanMessageBatch _rxBatch;
+};
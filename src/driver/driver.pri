@@ -1,15 +1,19 @@
 SOURCES += \
     $$PWD/CanInterface.cpp \
     $$PWD/CanListener.cpp \
+    $$PWD/CanMessageBatch.cpp \
     $$PWD/CanDriver.cpp \
     $$PWD/CanTiming.cpp \
+    $$PWD/DefaultDrivers.cpp \
     $$PWD/GenericCanSetupPage.cpp
 
 HEADERS  += \
     $$PWD/CanInterface.h \
     $$PWD/CanListener.h \
+    $$PWD/CanMessageBatch.h \
     $$PWD/CanDriver.h \
     $$PWD/CanTiming.h \
+    $$PWD/DefaultDrivers.h \
     $$PWD/GenericCanSetupPage.h
 
 FORMS += \
@@ -31,6 +31,10 @@
 
 #include <core/MeasurementSetup.h>
 #include <core/CanTrace.h>
+#include <core/CanReplay.h>
+#include <driver/CanInterface.h>
+#include <driver/DefaultDrivers.h>
+#include <publish/TracePublisher.h>
 #include <window/TraceWindow/TraceWindow.h>
 #include <window/SetupDialog/SetupDialog.h>
 #include <window/LogWindow/LogWindow.h>
@@ -39,18 +43,10 @@
 #include <window/RawTxWindow/RawTxWindow.h>
 #include <window/CanCfgWindow/CanCfgWindow.h>
 
-#include <driver/SLCANDriver/SLCANDriver.h>
-#include <driver/CANBlastDriver/CANBlasterDriver.h>
-
-#if defined(__linux__)
-#include <driver/SocketCanDriver/SocketCanDriver.h>
-#else
-#include <driver/CandleApiDriver/CandleApiDriver.h>
-#endif
-
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    _publisher(new TracePublisher(*Backend::instance().getTrace()))
 {
     ui->setupUi(this);
     _baseWindowTitle = windowTitle();
@@ -69,6 +65,19 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionStart_Measurement, SIGNAL(triggered()), this, SLOT(startMeasurement()));
     connect(ui->actionStop_Measurement, SIGNAL(triggered()), this, SLOT(stopMeasurement()));
 
+    addDefaultDrivers(backend());
+
+    ui->actionShared_IO_Thread->setVisible(backend().hasSharedIoThread());
+    ui->actionShared_IO_Thread->setChecked(backend().useSharedIoThread());
+    connect(ui->actionShared_IO_Thread, SIGNAL(toggled(bool)), this, SLOT(setUseSharedIoThread(bool)));
+    connect(ui->actionStream_Tcp, SIGNAL(toggled(bool)), this, SLOT(setStreaming(bool)));
+    connect(ui->actionStream_Multicast, SIGNAL(toggled(bool)), this, SLOT(setStreaming(bool)));
+    connect(ui->actionStream_Lan, SIGNAL(toggled(bool)), this, SLOT(setStreaming(bool)));
+    ui->actionPublish_Shm->setVisible(TracePublisher::hasShmPublishing());
+    connect(ui->actionPublish_Shm, SIGNAL(toggled(bool)), this, SLOT(setShmPublishing(bool)));
+    connect(ui->actionReplay_Trace, SIGNAL(toggled(bool)), this, SLOT(setReplay(bool)));
+    connect(&backend(), SIGNAL(replayFinished()), this, SLOT(replayFinished()));
+
     connect(&backend(), SIGNAL(beginMeasurement()), this, SLOT(updateMeasurementActions()));
     connect(&backend(), SIGNAL(endMeasurement()), this, SLOT(updateMeasurementActions()));
     updateMeasurementActions();
@@ -77,14 +86,6 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(showAboutDialog()));
 
 
-#if defined(__linux__)
-    Backend::instance().addCanDriver(*(new SocketCanDriver(Backend::instance())));
-#else
-    Backend::instance().addCanDriver(*(new CandleApiDriver(Backend::instance())));
-#endif
-    Backend::instance().addCanDriver(*(new SLCANDriver(Backend::instance())));
-//    Backend::instance().addCanDriver(*(new CANBlasterDriver(Backend::instance())));
-
     setWorkspaceModified(false);
     newWorkspace();
 
@@ -94,6 +95,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    delete _publisher;
     delete ui;
 }
 
@@ -102,6 +104,60 @@ void MainWindow::updateMeasurementActions()
     bool running = backend().isMeasurementRunning();
     ui->actionStart_Measurement->setEnabled(!running);
     ui->actionStop_Measurement->setEnabled(running);
+    ui->actionShared_IO_Thread->setEnabled(!running);
+    ui->actionReplay_Trace->setEnabled(running);
+    if (!running) {
+        ui->actionReplay_Trace->setChecked(false);
+    }
+}
+
+void MainWindow::setUseSharedIoThread(bool use)
+{
+    backend().setUseSharedIoThread(use);
+}
+
+void MainWindow::setStreaming(bool enable)
+{
+    (void) enable;
+    _publisher->setStreaming(ui->actionStream_Tcp->isChecked(), ui->actionStream_Multicast->isChecked(), ui->actionStream_Lan->isChecked());
+}
+
+void MainWindow::setShmPublishing(bool enable)
+{
+    _publisher->setShmPublishing(enable);
+    if (enable && !_publisher->isShmPublishing()) {
+        ui->actionPublish_Shm->setChecked(false);
+    }
+}
+
+void MainWindow::setReplay(bool enable)
+{
+    if (!enable) {
+        backend().stopReplay();
+        return;
+    }
+    if (backend().isReplaying()) {
+        return;
+    }
+
+    // play the trace as recorded: same interfaces, same timing
+    CanReplay *replay = new CanReplay();
+    replay->setFramesFromTrace(*backend().getTrace());
+    foreach (CanInterfaceId id, backend().getInterfaceList()) {
+        CanInterface *intf = backend().getInterfaceById(id);
+        if (intf && intf->isOpen()) {
+            replay->mapChannel(id, intf);
+        }
+    }
+
+    if (!backend().startReplay(replay)) {
+        ui->actionReplay_Trace->setChecked(false);
+    }
+}
+
+void MainWindow::replayFinished()
+{
+    ui->actionReplay_Trace->setChecked(false);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
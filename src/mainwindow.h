@@ -41,6 +41,7 @@ class MainWindow;
 
 class ConfigurableWidget;
 class SetupDialog;
+class TracePublisher;
 
 class MainWindow : public QMainWindow
 {
@@ -70,6 +71,11 @@ public slots:
     void saveTraceToFile();
 
     void updateMeasurementActions();
+    void setUseSharedIoThread(bool use);
+    void setStreaming(bool enable);
+    void setShmPublishing(bool enable);
+    void setReplay(bool enable);
+    void replayFinished();
 
 private slots:
     void on_action_WorkspaceNew_triggered();
@@ -83,6 +89,7 @@ private slots:
 private:
     Ui::MainWindow *ui;
     SetupDialog *_setupDlg;
+    TracePublisher *_publisher;
 
     bool _workspaceModified;
     QString _workspaceFileName;
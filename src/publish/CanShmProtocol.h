@@ -0,0 +1,77 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "CanStreamProtocol.h"
+
+/*
+ * Layout of the shared-memory frame ring (see CanShmRing, CanShmReader).
+ *
+ * The segment is a can_shm_header_t followed by slot_count slots. Frame n
+ * goes into slot n % slot_count, overwriting whatever was there: the
+ * writer never waits for readers, a reader that falls more than
+ * slot_count frames behind loses frames.
+ *
+ * Each slot is a seqlock. The writer sets seq to 2n+1 before it touches
+ * the slot for frame n and to 2n+2 once the frame is complete. A reader
+ * copies the slot and accepts the copy only if seq was 2n+2 both before
+ * and after the copy; anything else means the frame is not there yet or
+ * was overwritten while it was copied. Readers never write to the
+ * segment, so there is no limit on their number.
+ *
+ * The frame is a can_stream_record_t and its payload, exactly as in the
+ * live stream. Gap records are published as well.
+ *
+ * cangaroo creates a fresh segment whenever publishing is (re)started.
+ * Readers still mapping the previous one see closed set and have to
+ * reopen.
+ */
+
+#define CAN_SHM_MAGIC 0x314D4743U // "CGM1"
+#define CAN_SHM_DEFAULT_NAME "/cangaroo"
+
+enum {
+    can_shm_version = 1,
+    can_shm_default_slots = 65536
+};
+
+typedef struct {
+    uint32_t magic;       // CAN_SHM_MAGIC, written last when the segment is created
+    uint32_t version;     // can_shm_version
+    uint32_t slot_count;  // a power of two
+    uint32_t slot_size;   // sizeof(can_shm_slot_t)
+    uint32_t writer_pid;
+    std::atomic<uint32_t> closed;
+    char _pad0[64 - 6*sizeof(uint32_t)];
+
+    std::atomic<uint64_t> head; // frames written so far; on its own cache line
+    char _pad1[64 - sizeof(uint64_t)];
+} can_shm_header_t;
+
+typedef struct {
+    std::atomic<uint64_t> seq;
+    can_stream_record_t record;
+    uint8_t data[64];
+} can_shm_slot_t;
@@ -0,0 +1,205 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanShmReader.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CanShmReader::CanShmReader()
+  : _fd(-1),
+    _map(0),
+    _mapSize(0),
+    _header(0),
+    _slots(0),
+    _count(0),
+    _next(0),
+    _lost(0)
+{
+}
+
+CanShmReader::~CanShmReader()
+{
+    close();
+}
+
+bool CanShmReader::open(const char *name)
+{
+    close();
+
+#if defined(__linux__)
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(can_shm_header_t))) {
+        ::close(fd);
+        errno = EPROTO;
+        return false;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        return false;
+    }
+
+    // magic is written last, after the rest of the header
+    const can_shm_header_t *header = (const can_shm_header_t *)map;
+    bool valid = (header->magic == CAN_SHM_MAGIC);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t count = header->slot_count;
+    valid = valid
+        && (header->version == can_shm_version)
+        && (header->slot_size == sizeof(can_shm_slot_t))
+        && (count > 0) && ((count & (count - 1)) == 0)
+        && ((size_t)st.st_size >= sizeof(can_shm_header_t) + (size_t)count * sizeof(can_shm_slot_t));
+    if (!valid) {
+        munmap(map, st.st_size);
+        ::close(fd);
+        errno = EPROTO;
+        return false;
+    }
+
+    _fd = fd;
+    _map = map;
+    _mapSize = st.st_size;
+    _header = header;
+    _slots = (const can_shm_slot_t *)((const char *)map + sizeof(can_shm_header_t));
+    _count = count;
+    _next = _header->head.load(std::memory_order_acquire);
+    _lost = 0;
+    return true;
+#else
+    (void) name;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+void CanShmReader::close()
+{
+#if defined(__linux__)
+    if (_map) {
+        munmap(_map, _mapSize);
+        ::close(_fd);
+    }
+#endif
+    _fd = -1;
+    _map = 0;
+    _mapSize = 0;
+    _header = 0;
+    _slots = 0;
+    _count = 0;
+}
+
+bool CanShmReader::isOpen() const
+{
+    return _map != 0;
+}
+
+bool CanShmReader::isClosed() const
+{
+    return !_header || _header->closed.load(std::memory_order_acquire);
+}
+
+void CanShmReader::rewind()
+{
+    if (!_header) {
+        return;
+    }
+
+    // the oldest slot may be overwritten before we get to it; read() copes with that
+    uint64_t head = _header->head.load(std::memory_order_acquire);
+    _next = (head > _count) ? (head - _count) : 0;
+}
+
+bool CanShmReader::read(can_stream_record_t &record, uint8_t *data)
+{
+    if (!_header) {
+        return false;
+    }
+
+    for (;;) {
+        uint64_t head = _header->head.load(std::memory_order_acquire);
+        if (_next >= head) {
+            return false;
+        }
+        if ((head - _next) > _count) {
+            _lost += head - _count - _next;
+            _next = head - _count;
+        }
+
+        const can_shm_slot_t *slot = &_slots[_next & (_count - 1)];
+        uint64_t expect = 2*_next + 2;
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq == expect) {
+            memcpy(&record, &slot->record, sizeof(record));
+            uint8_t len = (record.len > 64) ? 64 : record.len;
+            memcpy(data, slot->data, len);
+
+            // the copy is only good if the writer did not touch the slot meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) == expect) {
+                record.len = len;
+                _next++;
+                return true;
+            }
+            seq = slot->seq.load(std::memory_order_acquire);
+        }
+
+        // The slot already holds (or is getting) frame m, a lap ahead of us,
+        // which overwrote frame m - count. Everything from there on is still
+        // intact, so skip right past it without waiting for head.
+        uint64_t m = (seq - 1) / 2;
+        if ((seq > expect) && (m + 1 >= _count + _next)) {
+            uint64_t oldest = m + 1 - _count;
+            _lost += oldest - _next;
+            _next = oldest;
+        }
+    }
+}
+
+uint64_t CanShmReader::getPosition() const
+{
+    return _next;
+}
+
+uint64_t CanShmReader::getLost() const
+{
+    return _lost;
+}
+
+uint32_t CanShmReader::getSlotCount() const
+{
+    return _count;
+}
@@ -0,0 +1,84 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "CanShmProtocol.h"
+
+/*
+ * Reader side of the shared-memory frame ring, see CanShmProtocol.h.
+ *
+ * Deliberately free of Qt: an analyzer only needs this class and the two
+ * protocol headers. Each reader keeps its own position and never writes
+ * to the segment, so any number of processes can read at once without
+ * slowing cangaroo down. A reader that falls behind by more than the ring
+ * loses the oldest frames; getLost() counts them.
+ *
+ *     CanShmReader reader;
+ *     if (reader.open()) {
+ *         can_stream_record_t rec;
+ *         uint8_t data[64];
+ *         while (!reader.isClosed()) {
+ *             while (reader.read(rec, data)) { ... }
+ *             usleep(1000);
+ *         }
+ *     }
+ */
+class CanShmReader
+{
+public:
+    CanShmReader();
+    ~CanShmReader();
+
+    // starts after the newest frame; fails with errno set, or EPROTO for a segment of another format
+    bool open(const char *name = CAN_SHM_DEFAULT_NAME);
+    void close();
+    bool isOpen() const;
+
+    // cangaroo stopped publishing to this segment; reopen to follow a new one
+    bool isClosed() const;
+
+    // continue with the oldest frame still in the ring
+    void rewind();
+
+    // copies the next frame, data must hold 64 bytes; false if there is no new frame
+    bool read(can_stream_record_t &record, uint8_t *data);
+
+    uint64_t getPosition() const;
+    uint64_t getLost() const;
+    uint32_t getSlotCount() const;
+
+private:
+    CanShmReader(const CanShmReader &);
+    CanShmReader &operator=(const CanShmReader &);
+
+    int _fd;
+    void *_map;
+    size_t _mapSize;
+    const can_shm_header_t *_header;
+    const can_shm_slot_t *_slots;
+    uint32_t _count;
+    uint64_t _next;
+    uint64_t _lost;
+};
@@ -0,0 +1,174 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanShmRing.h"
+#include <core/CanMessage.h>
+#include "CanStreamServer.h"
+
+#include <core/Backend.h>
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CanShmRing::CanShmRing()
+  : _fd(-1),
+    _map(0),
+    _mapSize(0),
+    _header(0),
+    _slots(0),
+    _mask(0),
+    _head(0)
+{
+}
+
+CanShmRing::~CanShmRing()
+{
+    destroy();
+}
+
+bool CanShmRing::isSupported()
+{
+#if defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CanShmRing::create(const QString &name, uint32_t slot_count)
+{
+    destroy();
+
+#if defined(__linux__)
+    uint32_t count = 1;
+    while (count < slot_count) {
+        count <<= 1;
+    }
+
+    QByteArray path = name.toLatin1();
+    size_t size = sizeof(can_shm_header_t) + count * sizeof(can_shm_slot_t);
+
+    // readers of a previous segment keep their mapping and see it closed
+    shm_unlink(path.constData());
+    int fd = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        log_error(QString("Cannot create shared memory %1: %2").arg(name).arg(strerror(errno)));
+        return false;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        log_error(QString("Cannot size shared memory %1: %2").arg(name).arg(strerror(errno)));
+        close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+
+    void *map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        log_error(QString("Cannot map shared memory %1: %2").arg(name).arg(strerror(errno)));
+        close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+
+    // ftruncate() zero-filled the segment, so every slot reads as never written
+    _name = name;
+    _fd = fd;
+    _map = map;
+    _mapSize = size;
+    _header = (can_shm_header_t *)map;
+    _slots = (can_shm_slot_t *)((char *)map + sizeof(can_shm_header_t));
+    _mask = count - 1;
+    _head = 0;
+
+    _header->version = can_shm_version;
+    _header->slot_count = count;
+    _header->slot_size = sizeof(can_shm_slot_t);
+    _header->writer_pid = getpid();
+    _header->closed.store(0, std::memory_order_relaxed);
+    _header->head.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _header->magic = CAN_SHM_MAGIC;
+
+    log_info(QString("Publishing frames to shared memory %1, %2 slots").arg(name).arg(count));
+    return true;
+#else
+    (void) slot_count;
+    log_error(QString("Cannot create shared memory %1: not supported on this platform").arg(name));
+    return false;
+#endif
+}
+
+void CanShmRing::destroy()
+{
+#if defined(__linux__)
+    if (!_map) {
+        return;
+    }
+
+    _header->closed.store(1, std::memory_order_release);
+    munmap(_map, _mapSize);
+    close(_fd);
+    shm_unlink(_name.toLatin1().constData());
+#endif
+
+    _fd = -1;
+    _map = 0;
+    _mapSize = 0;
+    _header = 0;
+    _slots = 0;
+}
+
+bool CanShmRing::isOpen() const
+{
+    return _map != 0;
+}
+
+QString CanShmRing::getName() const
+{
+    return _name;
+}
+
+void CanShmRing::publish(const CanMessage &msg)
+{
+    if (!_map) {
+        return;
+    }
+
+    uint64_t n = _head;
+    can_shm_slot_t *slot = &_slots[n & _mask];
+
+    // odd while the slot is inconsistent; the fence keeps the payload stores behind it
+    slot->seq.store(2*n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    CanStreamServer::encodeRecord(msg, (char *)&slot->record);
+
+    slot->seq.store(2*n + 2, std::memory_order_release);
+    _head = n + 1;
+    _header->head.store(_head, std::memory_order_release);
+}
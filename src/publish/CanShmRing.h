@@ -0,0 +1,67 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <QString>
+
+#include "CanShmProtocol.h"
+#include <core/CanTraceSink.h>
+
+class CanMessage;
+
+/*
+ * Writer side of the shared-memory frame ring, see CanShmProtocol.h.
+ *
+ * publish() only copies the frame into the mapped segment, no syscalls,
+ * no waiting for readers. There must be one writer; the trace calls it
+ * with its mutex held.
+ */
+class CanShmRing : public CanTraceSink
+{
+public:
+    CanShmRing();
+    ~CanShmRing();
+
+    static bool isSupported();
+
+    // slot_count is rounded up to a power of two
+    bool create(const QString &name, uint32_t slot_count);
+    void destroy();
+    bool isOpen() const;
+    QString getName() const;
+
+    virtual void publish(const CanMessage &msg);
+
+private:
+    Q_DISABLE_COPY(CanShmRing)
+
+    QString _name;
+    int _fd;
+    void *_map;
+    size_t _mapSize;
+    can_shm_header_t *_header;
+    can_shm_slot_t *_slots;
+    uint32_t _mask;
+    uint64_t _head;
+};
@@ -0,0 +1,82 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Wire format of the live frame stream (see CanStreamServer).
+ *
+ * Over TCP the server sends a stream of packets. Over UDP multicast each
+ * datagram carries one packet. A packet is a can_stream_header_t followed
+ * by count records. Each record is a can_stream_record_t followed by len
+ * payload bytes; there is no padding, so records are not aligned.
+ * Everything is little endian.
+ *
+ * seq is the number of the first record in the packet, counted per TCP
+ * client or for the multicast group. A multicast receiver detects lost
+ * datagrams from gaps. A TCP client does not lose records silently: frames
+ * dropped because it did not read fast enough are reported by a record
+ * with can_stream_flag_gap, whose id holds the number of frames dropped.
+ * Frame ids carry the CAN_EFF_FLAG/CAN_RTR_FLAG/CAN_ERR_FLAG bits in the
+ * SocketCAN encoding.
+ *
+ * A TCP client can send text lines to the server:
+ *   "filter <rules>"  only receive frames matching the rules, in the text
+ *                     form of CanCaptureFilter, e.g. "filter 100:700,18FEF100:1FFFFFFF"
+ *   "filter"          receive every frame again
+ */
+
+#define CAN_STREAM_MAGIC 0x31534743U // "CGS1"
+
+enum {
+    can_stream_default_tcp_port = 29536,
+    can_stream_default_udp_port = 29537,
+    can_stream_max_tcp_packet = 16384,  // header and records
+    can_stream_max_udp_packet = 1400    // fits an Ethernet frame with the IP and UDP headers
+};
+
+#define CAN_STREAM_DEFAULT_GROUP "239.255.43.22"
+
+typedef struct {
+    uint32_t magic;    // CAN_STREAM_MAGIC
+    uint32_t seq;      // number of the first record
+    uint16_t length;   // bytes of records following the header
+    uint16_t count;    // records following the header
+    uint32_t reserved;
+} can_stream_header_t;
+
+enum {
+    can_stream_flag_fd  = 0x01,
+    can_stream_flag_brs = 0x02,
+    can_stream_flag_esi = 0x04,
+    can_stream_flag_tx  = 0x08, // sent by cangaroo, not received
+    can_stream_flag_gap = 0x10  // not a frame: id frames were lost right before this record
+};
+
+typedef struct {
+    uint64_t timestamp_ns; // in the clock domain of the interface, see CanMessage::TimestampSource
+    uint32_t id;           // with CAN_EFF_FLAG/CAN_RTR_FLAG/CAN_ERR_FLAG
+    uint16_t interface;    // CanInterfaceId
+    uint8_t flags;         // can_stream_flag_*
+    uint8_t len;           // payload bytes following the record
+} can_stream_record_t;
@@ -0,0 +1,401 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanStreamServer.h"
+#include "CanStreamProtocol.h"
+#include <core/portable_endian.h>
+
+#include <core/Backend.h>
+#include <QThread>
+#include <QMetaObject>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QUdpSocket>
+
+#include <string.h>
+
+CanStreamServer::CanStreamServer(QObject *parent)
+  : QObject(parent),
+    _thread(0),
+    _ring(ring_size),
+    _flushPending(0),
+    _bindAddress(QHostAddress::LocalHost),
+    _tcpPort(can_stream_default_tcp_port),
+    _udpPort(0),
+    _server(0),
+    _udp(0)
+{
+    _thread = new QThread();
+    _multicast.packet.reserve(can_stream_max_udp_packet);
+    _multicast.seq = 0;
+    resetPacket(_multicast);
+}
+
+CanStreamServer::~CanStreamServer()
+{
+    waitFinish();
+    delete _thread;
+}
+
+void CanStreamServer::setBindAddress(const QHostAddress &address)
+{
+    _bindAddress = address;
+}
+
+void CanStreamServer::setTcpPort(quint16 port)
+{
+    _tcpPort = port;
+}
+
+void CanStreamServer::setMulticast(const QHostAddress &group, quint16 port)
+{
+    _group = group;
+    _udpPort = port;
+}
+
+void CanStreamServer::publish(const CanMessage &msg)
+{
+    // a full ring means the server thread is stuck; the frame is counted in getRingDrops()
+    _ring.push(msg);
+}
+
+void CanStreamServer::notify()
+{
+    if (_flushPending.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+    }
+}
+
+uint32_t CanStreamServer::getRingDrops() const
+{
+    return _ring.drops();
+}
+
+void CanStreamServer::startThread()
+{
+    moveToThread(_thread);
+    connect(_thread, SIGNAL(started()), this, SLOT(run()));
+    _thread->start();
+}
+
+void CanStreamServer::requestStop()
+{
+    QMetaObject::invokeMethod(this, "shutdown", Qt::QueuedConnection);
+}
+
+void CanStreamServer::waitFinish()
+{
+    if (_thread->isRunning()) {
+        requestStop();
+        _thread->wait();
+    }
+}
+
+void CanStreamServer::run()
+{
+    // sockets are created here, so they belong to the server thread
+    if (_tcpPort) {
+        _server = new QTcpServer(this);
+        connect(_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+        if (_server->listen(_bindAddress, _tcpPort)) {
+            log_info(QString("Streaming frames on TCP %1 port %2").arg(_bindAddress.toString()).arg(_tcpPort));
+        } else {
+            log_error(QString("Cannot stream frames on TCP %1 port %2: %3").arg(_bindAddress.toString()).arg(_tcpPort).arg(_server->errorString()));
+        }
+    }
+
+    if (_udpPort) {
+        // TTL 0 keeps the datagrams on this host, 1 on the local network
+        bool local = _bindAddress.isLoopback();
+        _udp = new QUdpSocket(this);
+        _udp->setSocketOption(QAbstractSocket::MulticastTtlOption, local ? 0 : 1);
+        log_info(QString("Streaming frames to %1:%2%3").arg(_group.toString()).arg(_udpPort).arg(local ? " (this host only)" : ""));
+    }
+}
+
+void CanStreamServer::shutdown()
+{
+    flush();
+
+    foreach (Client *client, _clients) {
+        client->socket->disconnect(this);
+        client->socket->flush();
+        client->socket->close();
+        delete client->socket;
+        delete client;
+    }
+    _clients.clear();
+
+    delete _server;
+    _server = 0;
+    delete _udp;
+    _udp = 0;
+
+    _thread->quit();
+}
+
+void CanStreamServer::onNewConnection()
+{
+    while (_server->hasPendingConnections()) {
+        QTcpSocket *socket = _server->nextPendingConnection();
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+        Client *client = new Client();
+        client->socket = socket;
+        client->out.packet.reserve(can_stream_max_tcp_packet);
+        client->out.seq = 0;
+        resetPacket(client->out);
+        client->dropped = 0;
+        client->dropped_total = 0;
+        _clients.append(client);
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onClientReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
+        log_info(QString("Stream client connected: %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()));
+    }
+}
+
+CanStreamServer::Client *CanStreamServer::findClient(QObject *socket)
+{
+    foreach (Client *client, _clients) {
+        if (client->socket == socket) {
+            return client;
+        }
+    }
+    return 0;
+}
+
+void CanStreamServer::onClientDisconnected()
+{
+    Client *client = findClient(sender());
+    if (!client) {
+        return;
+    }
+
+    log_info(QString("Stream client disconnected: %1:%2, %3 frames dropped")
+        .arg(client->socket->peerAddress().toString())
+        .arg(client->socket->peerPort())
+        .arg((unsigned long long)client->dropped_total));
+    _clients.removeOne(client);
+    client->socket->deleteLater();
+    delete client;
+}
+
+void CanStreamServer::onClientReadyRead()
+{
+    Client *client = findClient(sender());
+    if (!client) {
+        return;
+    }
+
+    client->command.append(client->socket->readAll());
+    int eol;
+    while ((eol = client->command.indexOf('\n')) >= 0) {
+        handleCommand(client, client->command.left(eol).trimmed());
+        client->command.remove(0, eol + 1);
+    }
+
+    // commands are short; anything else is not talking our protocol
+    if (client->command.size() > 4096) {
+        client->command.clear();
+    }
+}
+
+void CanStreamServer::handleCommand(Client *client, const QByteArray &line)
+{
+    if (line.isEmpty()) {
+        return;
+    }
+
+    if (line == "filter") {
+        client->filter.clear();
+        return;
+    }
+
+    if (line.startsWith("filter ")) {
+        CanCaptureFilter filter;
+        if (filter.fromString(QString::fromLatin1(line.mid(7)))) {
+            client->filter = filter;
+        } else {
+            log_warning(QString("Stream client %1: invalid filter \"%2\"")
+                .arg(client->socket->peerAddress().toString())
+                .arg(QString::fromLatin1(line.mid(7))));
+        }
+        return;
+    }
+
+    log_warning(QString("Stream client %1: unknown command \"%2\"")
+        .arg(client->socket->peerAddress().toString())
+        .arg(QString::fromLatin1(line)));
+}
+
+int CanStreamServer::encodeRecord(const CanMessage &msg, char *out)
+{
+    can_stream_record_t rec;
+    uint32_t id = msg.getId();
+    uint8_t flags = 0;
+    uint8_t len = msg.getLength();
+
+    if (msg.isGapMarker()) {
+        flags |= can_stream_flag_gap;
+        len = 0;
+    } else {
+        id &= CanCaptureFilter::mask_id_ext;
+        if (msg.isExtended()) { id |= CanCaptureFilter::flag_extended; }
+        if (msg.isRTR()) { id |= CanCaptureFilter::flag_rtr; }
+        if (msg.isErrorFrame()) { id |= CanCaptureFilter::flag_error; }
+        if (msg.isFD()) { flags |= can_stream_flag_fd; }
+        if (msg.isBRS()) { flags |= can_stream_flag_brs; }
+        if (msg.isESI()) { flags |= can_stream_flag_esi; }
+        if (len > 64) { len = 64; }
+    }
+    if (msg.direction() == CanMessage::Tx) {
+        flags |= can_stream_flag_tx;
+    }
+
+    rec.timestamp_ns = htole64(msg.getTimestampNs());
+    rec.id = htole32(id);
+    rec.interface = htole16(msg.getInterfaceId());
+    rec.flags = flags;
+    rec.len = len;
+    memcpy(out, &rec, sizeof(rec));
+
+    for (int i=0; i<len; i++) {
+        out[sizeof(rec) + i] = msg.getByte(i);
+    }
+    return sizeof(rec) + len;
+}
+
+int CanStreamServer::encodeGapRecord(uint64_t dropped, uint64_t timestamp_ns, char *out)
+{
+    can_stream_record_t rec;
+    rec.timestamp_ns = htole64(timestamp_ns);
+    rec.id = htole32((dropped > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)dropped);
+    rec.interface = 0;
+    rec.flags = can_stream_flag_gap;
+    rec.len = 0;
+    memcpy(out, &rec, sizeof(rec));
+    return sizeof(rec);
+}
+
+void CanStreamServer::resetPacket(Destination &dst)
+{
+    // the header is filled in when the packet is sent
+    dst.packet.resize(sizeof(can_stream_header_t));
+    dst.count = 0;
+}
+
+bool CanStreamServer::appendRecord(Destination &dst, const char *record, int len, int max_packet)
+{
+    if ((dst.packet.size() + len) > max_packet) {
+        return false;
+    }
+    dst.packet.append(record, len);
+    dst.count++;
+    return true;
+}
+
+static void finishPacket(QByteArray &packet, uint32_t seq, uint16_t count)
+{
+    can_stream_header_t hdr;
+    hdr.magic = htole32(CAN_STREAM_MAGIC);
+    hdr.seq = htole32(seq);
+    hdr.length = htole16(packet.size() - sizeof(hdr));
+    hdr.count = htole16(count);
+    hdr.reserved = 0;
+    memcpy(packet.data(), &hdr, sizeof(hdr));
+}
+
+void CanStreamServer::sendToClient(Client *client)
+{
+    finishPacket(client->out.packet, client->out.seq, client->out.count);
+    client->socket->write(client->out.packet);
+    client->out.seq += client->out.count;
+    resetPacket(client->out);
+}
+
+void CanStreamServer::sendMulticast()
+{
+    finishPacket(_multicast.packet, _multicast.seq, _multicast.count);
+    _udp->writeDatagram(_multicast.packet, _group, _udpPort);
+    _multicast.seq += _multicast.count;
+    resetPacket(_multicast);
+}
+
+void CanStreamServer::flush()
+{
+    _flushPending.storeRelease(0);
+
+    char record[sizeof(can_stream_record_t) + 64];
+    char gap[sizeof(can_stream_record_t)];
+
+    // only what is there now, new frames come with the next notify()
+    uint32_t pending = _ring.available();
+    while (pending--) {
+        const CanMessage &msg = _ring.front();
+        int len = encodeRecord(msg, record);
+
+        foreach (Client *client, _clients) {
+            if (!client->filter.isEmpty() && !client->filter.matches(msg)) {
+                continue;
+            }
+
+            // the socket buffer is the client's queue; past its limit the client loses frames instead of the server growing
+            qint64 queued = client->socket->bytesToWrite() + client->out.packet.size();
+            if ((queued + len + (int)sizeof(can_stream_record_t)) > client_queue_limit) {
+                client->dropped++;
+                client->dropped_total++;
+                continue;
+            }
+
+            if (client->dropped) {
+                int gap_len = encodeGapRecord(client->dropped, msg.getTimestampNs(), gap);
+                if (!appendRecord(client->out, gap, gap_len, can_stream_max_tcp_packet)) {
+                    sendToClient(client);
+                    appendRecord(client->out, gap, gap_len, can_stream_max_tcp_packet);
+                }
+                client->dropped = 0;
+            }
+
+            if (!appendRecord(client->out, record, len, can_stream_max_tcp_packet)) {
+                sendToClient(client);
+                appendRecord(client->out, record, len, can_stream_max_tcp_packet);
+            }
+        }
+
+        if (_udp && !appendRecord(_multicast, record, len, can_stream_max_udp_packet)) {
+            sendMulticast();
+            appendRecord(_multicast, record, len, can_stream_max_udp_packet);
+        }
+
+        _ring.pop();
+    }
+
+    // whatever is left goes out now; batching is per flush, not per timer
+    foreach (Client *client, _clients) {
+        if (client->out.count) {
+            sendToClient(client);
+        }
+    }
+    if (_udp && _multicast.count) {
+        sendMulticast();
+    }
+}
@@ -0,0 +1,138 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QtNetwork/QHostAddress>
+
+#include <core/CanMessage.h>
+#include <core/CanCaptureFilter.h>
+#include <core/SpscRing.h>
+#include <core/CanTraceSink.h>
+
+class QThread;
+class QTcpServer;
+class QTcpSocket;
+class QUdpSocket;
+
+/*
+ * Streams every frame that enters the trace to network consumers, see
+ * CanStreamProtocol.h for the wire format.
+ *
+ * The trace publishes frames into a ring and calls notify(). The server
+ * runs its own thread with an event loop. That thread drains the ring,
+ * encodes each frame once and batches the record into a packet per
+ * destination:
+ *  - every TCP client whose filter it matches;
+ *  - the multicast group, if enabled.
+ * Each client has a bounded queue: its socket's pending bytes plus the
+ * packet being built. A client that falls behind loses frames, not
+ * memory, and gets a gap record when it catches up. Other clients and the
+ * trace are not held up.
+ *
+ * There is no authentication, so by default the stream stays on this
+ * host. The TCP server listens on the loopback address, and multicast
+ * goes out with a TTL of 0. Binding to another address opens both to the
+ * network.
+ */
+class CanStreamServer : public QObject, public CanTraceSink
+{
+    Q_OBJECT
+
+public:
+    explicit CanStreamServer(QObject *parent=0);
+    virtual ~CanStreamServer();
+
+    // before startThread(); port 0 disables a mode
+    void setBindAddress(const QHostAddress &address);
+    void setTcpPort(quint16 port);
+    void setMulticast(const QHostAddress &group, quint16 port);
+
+    // producer side; one thread at a time, the trace calls it with its mutex held
+    virtual void publish(const CanMessage &msg);
+    virtual void notify();
+
+    uint32_t getRingDrops() const;
+
+    // writes a can_stream_record_t and the payload to out (up to 80 bytes), returns the bytes written
+    static int encodeRecord(const CanMessage &msg, char *out);
+
+public slots:
+    void startThread();
+    void requestStop();
+    void waitFinish();
+
+private slots:
+    void run();
+    void flush();
+    void shutdown();
+    void onNewConnection();
+    void onClientReadyRead();
+    void onClientDisconnected();
+
+private:
+    enum {
+        ring_size = 65536,            // frames; the trace hands them over every 100 ms
+        client_queue_limit = 4194304  // bytes per client
+    };
+
+    struct Destination {
+        QByteArray packet;   // header placeholder and the records since the last send
+        uint16_t count;
+        uint32_t seq;
+    };
+
+    struct Client {
+        QTcpSocket *socket;
+        CanCaptureFilter filter;
+        Destination out;
+        uint64_t dropped;       // frames not queued since the last gap record
+        uint64_t dropped_total;
+        QByteArray command;     // partial command line
+    };
+
+    QThread *_thread;
+    SpscRing<CanMessage> _ring;
+    QAtomicInt _flushPending;
+
+    QHostAddress _bindAddress;
+    quint16 _tcpPort;
+    QHostAddress _group;
+    quint16 _udpPort;
+
+    // server thread only
+    QTcpServer *_server;
+    QList<Client*> _clients;
+    QUdpSocket *_udp;
+    Destination _multicast;
+
+    static int encodeGapRecord(uint64_t dropped, uint64_t timestamp_ns, char *out);
+    static void resetPacket(Destination &dst);
+    static bool appendRecord(Destination &dst, const char *record, int len, int max_packet);
+    void sendToClient(Client *client);
+    void sendMulticast();
+    void handleCommand(Client *client, const QByteArray &line);
+    Client *findClient(QObject *socket);
+};
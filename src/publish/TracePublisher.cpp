@@ -0,0 +1,99 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TracePublisher.h"
+#include "CanStreamServer.h"
+#include "CanStreamProtocol.h"
+#include "CanShmRing.h"
+
+#include <core/CanTrace.h>
+
+TracePublisher::TracePublisher(CanTrace &trace)
+  : _trace(trace),
+    _streamServer(0),
+    _shmRing(0)
+{
+}
+
+TracePublisher::~TracePublisher()
+{
+    setStreaming(false, false);
+    setShmPublishing(false);
+}
+
+void TracePublisher::setStreaming(bool tcp, bool multicast, bool lan)
+{
+    if (_streamServer) {
+        _trace.removeSink(_streamServer);
+        _streamServer->waitFinish();
+        delete _streamServer;
+        _streamServer = 0;
+    }
+
+    if (!tcp && !multicast) {
+        return;
+    }
+
+    _streamServer = new CanStreamServer();
+    _streamServer->setBindAddress(lan ? QHostAddress(QHostAddress::Any) : QHostAddress(QHostAddress::LocalHost));
+    _streamServer->setTcpPort(tcp ? can_stream_default_tcp_port : 0);
+    if (multicast) {
+        _streamServer->setMulticast(QHostAddress(CAN_STREAM_DEFAULT_GROUP), can_stream_default_udp_port);
+    }
+    _streamServer->startThread();
+    _trace.addSink(_streamServer);
+}
+
+bool TracePublisher::isStreaming() const
+{
+    return _streamServer != 0;
+}
+
+bool TracePublisher::hasShmPublishing()
+{
+    return CanShmRing::isSupported();
+}
+
+void TracePublisher::setShmPublishing(bool enable)
+{
+    if (_shmRing) {
+        _trace.removeSink(_shmRing);
+        delete _shmRing;
+        _shmRing = 0;
+    }
+
+    if (!enable) {
+        return;
+    }
+
+    _shmRing = new CanShmRing();
+    if (!_shmRing->create(CAN_SHM_DEFAULT_NAME, can_shm_default_slots)) {
+        delete _shmRing;
+        _shmRing = 0;
+        return;
+    }
+    _trace.addSink(_shmRing);
+}
+
+bool TracePublisher::isShmPublishing() const
+{
+    return _shmRing != 0;
+}
@@ -0,0 +1,54 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+class CanTrace;
+class CanStreamServer;
+class CanShmRing;
+
+/*
+ * Hands every frame entering a trace to consumers outside cangaroo:
+ * TCP clients and a UDP multicast group (CanStreamServer), and a POSIX
+ * shared-memory ring (CanShmRing). Each of them is a sink of the trace
+ * while it is enabled.
+ */
+class TracePublisher
+{
+public:
+    explicit TracePublisher(CanTrace &trace);
+    ~TracePublisher();
+
+    // Stream over TCP and/or UDP multicast. Changing the modes restarts the server, and
+    // clients reconnect. Unless lan is set, the streams stay on this host (see CanStreamServer).
+    void setStreaming(bool tcp, bool multicast, bool lan=false);
+    bool isStreaming() const;
+
+    // shared-memory ring at CAN_SHM_DEFAULT_NAME (see CanShmProtocol.h)
+    static bool hasShmPublishing();
+    void setShmPublishing(bool enable);
+    bool isShmPublishing() const;
+
+private:
+    CanTrace &_trace;
+    CanStreamServer *_streamServer;
+    CanShmRing *_shmRing;
+};
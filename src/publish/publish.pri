@@ -0,0 +1,19 @@
+# frames leaving cangaroo: TCP/UDP multicast streaming and a shared-memory ring
+QT += network
+
+SOURCES += \
+    $$PWD/TracePublisher.cpp \
+    $$PWD/CanStreamServer.cpp \
+    $$PWD/CanShmRing.cpp \
+    $$PWD/CanShmReader.cpp
+
+HEADERS += \
+    $$PWD/TracePublisher.h \
+    $$PWD/CanStreamProtocol.h \
+    $$PWD/CanStreamServer.h \
+    $$PWD/CanShmProtocol.h \
+    $$PWD/CanShmRing.h \
+    $$PWD/CanShmReader.h
+
+# shm_open() lives in librt before glibc 2.34
+unix:LIBS += -lrt
@@ -30,6 +30,7 @@ FORMS    += mainwindow.ui
 RESOURCES = cangaroo.qrc
 
 include($$PWD/core/core.pri)
+include($$PWD/publish/publish.pri)
 include($$PWD/driver/driver.pri)
 include($$PWD/parser/dbc/dbc.pri)
 include($$PWD/window/TraceWindow/TraceWindow.pri)
@@ -0,0 +1,219 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Loopback sender for the CANblaster receive path.
+ *
+ * Announces itself the way a CANblaster server does, so the driver's
+ * scan finds it, and then sends batch datagrams (canblaster_batch_header_t
+ * followed by mixed can_frame and canfd_frame records) to the port the
+ * interface listens on. With -g, every n-th datagram is counted but not
+ * sent; the interface must report exactly the frames withheld as lost,
+ * and one gap marker per withheld datagram.
+ *
+ * Frame k of the stream has id k & 0x7FF; odd frames are CAN FD with BRS
+ * and 64 bytes, even ones classic with 8 bytes, all bytes set to k & 0xFF.
+ */
+
+#include <driver/CANBlastDriver/CANBlasterInterface.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// where CANBlasterDriver listens for announcements and CANBlasterInterface for frames
+#define BLAST_DISCOVERY_GROUP "239.255.43.21"
+#define BLAST_DISCOVERY_PORT 20000
+#define BLAST_DATA_PORT 20001
+
+// longest datagram the interface accepts
+#define BLAST_MAX_DATAGRAM 9216
+
+static const char announcement[] = "{\"protocol\": \"CANblaster\", \"version\": 1}";
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-h host] [-d datagrams] [-f frames] [-g n] [-r rate] [-a seconds]\n"
+        "  -h host       address of the receiving cangaroo (127.0.0.1)\n"
+        "  -d datagrams  number of datagrams to send (100000)\n"
+        "  -f frames     frames per datagram, 1 to %d (16)\n"
+        "  -g n          withhold every n-th datagram, 0 for none (0)\n"
+        "  -r rate       datagrams per second, 0 for as fast as possible (0)\n"
+        "  -a seconds    announce for this long before sending, so a scan finds us (3)\n",
+        argv0, (int)((BLAST_MAX_DATAGRAM - sizeof(canblaster_batch_header_t)) / CANFD_MTU));
+}
+
+static void announce(int sock, double seconds)
+{
+    struct sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(BLAST_DISCOVERY_PORT);
+    inet_pton(AF_INET, BLAST_DISCOVERY_GROUP, &group.sin_addr);
+
+    printf("announcing for %.0f s; scan for CANblaster interfaces now\n", seconds);
+    fflush(stdout);
+    double end = now() + seconds;
+    while (now() < end) {
+        if (sendto(sock, announcement, strlen(announcement), 0, (struct sockaddr *)&group, sizeof(group)) < 0) {
+            perror("announce");
+        }
+        usleep(250000);
+    }
+}
+
+static int buildDatagram(char *buf, uint32_t seq, int frames)
+{
+    canblaster_batch_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = CANBLASTER_BATCH_MAGIC;
+    hdr.seq = seq;
+    hdr.count = frames;
+    memcpy(buf, &hdr, sizeof(hdr));
+
+    int pos = sizeof(hdr);
+    for (int i=0; i<frames; i++) {
+        uint32_t k = seq + i;
+        struct canfd_frame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.can_id = k & CAN_SFF_MASK;
+        if (k & 1) {
+            frame.len = 64;
+            frame.flags = CANFD_FDF | CANFD_BRS;
+            memset(frame.data, k & 0xFF, frame.len);
+            memcpy(buf + pos, &frame, CANFD_MTU);
+            pos += CANFD_MTU;
+        } else {
+            frame.len = 8;
+            memset(frame.data, k & 0xFF, frame.len);
+            memcpy(buf + pos, &frame, CAN_MTU);
+            pos += CAN_MTU;
+        }
+    }
+    return pos;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = "127.0.0.1";
+    long datagrams = 100000;
+    int frames = 16;
+    long gap_every = 0;
+    double rate = 0;
+    double announce_s = 3;
+
+    int max_frames = (BLAST_MAX_DATAGRAM - sizeof(canblaster_batch_header_t)) / CANFD_MTU;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:d:f:g:r:a:")) != -1) {
+        switch (opt) {
+            case 'h': host = optarg; break;
+            case 'd': datagrams = atol(optarg); break;
+            case 'f': frames = atoi(optarg); break;
+            case 'g': gap_every = atol(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'a': announce_s = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if ((frames < 1) || (frames > max_frames) || (datagrams < 1) || (gap_every < 0) || (rate < 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(BLAST_DATA_PORT);
+    if (inet_pton(AF_INET, host, &dest.sin_addr) != 1) {
+        fprintf(stderr, "%s: not an IPv4 address\n", host);
+        return 2;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    if (announce_s > 0) {
+        announce(sock, announce_s);
+    }
+
+    static char buf[BLAST_MAX_DATAGRAM];
+    uint32_t seq = 0;
+    uint64_t sent_frames = 0, withheld_frames = 0, withheld_datagrams = 0, retries = 0;
+    double start = now();
+    for (long d=0; d<datagrams; d++) {
+        int len = buildDatagram(buf, seq, frames);
+        seq += frames;
+
+        // the last datagram always goes out; a gap shows only when a later frame arrives
+        if (gap_every && ((d % gap_every) == (gap_every - 1)) && (d != (datagrams - 1))) {
+            withheld_frames += frames;
+            withheld_datagrams++;
+            continue;
+        }
+
+        while (sendto(sock, buf, len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            if ((errno != ENOBUFS) && (errno != EAGAIN)) {
+                perror("sendto");
+                close(sock);
+                return 1;
+            }
+            retries++;
+            usleep(10);
+        }
+        sent_frames += frames;
+
+        if (rate > 0) {
+            double due = start + (d + 1) / rate;
+            double wait = due - now();
+            if (wait > 0) {
+                usleep(wait * 1e6);
+            }
+        }
+    }
+    double elapsed = now() - start;
+    close(sock);
+
+    printf("sent %llu frames in %ld datagrams in %.3f s, %.0f frames/s\n",
+        (unsigned long long)sent_frames, datagrams - (long)withheld_datagrams, elapsed, sent_frames / elapsed);
+    printf("withheld %llu frames in %llu datagrams; the interface should report as many lost\n",
+        (unsigned long long)withheld_frames, (unsigned long long)withheld_datagrams);
+    if (retries) {
+        printf("%llu sends retried on a full socket buffer\n", (unsigned long long)retries);
+    }
+    return 0;
+}
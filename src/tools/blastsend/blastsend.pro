@@ -0,0 +1,20 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Loopback sender of CANblaster batch datagrams, with optional sequence
+# gaps, to test the CANblaster receive path; see blastsend.cpp.
+
+# only the datagram format is used from the driver header
+QT = core network
+TARGET = cangaroo-blast-send
+TEMPLATE = app
+CONFIG += console warn_on c++11
+CONFIG -= app_bundle
+
+SRC = $$clean_path($$PWD/../..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../../bin
+MOC_DIR = ../../../build/tools/blastsend/moc
+OBJECTS_DIR = ../../../build/tools/blastsend/o
+
+SOURCES += $$PWD/blastsend.cpp
@@ -0,0 +1,289 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Stress test of the shared-memory frame ring (see CanShmProtocol.h).
+ *
+ * Every frame's id, interface and payload follow from its number, which
+ * travels in the timestamp. A reader can therefore verify each copy on
+ * its own: a torn read shows up as a mismatch.
+ *
+ * Two runs:
+ *  - processes: one writer and several forked readers, the last one slow
+ *    enough to be overrun. Checks that no copy is torn, that frames
+ *    arrive in order, and that read + lost frames add up.
+ *  - signal: the writer runs in a timer signal handler of the reading
+ *    process, on a ring of only a few slots. A burst of frames then often
+ *    overwrites the slot a reader is in the middle of copying, far more
+ *    often than preemption alone would manage on a few CPUs. Checks that
+ *    no torn copy is accepted.
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <publish/CanShmRing.h>
+#include <publish/CanShmReader.h>
+#include <core/CanMessage.h>
+#include <core/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+
+#define STRESS_SHM_NAME "/cangaroo-shm-stress"
+
+// a burst of 3 frames wraps a ring this small
+#define STRESS_SIGNAL_SLOTS 4
+
+// the ring reports errors through the log, which normally goes to the backend
+void log_msg(const log_level_t level, const QString msg)
+{
+    (void) level;
+    fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
+}
+void log_msg(const QDateTime dt, const log_level_t level, const QString msg) { (void) dt; log_msg(level, msg); }
+void log_debug(const QString msg) { log_msg(log_level_debug, msg); }
+void log_info(const QString msg) { log_msg(log_level_info, msg); }
+void log_warning(const QString msg) { log_msg(log_level_warning, msg); }
+void log_error(const QString msg) { log_msg(log_level_error, msg); }
+void log_critical(const QString msg) { log_msg(log_level_critical, msg); }
+void log_fatal(const QString msg) { log_msg(log_level_fatal, msg); }
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void makeFrame(uint64_t k, CanMessage &msg)
+{
+    bool fd = k & 1;
+    msg.setId(k & 0x7FF);
+    msg.setTimestampNs(k);
+    msg.setInterfaceId(k & 3);
+    msg.setFD(fd);
+    msg.setLength(fd ? 64 : 8);
+    for (int i=0; i<msg.getLength(); i++) {
+        msg.setByte(i, (uint8_t)(k * 7 + i));
+    }
+}
+
+static bool isIntact(const can_stream_record_t &rec, const uint8_t *data)
+{
+    uint64_t k = rec.timestamp_ns;
+    uint8_t len = (k & 1) ? 64 : 8;
+    if ((rec.id != (uint32_t)(k & 0x7FF)) || (rec.len != len) || (rec.interface != (k & 3))) {
+        return false;
+    }
+    for (int i=0; i<len; i++) {
+        if (data[i] != (uint8_t)(k * 7 + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int runReader(int idx, bool slow, int ready_fd)
+{
+    CanShmReader reader;
+    if (!reader.open(STRESS_SHM_NAME)) {
+        perror("reader: open");
+        return 1;
+    }
+    uint64_t start = reader.getPosition();
+    if (write(ready_fd, "r", 1) != 1) {
+        return 1;
+    }
+
+    can_stream_record_t rec;
+    uint8_t data[64];
+    uint64_t frames = 0, torn = 0, disorder = 0;
+    bool closed = false;
+    while (!closed) {
+        // frames published before the writer closed the ring are still read
+        closed = reader.isClosed();
+        int n = 0;
+        while (reader.read(rec, data)) {
+            if (!isIntact(rec, data)) {
+                torn++;
+            }
+            if (rec.timestamp_ns + 1 != reader.getPosition()) {
+                disorder++;
+            }
+            frames++;
+            if (slow && ((++n % 64) == 0)) {
+                usleep(100);
+            }
+        }
+    }
+
+    bool balanced = (frames + reader.getLost()) == (reader.getPosition() - start);
+    printf("  reader %d%s: %llu frames, %llu lost, %llu torn, %llu out of order%s\n", idx, slow ? " (slow)" : "",
+        (unsigned long long)frames, (unsigned long long)reader.getLost(), (unsigned long long)torn,
+        (unsigned long long)disorder, balanced ? "" : ", read + lost does not add up");
+    fflush(stdout);
+    return (torn || disorder || !balanced) ? 1 : 0;
+}
+
+static bool runProcesses(uint64_t count, int readers, uint32_t slot_count)
+{
+    printf("processes: %llu frames, %d readers, %u slots\n", (unsigned long long)count, readers, slot_count);
+    fflush(stdout);
+
+    CanShmRing ring;
+    if (!ring.create(STRESS_SHM_NAME, slot_count)) {
+        return false;
+    }
+
+    int ready[2];
+    if (pipe(ready) < 0) {
+        perror("pipe");
+        return false;
+    }
+
+    std::vector<pid_t> children;
+    for (int i=0; i<readers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(ready[0]);
+            _exit(runReader(i, i == readers-1, ready[1]));
+        }
+        children.push_back(pid);
+    }
+    close(ready[1]);
+    for (int i=0; i<readers; i++) {
+        char c;
+        if (read(ready[0], &c, 1) != 1) {
+            break;
+        }
+    }
+    close(ready[0]);
+
+    CanMessage msg;
+    double t0 = now();
+    for (uint64_t k=0; k<count; k++) {
+        makeFrame(k, msg);
+        ring.publish(msg);
+    }
+    double t = now() - t0;
+    printf("  writer: %.1f Mframes/s, %.0f ns/frame including building the frame\n", count / t / 1e6, t * 1e9 / count);
+    fflush(stdout);
+    ring.destroy();
+
+    bool ok = true;
+    foreach (pid_t pid, children) {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static CanShmRing *signalRing = 0;
+static volatile uint64_t signalFrames = 0;
+
+static void publishBurst(int signo)
+{
+    (void) signo;
+    CanMessage msg;
+    for (int i=0; i<3; i++) {
+        makeFrame(signalFrames++, msg);
+        signalRing->publish(msg);
+    }
+}
+
+static bool runSignal(uint64_t count)
+{
+    printf("signal: %llu frames read, %u slots, writer in a 20 us timer signal\n", (unsigned long long)count, STRESS_SIGNAL_SLOTS);
+
+    CanShmRing ring;
+    if (!ring.create(STRESS_SHM_NAME, STRESS_SIGNAL_SLOTS)) {
+        return false;
+    }
+    CanShmReader reader;
+    if (!reader.open(STRESS_SHM_NAME)) {
+        perror("reader: open");
+        return false;
+    }
+
+    signalRing = &ring;
+    signal(SIGALRM, publishBurst);
+    timer_t timer;
+    struct sigevent sev = {};
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = SIGALRM;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer) < 0) {
+        perror("timer_create");
+        return false;
+    }
+    struct itimerspec its = {};
+    its.it_interval.tv_nsec = 20000;
+    its.it_value.tv_nsec = 20000;
+    timer_settime(timer, 0, &its, 0);
+
+    can_stream_record_t rec;
+    uint8_t data[64];
+    uint64_t frames = 0, torn = 0;
+    double deadline = now() + 60;
+    while ((frames < count) && (now() < deadline)) {
+        if (reader.read(rec, data)) {
+            if (!isIntact(rec, data)) {
+                torn++;
+            }
+            frames++;
+        }
+    }
+
+    timer_delete(timer);
+    signal(SIGALRM, SIG_DFL);
+    printf("  %llu written, %llu read, %llu lost, %llu torn\n", (unsigned long long)signalFrames,
+        (unsigned long long)frames, (unsigned long long)reader.getLost(), (unsigned long long)torn);
+    reader.close();
+    ring.destroy();
+    return torn == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        fprintf(stderr, "usage: %s [frames [readers [slots]]]\n", argv[0]);
+        return 2;
+    }
+    uint64_t count = (argc > 1) ? strtoull(argv[1], 0, 0) : 2000000;
+    int readers = (argc > 2) ? atoi(argv[2]) : 4;
+    uint32_t slot_count = (argc > 3) ? strtoul(argv[3], 0, 0) : 4096;
+    if ((count == 0) || (readers < 1) || (slot_count == 0)) {
+        fprintf(stderr, "frames, readers and slots must be positive\n");
+        return 2;
+    }
+
+    bool ok = runProcesses(count, readers, slot_count);
+    ok = runSignal(count / 4) && ok;
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Stress test of the shared-memory frame ring: torn reads, ordering and
+# loss accounting. Run it and check for OK; see shmstress.cpp.
+
+QT = core network
+TARGET = cangaroo-shm-stress
+TEMPLATE = app
+CONFIG += console warn_on c++11
+CONFIG -= app_bundle
+
+SRC = $$clean_path($$PWD/../..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../../bin
+MOC_DIR = ../../../build/tools/shmstress/moc
+OBJECTS_DIR = ../../../build/tools/shmstress/o
+
+SOURCES += \
+    $$PWD/shmstress.cpp \
+    $$SRC/publish/CanShmRing.cpp \
+    $$SRC/publish/CanShmReader.cpp \
+    $$SRC/publish/CanStreamServer.cpp \
+    $$SRC/core/CanMessage.cpp \
+    $$SRC/core/CanCaptureFilter.cpp
+
+HEADERS += \
+    $$SRC/publish/CanShmRing.h \
+    $$SRC/publish/CanShmReader.h \
+    $$SRC/publish/CanStreamServer.h
+
+LIBS += -lrt
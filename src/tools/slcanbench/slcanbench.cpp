@@ -0,0 +1,299 @@
+/*
+
+  Copyright (c) 2015, 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Throughput benchmark of the SLCAN line parser.
+ *
+ * Parses an SLCAN byte stream in reads of the given size, once with
+ * SLCANParser and once with a copy of the receive path it replaced
+ * (byte ring, per-byte line buffer, in-place ASCII conversion), and
+ * prints frames/s of both. The stream is a file of raw bytes as
+ * recorded from an adapter, or a generated mix of classic, extended,
+ * remote and CAN FD frames.
+ *
+ * The previous path accepted malformed lines that SLCANParser rejects,
+ * so on a clean stream both must decode the same number of frames;
+ * the benchmark exits with 1 if they do not.
+ */
+
+#include <driver/SLCANDriver/SLCANParser.h>
+#include <driver/CanMessageBatch.h>
+#include <core/CanMessage.h>
+#include <core/HostClock.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <vector>
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * The receive path of SLCANInterface before SLCANParser, without the
+ * serial port: readSerial() copied every byte into a ring, readMessages()
+ * moved it into a line buffer and parseMessage() decoded complete lines.
+ */
+class ReferenceParser
+{
+public:
+    enum {
+        ring_len = 8192,
+        line_len = 155
+    };
+
+    ReferenceParser() : _head(0), _tail(0), _lineLen(0) {}
+
+    bool isEmpty() const
+    {
+        return _head == _tail;
+    }
+
+    void feed(const char *data, int len)
+    {
+        gettimeofday(&_tv, NULL);
+        for (int i=0; i<len; i++) {
+            if (((_head + 1) % ring_len) == _tail) {
+                _head = 0;
+                _tail = 0;
+            } else {
+                _ring[_head] = data[i];
+                _head = (_head + 1) % ring_len;
+            }
+        }
+    }
+
+    void drain(CanMessageBatch &batch)
+    {
+        while ((_tail != _head) && !batch.isFull()) {
+            if (_lineLen < line_len) {
+                _line[_lineLen++] = _ring[_tail];
+                if (_ring[_tail] == '\r') {
+                    CanMessage &msg = batch.next();
+                    if (parseMessage(msg)) {
+                        msg.setDirection(CanMessage::Rx);
+                        batch.commit();
+                    }
+                    _lineLen = 0;
+                }
+            } else {
+                _lineLen = 0;
+            }
+            _tail = (_tail + 1) % ring_len;
+        }
+    }
+
+private:
+    char _ring[ring_len];
+    int _head;
+    int _tail;
+    char _line[line_len];
+    int _lineLen;
+    struct timeval _tv;
+
+    bool parseMessage(CanMessage &msg)
+    {
+        msg.setTimestamp(_tv);
+        msg.setTimestampSource(CanMessage::timestamp_source_host);
+        msg.setErrorFrame(0);
+        msg.setInterfaceId(0);
+        msg.setId(0);
+        msg.setRTR(false);
+        msg.setBRS(false);
+
+        for (int i=1; i<_lineLen; i++) {
+            if (_line[i] >= 'a') {
+                _line[i] = _line[i] - 'a' + 10;
+            } else if (_line[i] >= 'A') {
+                _line[i] = _line[i] - 'A' + 10;
+            } else {
+                _line[i] = _line[i] - '0';
+            }
+        }
+
+        bool fd = false;
+        switch (_line[0]) {
+            case 'T': msg.setFD(false); msg.setExtended(true); break;
+            case 't': msg.setFD(false); msg.setExtended(false); break;
+            case 'r': msg.setFD(false); msg.setExtended(false); msg.setRTR(true); break;
+            case 'R': msg.setFD(false); msg.setExtended(true); msg.setRTR(true); break;
+            case 'd': msg.setFD(true); msg.setExtended(false); fd = true; break;
+            case 'D': msg.setFD(true); msg.setExtended(true); fd = true; break;
+            case 'b': msg.setFD(true); msg.setExtended(false); msg.setBRS(true); fd = true; break;
+            case 'B': msg.setFD(true); msg.setExtended(true); msg.setBRS(true); fd = true; break;
+            default: return false;
+        }
+
+        uint8_t pos = 1;
+        uint8_t id_len = msg.isExtended() ? 8 : 3;
+        uint32_t id = 0;
+        while (pos <= id_len) {
+            id *= 16;
+            id += _line[pos++];
+        }
+        msg.setId(id);
+
+        uint8_t dlc = _line[pos++];
+        if ((fd && (dlc > 0xF)) || (!fd && (dlc > 0x8))) {
+            return false;
+        }
+        static const uint8_t dlc_length[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+        uint8_t length = dlc_length[dlc];
+        msg.setLength(length);
+
+        for (uint8_t i=0; i<length; i++) {
+            msg.setByte(i, (_line[pos] << 4) + _line[pos+1]);
+            pos += 2;
+        }
+        return true;
+    }
+};
+
+static bool readRecording(const char *filename, std::vector<char> &stream)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        perror(filename);
+        return false;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        stream.insert(stream.end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+// what an adapter on a busy mixed bus sends: half standard, 30% extended, 10% remote and 10% CAN FD frames
+static void generateStream(int frames, std::vector<char> &stream)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    static const int dlc_length[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+    srand(1);
+    for (int n=0; n<frames; n++) {
+        int kind = rand() % 10;
+        char type;
+        int id_len = 3;
+        int dlc = rand() % 9;
+        if (kind < 5) {
+            type = 't';
+        } else if (kind < 8) {
+            type = 'T';
+            id_len = 8;
+        } else if (kind < 9) {
+            type = 'r';
+        } else {
+            type = (rand() & 1) ? 'b' : 'd';
+            dlc = rand() % 16;
+        }
+
+        uint32_t id = rand() & ((id_len == 3) ? 0x7FF : 0x1FFFFFFF);
+        stream.push_back(type);
+        for (int i=id_len-1; i>=0; i--) {
+            stream.push_back(hex[(id >> (4*i)) & 0xF]);
+        }
+        stream.push_back(hex[dlc]);
+        if (type != 'r') {
+            for (int i=0; i<2*dlc_length[dlc]; i++) {
+                stream.push_back(hex[rand() & 0xF]);
+            }
+        }
+        stream.push_back('\r');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        fprintf(stderr, "usage: %s [recording|frames [read size]]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<char> stream;
+    char *end = 0;
+    long frames = (argc > 1) ? strtol(argv[1], &end, 0) : 2000000;
+    if ((argc > 1) && *end) {
+        if (!readRecording(argv[1], stream)) {
+            return 2;
+        }
+    } else {
+        generateStream(frames, stream);
+    }
+    int chunk = (argc > 2) ? atoi(argv[2]) : 512;
+    if (stream.empty() || (chunk < 1)) {
+        fprintf(stderr, "nothing to parse\n");
+        return 2;
+    }
+
+    printf("%zu bytes in reads of %d bytes\n", stream.size(), chunk);
+
+    const char *data = &stream[0];
+    int size = stream.size();
+    CanMessageBatch batch(256);
+    bool ok = true;
+    for (int round=0; round<3; round++) {
+        uint64_t ref_frames = 0;
+        double t0 = now();
+        ReferenceParser ref;
+        for (int off=0; off<size; off+=chunk) {
+            ref.feed(data + off, (size - off < chunk) ? (size - off) : chunk);
+            do {
+                batch.clear();
+                ref.drain(batch);
+                ref_frames += batch.size();
+            } while (!ref.isEmpty());
+        }
+        double t_ref = now() - t0;
+
+        t0 = now();
+        SLCANParser parser;
+        for (int off=0; off<size; off+=chunk) {
+            int n = (size - off < chunk) ? (size - off) : chunk;
+            parser.setTimestampNs(HostClock::nowNs());
+            int pos = 0;
+            do {
+                batch.clear();
+                pos += parser.parse(data + off + pos, n - pos, batch);
+            } while (pos < n);
+        }
+        double t_new = now() - t0;
+
+        printf("  previous path: %llu frames, %.1f Mframes/s; SLCANParser: %llu frames, %llu errors, %.1f Mframes/s; %.1fx\n",
+            (unsigned long long)ref_frames, ref_frames / t_ref / 1e6,
+            (unsigned long long)parser.numFrames(), (unsigned long long)parser.numErrors(), parser.numFrames() / t_new / 1e6,
+            (parser.numFrames() / t_new) / (ref_frames / t_ref));
+        if ((parser.numFrames() != ref_frames) && !parser.numErrors()) {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        printf("the two paths decoded a different number of frames\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Throughput of the SLCAN line parser against the receive path it
+# replaced; see slcanbench.cpp.
+
+QT = core
+TARGET = cangaroo-slcan-bench
+TEMPLATE = app
+CONFIG += console warn_on c++11 release
+CONFIG -= app_bundle debug
+
+SRC = $$clean_path($$PWD/../..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../../bin
+MOC_DIR = ../../../build/tools/slcanbench/moc
+OBJECTS_DIR = ../../../build/tools/slcanbench/o
+
+SOURCES += \
+    $$PWD/slcanbench.cpp \
+    $$SRC/driver/SLCANDriver/SLCANParser.cpp \
+    $$SRC/driver/SLCANDriver/SLCANDeviceClock.cpp \
+    $$SRC/driver/CanMessageBatch.cpp \
+    $$SRC/core/CanMessage.cpp \
+    $$SRC/core/HostClock.cpp \
+    $$SRC/core/ClockAligner.cpp
+
+HEADERS += \
+    $$SRC/driver/SLCANDriver/SLCANParser.h \
+    $$SRC/driver/SLCANDriver/SLCANDeviceClock.h \
+    $$SRC/driver/CanMessageBatch.h \
+    $$SRC/core/HostClock.h \
+    $$SRC/core/ClockAligner.h
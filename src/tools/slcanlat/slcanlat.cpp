@@ -0,0 +1,208 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Receive latency and CPU use of SLCANInterface against the simulator.
+ *
+ * Starts an SLCANSimulator on a pseudo-terminal for every rate in turn,
+ * opens an SLCANInterface on it and reads it like CanListener does:
+ * readMessages() in a loop, one batch at a time. For every frame, the
+ * send time the simulator put into bytes 4..7 is compared with the host
+ * time the batch came back at. Printed per rate:
+ *  - frames/s received and batches/s, i.e. how often the reader woke up;
+ *  - latency average, 99th percentile and maximum;
+ *  - CPU time of the reading thread, as percent of one core.
+ * Rate 0 measures an idle, open port.
+ */
+
+#include <driver/SLCANDriver/SLCANInterface.h>
+#include <driver/SLCANDriver/SLCANSimulator.h>
+#include <driver/CanMessageBatch.h>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+#include <core/HostClock.h>
+#include <core/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+#include <algorithm>
+
+// the interface and the simulator report through the log, which normally goes to the backend
+void log_msg(const log_level_t level, const QString msg)
+{
+    if (level >= log_level_warning) {
+        fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
+    }
+}
+void log_msg(const QDateTime dt, const log_level_t level, const QString msg) { (void) dt; log_msg(level, msg); }
+void log_debug(const QString msg) { log_msg(log_level_debug, msg); }
+void log_info(const QString msg) { log_msg(log_level_info, msg); }
+void log_warning(const QString msg) { log_msg(log_level_warning, msg); }
+void log_error(const QString msg) { log_msg(log_level_error, msg); }
+void log_critical(const QString msg) { log_msg(log_level_critical, msg); }
+void log_fatal(const QString msg) { log_msg(log_level_fatal, msg); }
+
+// sent frames and saved settings go to the backend; the tool does neither
+Backend &Backend::instance()
+{
+    fprintf(stderr, "no backend in this tool\n");
+    abort();
+}
+void Backend::addSentMessage(const CanMessage &msg) { (void) msg; }
+QString Backend::getDriverName(CanInterfaceId id) { (void) id; return QString(); }
+QString Backend::getInterfaceName(CanInterfaceId id) { (void) id; return QString(); }
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double threadCpu()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static bool measure(SLCANSimulator::config_t config, double duration)
+{
+    SLCANSimulator sim(config);
+    if (!sim.startSimulation()) {
+        return false;
+    }
+    SLCANInterface intf(0, 0, sim.getPortName(), sim.getDescription(), true);
+    intf.open();
+    if (!intf.isOpen()) {
+        fprintf(stderr, "cannot open %s\n", sim.getPortName().toLocal8Bit().constData());
+        sim.stopSimulation();
+        return false;
+    }
+
+    // skip the start, the first frames wait for the channel to open
+    CanMessageBatch batch(256);
+    double t_end = now() + 0.5;
+    while (now() < t_end) {
+        batch.clear();
+        intf.readMessages(batch, 100);
+    }
+
+    std::vector<uint32_t> latencies;
+    uint64_t batches = 0;
+    double cpu_start = threadCpu();
+    double t_start = now();
+    t_end = t_start + duration;
+    while (now() < t_end) {
+        batch.clear();
+        if (!intf.readMessages(batch, 100)) {
+            continue;
+        }
+        batches++;
+        uint32_t arrival_us = (uint32_t)(HostClock::nowNs() / 1000);
+        for (int i=0; i<batch.size(); i++) {
+            const CanMessage &msg = batch.at(i);
+            if (msg.getLength() < 8) {
+                continue;
+            }
+            uint32_t sent_us = 0;
+            for (int k=0; k<4; k++) {
+                sent_us |= (uint32_t)msg.getByte(4 + k) << (8 * k);
+            }
+            int32_t latency = (int32_t)(arrival_us - sent_us);
+            latencies.push_back((latency > 0) ? latency : 0);
+        }
+    }
+    double cpu = threadCpu() - cpu_start;
+    double elapsed = now() - t_start;
+
+    intf.close();
+    sim.stopSimulation();
+
+    double sum = 0;
+    for (size_t i=0; i<latencies.size(); i++) {
+        sum += latencies[i];
+    }
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    printf("rate %6u: %8.0f frames/s %6.0f batches/s  latency avg %5.0f us p99 %5u max %5u  CPU %4.1f%%\n",
+        config.rate, n / elapsed, batches / elapsed,
+        n ? sum / n : 0, n ? latencies[n * 99 / 100] : 0, n ? latencies[n - 1] : 0,
+        100 * cpu / elapsed);
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-c config] [-r rates] [-d seconds]\n"
+        "  -c config   simulator settings, e.g. pattern=mixed (pattern=classic)\n"
+        "  -r rates    comma separated frames per second (0,100,1000,10000,50000)\n"
+        "  -d seconds  measurement time per rate (5)\n",
+        argv0);
+}
+
+int main(int argc, char *argv[])
+{
+    SLCANSimulator::config_t config;
+    config.channel = 0;
+    config.pattern = SLCANSimulator::pattern_classic;
+    config.rate = 0;
+    QString rates = "0,100,1000,10000,50000";
+    double duration = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:r:d:")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (!SLCANSimulator::parseConfig(QString::fromLocal8Bit(optarg), config)) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'r': rates = QString::fromLocal8Bit(optarg); break;
+            case 'd': duration = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (duration <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    foreach (const QString &rate, rates.split(',', QString::SkipEmptyParts)) {
+        bool ok;
+        config.rate = rate.toUInt(&ok);
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (!measure(config, duration)) {
+            return 1;
+        }
+    }
+    return 0;
+}
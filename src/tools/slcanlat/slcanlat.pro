@@ -0,0 +1,45 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Receive latency and reader CPU of SLCANInterface against the pty
+# simulator; see slcanlat.cpp.
+
+QT = core xml serialport
+TARGET = cangaroo-slcan-lat
+TEMPLATE = app
+CONFIG += console warn_on c++11 release
+CONFIG -= app_bundle debug
+
+SRC = $$clean_path($$PWD/../..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../../bin
+MOC_DIR = ../../../build/tools/slcanlat/moc
+OBJECTS_DIR = ../../../build/tools/slcanlat/o
+
+SOURCES += \
+    $$PWD/slcanlat.cpp \
+    $$SRC/driver/SLCANDriver/SLCANInterface.cpp \
+    $$SRC/driver/SLCANDriver/SLCANSimulator.cpp \
+    $$SRC/driver/SLCANDriver/SLCANParser.cpp \
+    $$SRC/driver/SLCANDriver/SLCANDeviceClock.cpp \
+    $$SRC/driver/SLCANDriver/SLCANByteRing.cpp \
+    $$SRC/driver/CanInterface.cpp \
+    $$SRC/driver/CanMessageBatch.cpp \
+    $$SRC/driver/CanTiming.cpp \
+    $$SRC/core/MeasurementInterface.cpp \
+    $$SRC/core/CanCaptureFilter.cpp \
+    $$SRC/core/CanMessage.cpp \
+    $$SRC/core/HostClock.cpp \
+    $$SRC/core/ClockAligner.cpp
+
+HEADERS += \
+    $$SRC/driver/SLCANDriver/SLCANInterface.h \
+    $$SRC/driver/SLCANDriver/SLCANSimulator.h \
+    $$SRC/driver/SLCANDriver/SLCANParser.h \
+    $$SRC/driver/SLCANDriver/SLCANDeviceClock.h \
+    $$SRC/driver/SLCANDriver/SLCANByteRing.h \
+    $$SRC/driver/CanInterface.h \
+    $$SRC/driver/CanMessageBatch.h \
+    $$SRC/core/MeasurementInterface.h \
+    $$SRC/core/HostClock.h \
+    $$SRC/core/ClockAligner.h
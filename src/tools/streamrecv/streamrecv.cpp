@@ -0,0 +1,410 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Receiver for the live frame stream of CanStreamServer.
+ *
+ * Connects to the TCP server, or with -m joins the multicast group, and
+ * checks the stream as it arrives:
+ *  - every packet starts with CAN_STREAM_MAGIC and its records add up to
+ *    the length in the header;
+ *  - seq continues where the previous packet ended. Over TCP a jump is an
+ *    error, since dropped frames must be reported by gap records. Over
+ *    multicast a jump counts lost records;
+ *  - with -f, the rules are sent as a "filter" command, and every frame
+ *    from half a second after connecting on has to match them.
+ * Frames, gap records and frames per second are printed every interval.
+ * With -s, the receiver sleeps after each read to play a slow consumer;
+ * the server then has to drop frames and report them with gap records.
+ *
+ * Exits with 1 if any check failed.
+ */
+
+#include <publish/CanStreamProtocol.h>
+#include <core/CanCaptureFilter.h>
+#include <core/CanMessage.h>
+#include <core/portable_endian.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct Stats {
+    uint64_t packets;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t gap_records;
+    uint64_t gap_frames;   // frames the server reported as dropped
+    uint64_t lost_records; // multicast: records in datagrams that never arrived
+    uint64_t errors;
+};
+
+// time the server is given to read the filter command
+static const double filter_delay_s = 0.5;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onSignal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [-t host] [-m] [-g group] [-p port] [-f rules] [-d seconds] [-i seconds] [-s us]\n"
+        "  -t host     address of the TCP server (127.0.0.1)\n"
+        "  -m          join the multicast group instead of connecting over TCP\n"
+        "  -g group    multicast group (%s)\n"
+        "  -p port     port (%d for TCP, %d for multicast)\n"
+        "  -f rules    send \"filter rules\" (TCP only) and check every frame against them\n"
+        "  -d seconds  stop after this long, 0 to run until interrupted (10)\n"
+        "  -i seconds  report interval (1)\n"
+        "  -s us       sleep this long after each read, to play a slow consumer (0)\n",
+        argv0, CAN_STREAM_DEFAULT_GROUP, can_stream_default_tcp_port, can_stream_default_udp_port);
+}
+
+static void messageFromRecord(const can_stream_record_t &rec, const char *payload, CanMessage &msg)
+{
+    uint32_t id = le32toh(rec.id);
+    msg.setId(id & CanCaptureFilter::mask_id_ext);
+    msg.setExtended((id & CanCaptureFilter::flag_extended) != 0);
+    msg.setRTR((id & CanCaptureFilter::flag_rtr) != 0);
+    msg.setErrorFrame((id & CanCaptureFilter::flag_error) != 0);
+    msg.setFD((rec.flags & can_stream_flag_fd) != 0);
+    msg.setLength(rec.len);
+    for (int i=0; i<rec.len; i++) {
+        msg.setByte(i, payload[i]);
+    }
+}
+
+/*
+ * Checks one packet of size bytes (header included) and counts its records.
+ * Returns false if the packet is malformed.
+ */
+static bool checkPacket(const char *data, size_t size, bool multicast, uint32_t &next_seq, bool &seq_known,
+                        const CanCaptureFilter *filter, Stats &stats)
+{
+    can_stream_header_t hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    uint32_t seq = le32toh(hdr.seq);
+    uint16_t length = le16toh(hdr.length);
+    uint16_t count = le16toh(hdr.count);
+
+    if (seq_known && (seq != next_seq)) {
+        if (multicast && ((int32_t)(seq - next_seq) > 0)) {
+            stats.lost_records += seq - next_seq;
+        } else {
+            fprintf(stderr, "seq %u where %u was expected\n", seq, next_seq);
+            stats.errors++;
+        }
+    }
+
+    const char *p = data + sizeof(hdr);
+    const char *end = data + size;
+    for (int i=0; i<count; i++) {
+        can_stream_record_t rec;
+        if ((end - p) < (ptrdiff_t)sizeof(rec)) {
+            fprintf(stderr, "packet seq %u: record %d runs past the packet\n", seq, i);
+            stats.errors++;
+            return false;
+        }
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if (((end - p) < rec.len) || (rec.len > 64)) {
+            fprintf(stderr, "packet seq %u: payload of record %d runs past the packet\n", seq, i);
+            stats.errors++;
+            return false;
+        }
+
+        if (rec.flags & can_stream_flag_gap) {
+            stats.gap_records++;
+            stats.gap_frames += le32toh(rec.id);
+        } else {
+            stats.frames++;
+            if (filter) {
+                CanMessage msg;
+                messageFromRecord(rec, p, msg);
+                if (!filter->matches(msg)) {
+                    stats.errors++;
+                }
+            }
+        }
+        p += rec.len;
+    }
+
+    if ((p != end) || (length != (size - sizeof(hdr)))) {
+        fprintf(stderr, "packet seq %u: length %u does not match its %u records\n", seq, length, count);
+        stats.errors++;
+        return false;
+    }
+
+    next_seq = seq + count;
+    seq_known = true;
+    stats.packets++;
+    return true;
+}
+
+static int openTcp(const char *host, int port, const char *rules)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "%s: not an IPv4 address\n", host);
+        return -1;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(sock);
+        return -1;
+    }
+
+    if (rules) {
+        char line[1024];
+        int n = snprintf(line, sizeof(line), "filter %s\n", rules);
+        if ((n >= (int)sizeof(line)) || (write(sock, line, n) != n)) {
+            fprintf(stderr, "cannot send the filter\n");
+            close(sock);
+            return -1;
+        }
+    }
+    return sock;
+}
+
+static int openMulticast(const char *group, int port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1) {
+        fprintf(stderr, "%s: not an IPv4 address\n", group);
+        close(sock);
+        return -1;
+    }
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        perror("IP_ADD_MEMBERSHIP");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void report(const char *what, double secs, const Stats &cur, const Stats &prev)
+{
+    double rate = (secs > 0) ? ((cur.frames - prev.frames) / secs) : 0;
+    double mbps = (secs > 0) ? ((cur.bytes - prev.bytes) / secs / 1e6) : 0;
+    printf("%s %.0f frames/s, %.1f MB/s; frames %llu, gap records %llu (%llu frames dropped), lost %llu, errors %llu\n",
+        what, rate, mbps,
+        (unsigned long long)cur.frames, (unsigned long long)cur.gap_records, (unsigned long long)cur.gap_frames,
+        (unsigned long long)cur.lost_records, (unsigned long long)cur.errors);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = "127.0.0.1";
+    const char *group = CAN_STREAM_DEFAULT_GROUP;
+    const char *rules = 0;
+    bool multicast = false;
+    int port = 0;
+    double duration = 10;
+    double interval = 1;
+    long sleep_us = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:mg:p:f:d:i:s:")) != -1) {
+        switch (opt) {
+            case 't': host = optarg; break;
+            case 'm': multicast = true; break;
+            case 'g': group = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'f': rules = optarg; break;
+            case 'd': duration = atof(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 's': sleep_us = atol(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if ((port < 0) || (port > 65535) || (duration < 0) || (interval <= 0) || (sleep_us < 0) || (multicast && rules)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (port == 0) {
+        port = multicast ? can_stream_default_udp_port : can_stream_default_tcp_port;
+    }
+
+    CanCaptureFilter filter;
+    if (rules && !filter.fromString(QString::fromLatin1(rules))) {
+        fprintf(stderr, "invalid filter: %s\n", rules);
+        return 2;
+    }
+
+    int sock = multicast ? openMulticast(group, port) : openTcp(host, port, rules);
+    if (sock < 0) {
+        return 1;
+    }
+    printf("receiving from %s %s:%d%s%s\n", multicast ? "multicast" : "TCP", multicast ? group : host, port,
+        rules ? ", filter " : "", rules ? rules : "");
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // wake up at least once per report interval
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    static char buf[1048576];
+    size_t fill = 0;
+    uint32_t next_seq = 0;
+    bool seq_known = false;
+    Stats stats, last;
+    memset(&stats, 0, sizeof(stats));
+    last = stats;
+
+    double start = now();
+    double last_report = start;
+    bool closed = false;
+    while (!stop_requested && !closed) {
+        double t = now();
+        if ((duration > 0) && ((t - start) >= duration)) {
+            break;
+        }
+        if ((t - last_report) >= interval) {
+            char what[32];
+            snprintf(what, sizeof(what), "%6.1f s:", t - start);
+            report(what, t - last_report, stats, last);
+            last = stats;
+            last_report = t;
+        }
+
+        ssize_t n = recv(sock, buf + fill, sizeof(buf) - fill, 0);
+        if (n < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+                continue;
+            }
+            perror("recv");
+            break;
+        }
+        if (n == 0) {
+            if (!multicast) {
+                printf("server closed the connection\n");
+                closed = true;
+            }
+            continue;
+        }
+        stats.bytes += n;
+
+        if (multicast) {
+            // one packet per datagram
+            if ((n < (ssize_t)sizeof(can_stream_header_t)) || (le32toh(((can_stream_header_t *)buf)->magic) != CAN_STREAM_MAGIC)) {
+                stats.errors++;
+            } else {
+                checkPacket(buf, n, true, next_seq, seq_known, 0, stats);
+            }
+        } else {
+            fill += n;
+            size_t pos = 0;
+            while ((fill - pos) >= sizeof(can_stream_header_t)) {
+                can_stream_header_t hdr;
+                memcpy(&hdr, buf + pos, sizeof(hdr));
+                if (le32toh(hdr.magic) != CAN_STREAM_MAGIC) {
+                    fprintf(stderr, "bad magic, giving up on the stream\n");
+                    stats.errors++;
+                    closed = true;
+                    break;
+                }
+                size_t size = sizeof(hdr) + le16toh(hdr.length);
+                if ((fill - pos) < size) {
+                    break;
+                }
+                // frames that left before the server read our filter do not have to match it
+                bool check_filter = rules && ((t - start) >= filter_delay_s);
+                checkPacket(buf + pos, size, false, next_seq, seq_known, check_filter ? &filter : 0, stats);
+                pos += size;
+            }
+            memmove(buf, buf + pos, fill - pos);
+            fill -= pos;
+        }
+
+        if (sleep_us) {
+            usleep(sleep_us);
+        }
+    }
+
+    double t = now();
+    report("total:", t - start, stats, Stats());
+    close(sock);
+
+    if (stats.errors) {
+        printf("FAILED\n");
+        return 1;
+    }
+    return 0;
+}
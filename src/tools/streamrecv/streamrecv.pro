@@ -0,0 +1,27 @@
+lessThan(QT_MAJOR_VERSION, 5): error("requires Qt 5")
+
+# Receiver of the live frame stream over TCP or multicast, checking seq
+# continuity, gap records and filters; see streamrecv.cpp.
+
+QT = core
+TARGET = cangaroo-stream-recv
+TEMPLATE = app
+CONFIG += console warn_on c++11
+CONFIG -= app_bundle
+
+SRC = $$clean_path($$PWD/../..)
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../../bin
+MOC_DIR = ../../../build/tools/streamrecv/moc
+OBJECTS_DIR = ../../../build/tools/streamrecv/o
+
+SOURCES += \
+    $$PWD/streamrecv.cpp \
+    $$SRC/core/CanCaptureFilter.cpp \
+    $$SRC/core/CanMessage.cpp
+
+HEADERS += \
+    $$SRC/core/CanCaptureFilter.h \
+    $$SRC/core/CanMessage.h \
+    $$SRC/publish/CanStreamProtocol.h
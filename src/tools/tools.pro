@@ -0,0 +1,3 @@
+# Developer tools: stress tests, benchmarks and simulators. Not installed.
+TEMPLATE = subdirs
+SUBDIRS += shmstress slcanbench slcanlat blastsend streamrecv
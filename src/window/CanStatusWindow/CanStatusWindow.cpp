@@ -29,6 +29,7 @@
 #include <core/MeasurementSetup.h>
 #include <core/MeasurementNetwork.h>
 #include <core/MeasurementInterface.h>
+#include <driver/CanListener.h>
 
 CanStatusWindow::CanStatusWindow(QWidget *parent, Backend &backend) :
     ConfigurableWidget(parent),
@@ -39,9 +40,10 @@ CanStatusWindow::CanStatusWindow(QWidget *parent, Backend &backend) :
     ui->setupUi(this);
     ui->treeWidget->setHeaderLabels(QStringList()
         << "Driver" << "Interface" << "State"
-        << "Rx Frames" << "Rx Errors" << "Rx Overrun"
-        << "Tx Frames" << "Tx Errors" << "Tx Dropped"
+        << "Rx Frames" << "Rx Errors" << "Rx Overrun" << "Rx Dropped"
+        << "Tx Frames" << "Tx Errors" << "Tx Dropped" << "Tx Queue" << "Tx Flow"
         << "# Warning" << "# Passive" << "# Bus Off" << " #Restarts"
+        << "Ring HWM" << "Ring Drops" << "Details"
     );
     ui->treeWidget->setColumnWidth(0, 80);
     ui->treeWidget->setColumnWidth(1, 70);
@@ -69,11 +71,14 @@ void CanStatusWindow::beginMeasurement()
         item->setTextAlignment(column_driver, Qt::AlignLeft);
         item->setTextAlignment(column_interface, Qt::AlignLeft);
         item->setTextAlignment(column_state, Qt::AlignCenter);
-        for (int i=column_rx_frames; i<column_count; i++) {
+        for (int i=column_rx_frames; i<column_details; i++) {
             item->setTextAlignment(i, Qt::AlignRight);
         }
+        item->setTextAlignment(column_details, Qt::AlignLeft);
 
         ui->treeWidget->addTopLevelItem(item);
+
+        connect(intf, SIGNAL(stateChanged()), this, SLOT(updateInterface()));
     }
     update();
     _timer->start(100);
@@ -82,26 +87,55 @@ void CanStatusWindow::beginMeasurement()
 void CanStatusWindow::endMeasurement()
 {
     _timer->stop();
+    foreach (CanInterfaceId ifid, backend().getInterfaceList()) {
+        disconnect(backend().getInterfaceById(ifid), SIGNAL(stateChanged()), this, SLOT(updateInterface()));
+    }
 }
 
 void CanStatusWindow::update()
 {
     for (QTreeWidgetItemIterator it(ui->treeWidget); *it; ++it) {
-        QTreeWidgetItem *item = *it;
-        CanInterface *intf = (CanInterface *)item->data(0, Qt::UserRole).value<void *>();
-        if (intf) {
-            intf->updateStatistics();
-            item->setText(column_state, intf->getStateText());
-            item->setText(column_rx_frames, QString().number(intf->getNumRxFrames()));
-            item->setText(column_rx_errors, QString().number(intf->getNumRxErrors()));
-            item->setText(column_rx_overrun, QString().number(intf->getNumRxOverruns()));
-            item->setText(column_tx_frames, QString().number(intf->getNumTxFrames()));
-            item->setText(column_tx_errors, QString().number(intf->getNumTxErrors()));
-            item->setText(column_tx_dropped, QString().number(intf->getNumTxDropped()));
+        updateItem(*it);
+    }
+}
+
+void CanStatusWindow::updateInterface()
+{
+    // pushed state change: refresh only the row of the interface that reported it
+    CanInterface *sender_intf = qobject_cast<CanInterface*>(sender());
+    for (QTreeWidgetItemIterator it(ui->treeWidget); *it; ++it) {
+        if ((*it)->data(0, Qt::UserRole).value<void *>() == (void*)sender_intf) {
+            updateItem(*it);
         }
     }
 }
 
+void CanStatusWindow::updateItem(QTreeWidgetItem *item)
+{
+    CanInterface *intf = (CanInterface *)item->data(0, Qt::UserRole).value<void *>();
+    if (intf) {
+        intf->updateStatistics();
+        item->setText(column_state, intf->getStateText());
+        item->setText(column_rx_frames, QString().number(intf->getNumRxFrames()));
+        item->setText(column_rx_errors, QString().number(intf->getNumRxErrors()));
+        item->setText(column_rx_overrun, QString().number(intf->getNumRxOverruns()));
+        item->setText(column_rx_dropped, QString().number(intf->getNumRxDropped()));
+        item->setText(column_tx_frames, QString().number(intf->getNumTxFrames()));
+        item->setText(column_tx_errors, QString().number(intf->getNumTxErrors()));
+        item->setText(column_tx_dropped, QString().number(intf->getNumTxDropped()));
+        item->setText(column_tx_queue, QString().number(intf->getTxQueueDepth()));
+        item->setText(column_tx_flow, intf->getTxFlowStateText());
+
+        CanListener *listener = backend().getListenerById(intf->getId());
+        if (listener) {
+            item->setText(column_ring_highwater, QString().number(listener->getRingHighWaterMark()));
+            item->setText(column_ring_drops, QString().number(listener->getRingDrops()));
+        }
+
+        item->setText(column_details, intf->getStatusDetailsStr());
+    }
+}
+
 Backend &CanStatusWindow::backend()
 {
     return _backend;
@@ -29,6 +29,7 @@ class CanStatusWindow;
 
 class Backend;
 class QTimer;
+class QTreeWidgetItem;
 
 class CanStatusWindow : public ConfigurableWidget
 {
@@ -42,13 +43,19 @@ public:
         column_rx_frames,
         column_rx_errors,
         column_rx_overrun,
+        column_rx_dropped,
         column_tx_frames,
         column_tx_errors,
         column_tx_dropped,
+        column_tx_queue,
+        column_tx_flow,
         column_num_warning,
         column_num_passive,
         column_num_busoff,
         column_num_restarts,
+        column_ring_highwater,
+        column_ring_drops,
+        column_details,
         column_count
     };
 
@@ -60,6 +67,7 @@ private slots:
     void beginMeasurement();
     void endMeasurement();
     void update();
+    void updateInterface();
 
 private:
     Ui::CanStatusWindow *ui;
@@ -67,4 +75,6 @@ private:
 
     Backend &backend();
     QTimer *_timer;
+
+    void updateItem(QTreeWidgetItem *item);
 };
@@ -24,6 +24,7 @@
 
 #include <QDomDocument>
 #include <QTimer>
+#include <QLineEdit>
 #include <QDebug>
 #include <core/Backend.h>
 #include <driver/CanInterface.h>
@@ -31,7 +32,9 @@
 RawTxWindow::RawTxWindow(QWidget *parent, Backend &backend) :
     ConfigurableWidget(parent),
     ui(new Ui::RawTxWindow),
-    _backend(backend)
+    _backend(backend),
+    _cyclicRunning(false),
+    _cyclicInterface(0)
 {
     ui->setupUi(this);
 
@@ -44,6 +47,22 @@ RawTxWindow::RawTxWindow(QWidget *parent, Backend &backend) :
     connect(ui->checkbox_FD, SIGNAL(stateChanged(int)), this, SLOT(updateCapabilities()));
 
     connect(&backend, SIGNAL(beginMeasurement()),  this, SLOT(refreshInterfaces()));
+    connect(&backend, SIGNAL(endMeasurement()),  this, SLOT(endMeasurement()));
+
+    // a cycle run by the interface does not read the form again, so push every change to it
+    foreach (QLineEdit *field, findChildren<QLineEdit*>()) {
+        if (field->objectName().startsWith("fieldByte")) {
+            connect(field, SIGNAL(editingFinished()), this, SLOT(updateRepeatMessage()));
+        }
+    }
+    connect(ui->fieldAddress, SIGNAL(editingFinished()), this, SLOT(updateRepeatMessage()));
+    connect(ui->comboBoxDLC, SIGNAL(currentIndexChanged(int)), this, SLOT(updateRepeatMessage()));
+    connect(ui->comboBoxInterface, SIGNAL(currentIndexChanged(int)), this, SLOT(updateRepeatMessage()));
+    connect(ui->checkBox_IsExtended, SIGNAL(toggled(bool)), this, SLOT(updateRepeatMessage()));
+    connect(ui->checkBox_IsRTR, SIGNAL(toggled(bool)), this, SLOT(updateRepeatMessage()));
+    connect(ui->checkBox_IDIncrement, SIGNAL(toggled(bool)), this, SLOT(updateRepeatMessage()));
+    connect(ui->checkbox_FD, SIGNAL(toggled(bool)), this, SLOT(updateRepeatMessage()));
+    connect(ui->checkbox_BRS, SIGNAL(toggled(bool)), this, SLOT(updateRepeatMessage()));
 
     // Timer for repeating messages
     repeatmsg_timer = new QTimer(this);
@@ -357,22 +376,116 @@ void RawTxWindow::updateCapabilities()
 void RawTxWindow::changeRepeatRate(int ms)
 {
     repeatmsg_timer->setInterval(ms);
+    updateRepeatMessage();
 }
 
 void RawTxWindow::sendRepeatMessage(bool enable)
 {
     if(enable)
     {
-        repeatmsg_timer->start(ui->spinBox_RepeatRate->value());
+        // prefer a cycle timed by the interface; repeatmsg_timer jitters whenever the GUI thread is busy
+        if (!startCyclicTransmission()) {
+            repeatmsg_timer->start(ui->spinBox_RepeatRate->value());
+        }
         ui->repeatSendButton->setText("Stop Send Repeat");
     }
     else
     {
+        stopCyclicTransmission();
         repeatmsg_timer->stop();
         ui->repeatSendButton->setText("Start Send Repeat");
     }
 }
 
+void RawTxWindow::updateRepeatMessage()
+{
+    if (!ui->repeatSendButton->isChecked()) {
+        return;
+    }
+
+    // repeatmsg_timer reads the form on every shot, but the interface has to be handed the new frames.
+    // Changing the interface may also switch between the two.
+    if (startCyclicTransmission()) {
+        repeatmsg_timer->stop();
+    } else {
+        stopCyclicTransmission();
+        if (!repeatmsg_timer->isActive()) {
+            repeatmsg_timer->start(ui->spinBox_RepeatRate->value());
+        }
+    }
+}
+
+void RawTxWindow::endMeasurement()
+{
+    // interfaces are closed now, which also ended any cycle they ran
+    ui->repeatSendButton->setChecked(false);
+}
+
+bool RawTxWindow::buildCyclicFrames(QList<CanMessage> &frames)
+{
+    if (!ui->checkBox_IDIncrement->isChecked()) {
+        frames.append(buildMessage(lineedit_id_address_inc));
+        return true;
+    }
+
+    // with id increment, the interface cycles through one frame per id, as long as the range is short enough
+    uint32_t max_id = ui->checkBox_IsExtended->isChecked() ? 0x1FFFFFFF : 0x7FF;
+    if ((lineedit_id_address > max_id) || ((max_id - lineedit_id_address) >= max_cyclic_frames)) {
+        return false;
+    }
+
+    uint32_t id = (lineedit_id_address_inc > max_id) ? lineedit_id_address : lineedit_id_address_inc;
+    for (uint32_t i=0; i<=(max_id - lineedit_id_address); i++) {
+        frames.append(buildMessage(id));
+        if (++id > max_id) {
+            id = lineedit_id_address;
+        }
+    }
+    return true;
+}
+
+bool RawTxWindow::startCyclicTransmission()
+{
+    if (ui->comboBoxInterface->count() == 0) {
+        return false;
+    }
+
+    CanInterface *intf = _backend.getInterfaceById((CanInterfaceId)ui->comboBoxInterface->currentData().toUInt());
+    QList<CanMessage> frames;
+    if (!intf || !(intf->getCapabilities() & CanInterface::capability_cyclic_tx) || !buildCyclicFrames(frames)) {
+        return false;
+    }
+
+    // the interface identifies a cycle by its first frame, anything else is a new cycle
+    if (_cyclicRunning && ((_cyclicInterface != intf->getId())
+                           || (_cyclicKey.getId() != frames.first().getId())
+                           || (_cyclicKey.isExtended() != frames.first().isExtended()))) {
+        stopCyclicTransmission();
+    }
+
+    if (!intf->startCyclicTransmission(frames, ui->spinBox_RepeatRate->value() * 1000)) {
+        return false;
+    }
+
+    _cyclicRunning = true;
+    _cyclicInterface = intf->getId();
+    _cyclicKey = frames.first();
+    return true;
+}
+
+void RawTxWindow::stopCyclicTransmission()
+{
+    if (!_cyclicRunning) {
+        return;
+    }
+
+    CanInterface *intf = _backend.getInterfaceById(_cyclicInterface);
+    if (intf) {
+        intf->stopCyclicTransmission(_cyclicKey);
+    }
+    _cyclicRunning = false;
+}
+
 
 
 
@@ -418,7 +531,7 @@ void RawTxWindow::refreshInterfaces()
     updateCapabilities();
 }
 
-void RawTxWindow::sendRawMessage()
+CanMessage RawTxWindow::buildMessage(uint32_t id)
 {
     CanMessage msg;
     bool en_extended = ui->checkBox_IsExtended->isChecked();
@@ -513,7 +626,7 @@ void RawTxWindow::sendRawMessage()
         msg.setDataAt(i, data_int[i]);
     }
 
-    msg.setId(lineedit_id_address_inc);
+    msg.setId(id);
     msg.setLength(dlc);
 
     msg.setExtended(en_extended);
@@ -525,7 +638,20 @@ void RawTxWindow::sendRawMessage()
     if(ui->checkbox_FD->isChecked())
         msg.setFD(true);
 
+    return msg;
+}
+
+void RawTxWindow::sendRawMessage()
+{
+    CanMessage msg = buildMessage(lineedit_id_address_inc);
+    bool en_extended = msg.isExtended();
+
     CanInterface *intf = _backend.getInterfaceById((CanInterfaceId)ui->comboBoxInterface->currentData().toUInt());
+
+    // the repeat timer skips a cycle while the driver's transmit queue is backed up, instead of piling on
+    if ((sender() == repeatmsg_timer) && (intf->getTxFlowState() != CanInterface::tx_flow_ok)) {
+        return;
+    }
     intf->sendMessage(msg);
 
     if (ui->checkBox_IDIncrement->isChecked()) {
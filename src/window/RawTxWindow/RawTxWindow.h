@@ -21,7 +21,9 @@
 
 #pragma once
 
+#include <QList>
 #include <core/Backend.h>
+#include <core/CanMessage.h>
 #include <core/ConfigurableWidget.h>
 #include <core/MeasurementSetup.h>
 
@@ -51,6 +53,8 @@ private slots:
     void disableTxWindow(int disable);
     void refreshInterfaces();
     void sendRawMessage();
+    void updateRepeatMessage();
+    void endMeasurement();
 
 
     void on_fieldAddress_editingFinished();
@@ -61,7 +65,21 @@ private:
     QTimer *repeatmsg_timer;
     uint32_t lineedit_id_address;
     uint32_t lineedit_id_address_inc;
+
+    // cyclic transmission timed by the interface (e.g. SocketCAN CAN_BCM) instead of repeatmsg_timer
+    enum {
+        max_cyclic_frames = 256
+    };
+    bool _cyclicRunning;
+    CanInterfaceId _cyclicInterface;
+    CanMessage _cyclicKey;
+
     void hideFDFields();
     void showFDFields();
 
+    CanMessage buildMessage(uint32_t id);
+    bool buildCyclicFrames(QList<CanMessage> &frames);
+    bool startCyclicTransmission();
+    void stopCyclicTransmission();
+
 };
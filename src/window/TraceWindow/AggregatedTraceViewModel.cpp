@@ -25,6 +25,7 @@
 #include <core/Backend.h>
 #include <core/CanTrace.h>
 #include <core/CanDbMessage.h>
+#include <core/HostClock.h>
 
 AggregatedTraceViewModel::AggregatedTraceViewModel(Backend &backend)
   : BaseTraceViewModel(backend)
@@ -98,13 +99,16 @@ void AggregatedTraceViewModel::beforeAppend(int num_messages)
     CanTrace *trace = backend()->getTrace();
     int start_id = trace->size();
 
+    CanMessage msg;
     for (int i=start_id; i<start_id + num_messages; i++) {
-        const CanMessage *msg = trace->getMessage(i);
-        unique_key_t key = makeUniqueKey(*msg);
+        if (!trace->getMessage(i, msg) || msg.isGapMarker()) {
+            continue;
+        }
+        unique_key_t key = makeUniqueKey(msg);
         if (_map.contains(key) || _pendingMessageInserts.contains(key)) {
-            _pendingMessageUpdates.append(*msg);
+            _pendingMessageUpdates.append(msg);
         } else {
-            _pendingMessageInserts[key] = *msg;
+            _pendingMessageInserts[key] = msg;
         }
     }
 
@@ -129,13 +133,6 @@ AggregatedTraceViewModel::unique_key_t AggregatedTraceViewModel::makeUniqueKey(c
     return ((uint64_t)msg.getInterfaceId() << 32) | msg.getRawId();
 }
 
-double AggregatedTraceViewModel::getTimeDiff(const timeval t1, const timeval t2) const
-{
-    double diff = t2.tv_sec - t1.tv_sec;
-    diff += ((double)(t2.tv_usec - t1.tv_usec)) / 1000000;
-    return diff;
-}
-
 
 QModelIndex AggregatedTraceViewModel::index(int row, int column, const QModelIndex &parent) const
 {
@@ -204,10 +201,9 @@ QVariant AggregatedTraceViewModel::data_TextColorRole(const QModelIndex &index,
 
     if (item->parent() == _rootItem) { // CanMessage row
 
-        struct timeval now;
-        gettimeofday(&now, 0);
-
-        int color = getTimeDiff(item->_lastmsg.getTimestamp(), now)*100;
+        // frames fade to grey over two seconds without an update
+        int64_t age_ns = (int64_t)(HostClock::nowNs() - item->_lastmsg.getTimestampNs());
+        int color = age_ns / 10000000;
         if (color>200) { color = 200; }
         if (color<0) { color = 0; }
 
@@ -24,7 +24,6 @@
 #include <QAbstractItemModel>
 #include <QMap>
 #include <QList>
-#include <sys/time.h>
 
 #include "BaseTraceViewModel.h"
 #include <core/CanMessage.h>
@@ -58,7 +57,6 @@ private:
 
     unique_key_t makeUniqueKey(const CanMessage &msg) const;
     void createItem(const CanMessage &msg, AggregatedTraceViewItem *item, unique_key_t key);
-    double getTimeDiff(const timeval t1, const timeval t2) const;
     
 protected:
     virtual QVariant data_DisplayRole(const QModelIndex &index, int role) const;
@@ -135,12 +135,11 @@ QVariant BaseTraceViewModel::formatTimestamp(timestamp_mode_t mode, const CanMes
 
     if (mode==timestamp_mode_delta) {
 
-        double t_current = currentMsg.getFloatTimestamp();
-        double t_last = lastMsg.getFloatTimestamp();
+        uint64_t t_last = lastMsg.getTimestampNs();
         if (t_last==0) {
             return QVariant();
         } else {
-            return QString().asprintf("%.04lf", t_current-t_last);
+            return formatNsecsAsSeconds((int64_t)(currentMsg.getTimestampNs() - t_last));
         }
 
     } else if (mode==timestamp_mode_absolute) {
@@ -149,14 +148,24 @@ QVariant BaseTraceViewModel::formatTimestamp(timestamp_mode_t mode, const CanMes
 
     } else if (mode==timestamp_mode_relative) {
 
-        double t_current = currentMsg.getFloatTimestamp();
-        return QString().asprintf("%.04lf", t_current - backend()->getTimestampAtMeasurementStart());
+        return formatNsecsAsSeconds((int64_t)(currentMsg.getTimestampNs() - backend()->getNsecsAtMeasurementStart()));
 
     }
 
     return QVariant();
 }
 
+QString BaseTraceViewModel::formatNsecsAsSeconds(int64_t nsecs)
+{
+    // integer formatting, so long captures keep their sub-millisecond digits
+    uint64_t abs_ns = (nsecs<0) ? -nsecs : nsecs;
+    return QString().asprintf("%s%llu.%04u",
+        (nsecs<0) ? "-" : "",
+        (unsigned long long)(abs_ns / 1000000000),
+        (unsigned)((abs_ns % 1000000000) / 100000)
+    );
+}
+
 //Colin formatAggregate
 QVariant BaseTraceViewModel::formatAggregate(aggregated_mode_t mode, const CanMessage &currentMsg, const CanMessage &lastMsg) const
 {
@@ -186,6 +195,20 @@ QVariant BaseTraceViewModel::data_DisplayRole(const QModelIndex &index, int role
 QVariant BaseTraceViewModel::data_DisplayRole_Message(const QModelIndex &index, int role, const CanMessage &currentMsg, const CanMessage &lastMsg) const
 {
     (void) role;
+
+    if (currentMsg.isGapMarker()) {
+        switch (index.column()) {
+            case column_timestamp:
+                return formatTimestamp(_timestampMode, currentMsg, lastMsg);
+            case column_channel:
+                return formatAggregate(aggregated_mode_port, currentMsg, lastMsg);
+            case column_data:
+                return QString("*** %1 frame(s) lost in receive path ***").arg(currentMsg.getId());
+            default:
+                return QVariant();
+        }
+    }
+
     CanDbMessage *dbmsg = backend()->findDbMessage(currentMsg);
 
     switch (index.column()) {
@@ -71,6 +71,7 @@ protected:
     virtual QVariant data_TextColorRole_Signal(const QModelIndex &index, int role, const CanMessage &msg) const;
 
     QVariant formatTimestamp(timestamp_mode_t mode, const CanMessage &currentMsg, const CanMessage &lastMsg) const;
+    static QString formatNsecsAsSeconds(int64_t nsecs);
     QVariant formatAggregate(aggregated_mode_t mode, const CanMessage &currentMsg, const CanMessage &lastMsg) const;
 
 private:
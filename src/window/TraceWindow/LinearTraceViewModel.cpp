@@ -20,6 +20,7 @@
 */
 
 #include "LinearTraceViewModel.h"
+#include <QColor>
 #include <iostream>
 #include <stddef.h>
 #include <core/Backend.h>
@@ -59,9 +60,9 @@ int LinearTraceViewModel::rowCount(const QModelIndex &parent) const
         if (id & 0x80000000) { // node of a message
             return 0;
         } else { // a message
-            const CanMessage *msg = trace()->getMessage(id-1);
-            if (msg) {
-                CanDbMessage *dbmsg = backend()->findDbMessage(*msg);
+            CanMessage msg;
+            if (trace()->getMessage(id-1, msg)) {
+                CanDbMessage *dbmsg = backend()->findDbMessage(msg);
                 return (dbmsg!=0) ? dbmsg->getSignals().length() : 0;
             } else {
                 return 0;
@@ -108,18 +109,17 @@ QVariant LinearTraceViewModel::data_DisplayRole(const QModelIndex &index, int ro
     quintptr id = index.internalId();
     int msg_id = (id & ~0x80000000)-1;
 
-    const CanMessage *msg = trace()->getMessage(msg_id);
-    if (!msg) { return QVariant(); }
+    CanMessage msg;
+    if (!trace()->getMessage(msg_id, msg)) { return QVariant(); }
 
     if (id & 0x80000000) {
-        return data_DisplayRole_Signal(index, role, *msg);
+        return data_DisplayRole_Signal(index, role, msg);
     } else if (id) {
+        CanMessage prev_msg;
         if (msg_id>1) {
-            const CanMessage *prev_msg = trace()->getMessage(msg_id-1);
-            return data_DisplayRole_Message(index, role, *msg, *prev_msg);
-        } else {
-            return data_DisplayRole_Message(index, role, *msg, CanMessage());
+            trace()->getMessage(msg_id-1, prev_msg);
         }
+        return data_DisplayRole_Message(index, role, msg, prev_msg);
     }
 
     return QVariant();
@@ -133,9 +133,14 @@ QVariant LinearTraceViewModel::data_TextColorRole(const QModelIndex &index, int
 
     if (id & 0x80000000) { // CanSignal row
         int msg_id = (id & ~0x80000000)-1;
-        const CanMessage *msg = trace()->getMessage(msg_id);
-        if (msg) {
-            return data_TextColorRole_Signal(index, role, *msg);
+        CanMessage msg;
+        if (trace()->getMessage(msg_id, msg)) {
+            return data_TextColorRole_Signal(index, role, msg);
+        }
+    } else if (id) { // CanMessage row
+        CanMessage msg;
+        if (trace()->getMessage(id-1, msg) && msg.isGapMarker()) {
+            return QVariant::fromValue(QColor(Qt::red));
         }
     }
 